@@ -9,8 +9,10 @@ TODO: GUI
 */
 
 #include "Chip8.h"
+#include "VipTiming.h"
+#include <cstring>
+#include <iterator>
 #include <fstream>
-#include <iostream>
 
 
 //16 sprites representing characters
@@ -35,61 +37,52 @@ uint8_t fontset[FONT_SIZE] =
 };
 
 
-Chip8::Chip8()
-	: randGen((unsigned int)CLOCKCOUNT) //randGen member initialisation list with system clock seed
+//----------------------------------
+//			Dispatch tables
+//----------------------------------
+
+//every slot without a handler must call OP_NULL, not a null member pointer
+const Chip8::Chip8Func Chip8::table[0xF + 1] =
 {
-	//initialise program counter
-	pc = START_ADDRESS;
+	&Chip8::Table0, &Chip8::OP_1nnn, &Chip8::OP_2nnn, &Chip8::OP_3xkk,
+	&Chip8::OP_4xkk, &Chip8::OP_5xy0, &Chip8::OP_6xkk, &Chip8::OP_7xkk,
+	&Chip8::Table8, &Chip8::OP_9xy0, &Chip8::OP_Annn, &Chip8::OP_Bnnn,
+	&Chip8::OP_Cxkk, &Chip8::OP_Dxyn, &Chip8::TableE, &Chip8::TableF
+};
 
-	//load fonts into memory starting at 0x50
-	for (unsigned int i = 0; i < FONT_SIZE; ++i)
-	{
-		memory[FONT_START_ADDRESS + i] = fontset[i];
-	}
+const Chip8::Chip8Func Chip8::table0[0xF + 1] =
+{
+	&Chip8::OP_00E0, &Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_NULL,
+	&Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_NULL,
+	&Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_NULL,
+	&Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_00EE, &Chip8::OP_NULL
+};
+
+const Chip8::Chip8Func Chip8::table8[0xF + 1] =
+{
+	&Chip8::OP_8xy0, &Chip8::OP_8xy1, &Chip8::OP_8xy2, &Chip8::OP_8xy3,
+	&Chip8::OP_8xy4, &Chip8::OP_8xy5, &Chip8::OP_8xy6, &Chip8::OP_8xy7,
+	&Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_NULL,
+	&Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_8xyE, &Chip8::OP_NULL
+};
+
+const Chip8::Chip8Func Chip8::tableE[0xF + 1] =
+{
+	&Chip8::OP_NULL, &Chip8::OP_ExA1, &Chip8::OP_NULL, &Chip8::OP_NULL,
+	&Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_NULL,
+	&Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_NULL,
+	&Chip8::OP_NULL, &Chip8::OP_NULL, &Chip8::OP_Ex9E, &Chip8::OP_NULL
+};
 
-	//put keys in list to avoid switch statements (OP_Fx0A)
-	for (int i = 0; i < 16; ++i)
+//sparse, so built by a constexpr function rather than spelled out
+constexpr std::array<Chip8::Chip8Func, 0xFF + 1> Chip8::BuildTableF()
+{
+	std::array<Chip8Func, 0xFF + 1> tableF{};
+	for (auto& handler : tableF)
 	{
-		keyList.push_back(0);
+		handler = &Chip8::OP_NULL;
 	}
 
-	//initialise RNG - can use randByte(randGen) to get random number between 0 and 255
-	randByte = std::uniform_int_distribution<int>(0, 255);
-
-	//function pointer table
-	table[0x0] = &Chip8::Table0;
-	table[0x1] = &Chip8::OP_1nnn;
-	table[0x2] = &Chip8::OP_2nnn;
-	table[0x3] = &Chip8::OP_3xkk;
-	table[0x4] = &Chip8::OP_4xkk;
-	table[0x5] = &Chip8::OP_5xy0;
-	table[0x6] = &Chip8::OP_6xkk;
-	table[0x7] = &Chip8::OP_7xkk;
-	table[0x8] = &Chip8::Table8;
-	table[0x9] = &Chip8::OP_9xy0;
-	table[0xA] = &Chip8::OP_Annn;
-	table[0xB] = &Chip8::OP_Bnnn;
-	table[0xC] = &Chip8::OP_Cxkk;
-	table[0xD] = &Chip8::OP_Dxyn;
-	table[0xE] = &Chip8::TableE;
-	table[0xF] = &Chip8::TableF;
-
-	table0[0x0] = &Chip8::OP_00E0;
-	table0[0xE] = &Chip8::OP_00EE;
-
-	table8[0x0] = &Chip8::OP_8xy0;
-	table8[0x1] = &Chip8::OP_8xy1;
-	table8[0x2] = &Chip8::OP_8xy2;
-	table8[0x3] = &Chip8::OP_8xy3;
-	table8[0x4] = &Chip8::OP_8xy4;
-	table8[0x5] = &Chip8::OP_8xy5;
-	table8[0x6] = &Chip8::OP_8xy6;
-	table8[0x7] = &Chip8::OP_8xy7;
-	table8[0xE] = &Chip8::OP_8xyE;
-
-	tableE[0x1] = &Chip8::OP_ExA1;
-	tableE[0xE] = &Chip8::OP_Ex9E;
-
 	tableF[0x07] = &Chip8::OP_Fx07;
 	tableF[0x0A] = &Chip8::OP_Fx0A;
 	tableF[0x15] = &Chip8::OP_Fx15;
@@ -100,6 +93,91 @@ Chip8::Chip8()
 	tableF[0x55] = &Chip8::OP_Fx55;
 	tableF[0x65] = &Chip8::OP_Fx65;
 
+	return tableF;
+}
+
+const std::array<Chip8::Chip8Func, 0xFF + 1> Chip8::tableF = Chip8::BuildTableF();
+
+
+//built once - every construction and Reset() is then a single copy of it
+static const Chip8State& PowerOnState()
+{
+	static const Chip8State state = []
+	{
+		Chip8State init{};
+
+		//initialise program counter
+		init.pc = START_ADDRESS;
+
+		//load fonts into memory starting at 0x50
+		memcpy(&init.memory[FONT_START_ADDRESS], fontset, FONT_SIZE);
+
+		return init;
+	}();
+
+	return state;
+}
+
+bool QuirksByName(const std::string& name, Quirks& quirks)
+{
+	if (name == "modern")
+	{
+		quirks = QUIRKS_MODERN;
+	}
+	else if (name == "vip")
+	{
+		quirks = QUIRKS_VIP;
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+std::string FaultNames(uint8_t faults)
+{
+	static const char* const names[] = { "stack overflow", "stack underflow", "address wrap", "invalid opcode", "rom size" };
+
+	std::string text;
+	for (unsigned int bit = 0; bit < sizeof(names) / sizeof(names[0]); ++bit)
+	{
+		if (faults >> bit & 1u)
+		{
+			text += text.empty() ? names[bit] : std::string(", ") + names[bit];
+		}
+	}
+	return text.empty() ? "none" : text;
+}
+
+Chip8::Chip8()
+{
+	//seed Cxkk from the system clock
+	Reset();
+}
+
+void Chip8::Reset()
+{
+	Reset(static_cast<uint32_t>(CLOCKCOUNT));
+}
+
+void Chip8::Reset(uint32_t seed, uint32_t instance)
+{
+	static_cast<Chip8State&>(*this) = PowerOnState();
+	stats = Chip8Stats{};
+
+	rngKey = Chip8Random::Key(seed, instance);
+	rngDraws = 0;
+}
+
+void Chip8::SaveState(Chip8State& state) const
+{
+	state = *this;
+}
+
+void Chip8::LoadState(const Chip8State& state)
+{
+	static_cast<Chip8State&>(*this) = state;
 }
 
 void Chip8::LoadROM(const char* filename)
@@ -112,6 +190,13 @@ void Chip8::LoadROM(const char* filename)
 		//get current stream pos and set that as size; allocate buffer to hold contents
 		std::streampos size = file.tellg();
 
+		//anything past the end of memory is dropped
+		if (size > static_cast<std::streampos>(MEMORY_MAX - START_ADDRESS))
+		{
+			size = MEMORY_MAX - START_ADDRESS;
+			faults |= FAULT_ROM_SIZE;
+		}
+
 		auto memoryStart = &memory[START_ADDRESS];
 
 		file.seekg(0, std::ios::beg); //set pos to beg of stream
@@ -124,34 +209,80 @@ void Chip8::LoadROM(const char* filename)
 	}
 }
 
+void Chip8::LoadROM(const uint8_t* data, size_t size)
+{
+	//anything past the end of memory is dropped
+	if (size > MEMORY_MAX - START_ADDRESS)
+	{
+		size = MEMORY_MAX - START_ADDRESS;
+		faults |= FAULT_ROM_SIZE;
+	}
+
+	memcpy(&memory[START_ADDRESS], data, size);
+}
+
 //Intruction cycle (fetch-decode-execute)
 void Chip8::Cycle()
+{
+	Step();
+	TickTimers();
+}
+
+void Chip8::Step()
 {
 	//opcode is 2 bytes but memory value is 1 byte
 	//so we need to get memory[pc], turn it to 16-bit and combine with memory[pc+1]
 	//e.g. 1010000 << 8 | 10011000 = 1101000010011000
-	opcode = (memory[pc] << 8u) | memory[pc + 1];
+	//both bytes wrap like the address bus would, whatever LoadState() or gdb left in pc
+	opcode = (memory[pc & ADDRESS_MASK] << 8u) | memory[(pc + 1) & ADDRESS_MASK];
 
 	//increment PC before execution
-	pc += 2;
+	pc = (pc + 2) & ADDRESS_MASK;
+	++stats.instructions;
 
 	//get first single digit (e.g. 0xd6ed will become d)
 	//look up in fuction pointer table and execute
 	(this->*(table[I(opcode)]))();
+}
 
+void Chip8::TickTimers()
+{
 	//decrement delay timer if loaded with value
 	if (delayTimer > 0)
 	{
-		--delayTimer;
+		stats.timerUnderflows += --delayTimer == 0;
 	}
 
 	//decrement sound timer if loaded with value
 	if (soundTimer > 0)
 	{
-		--soundTimer;
+		stats.timerUnderflows += --soundTimer == 0;
 	}
 }
 
+unsigned int Chip8::RunFrame()
+{
+	const uint64_t frameEnd = (cycles / VIP_CYCLES_PER_FRAME + 1) * VIP_CYCLES_PER_FRAME;
+	unsigned int count = 0;
+
+	while (cycles < frameEnd)
+	{
+		Step();
+		cycles += VipCycles(opcode);
+		++count;
+
+		//the VIP draws in step with the vertical blank - nothing else runs this frame
+		//the keypad only changes between frames, so a key wait lasts the rest of it
+		if (I(opcode) == 0xD || keyWait)
+		{
+			cycles = frameEnd;
+		}
+	}
+
+	TickTimers();
+	return count;
+}
+
 //function pointer calls
 void Chip8::Table0()
 {
@@ -179,7 +310,7 @@ void Chip8::TableF()
 
 void Chip8::OP_NULL()
 {
-
+	faults |= FAULT_INVALID_OPCODE;
 }
 
 //----------------------------------
@@ -192,16 +323,16 @@ void Chip8::OP_00E0()
 	//set all bytes in display buffer to 0
 	memset(video, 0, sizeof(video));
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Return from subroutine
 void Chip8::OP_00EE()
 {
-	--sp;
-	pc = stack[sp];
+	//return with an empty stack is ignored
+	pc = PopStack(*this, pc);
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Jump to location nnn
@@ -211,20 +342,18 @@ void Chip8::OP_1nnn()
 	pc = NNN(opcode);
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Call subroutine at nnn
 void Chip8::OP_2nnn()
 {
-	//put current pc on top of stack
-	stack[sp] = pc;
-	++sp;
-	//set pc to address of opcode
-	pc = NNN(opcode);
+	//put current pc on top of stack and set pc to address of opcode
+	//call with a full stack is ignored
+	pc = PushStack(*this, pc) ? NNN(opcode) : pc;
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Skip next instruction if Vx = kk
@@ -232,11 +361,11 @@ void Chip8::OP_3xkk()
 {
 	if (registers[X(opcode)] == KK(opcode))
 	{
-		pc += 2;
+		pc = (pc + 2) & ADDRESS_MASK;
 	}
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Skip next instruction if Vx != kk
@@ -244,11 +373,11 @@ void Chip8::OP_4xkk()
 {
 	if (registers[X(opcode)] != KK(opcode))
 	{
-		pc += 2;
+		pc = (pc + 2) & ADDRESS_MASK;
 	}
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Skip next instruction if Vx == Vy
@@ -256,11 +385,11 @@ void Chip8::OP_5xy0()
 {
 	if (registers[X(opcode)] == registers[Y(opcode)])
 	{
-		pc += 2;
+		pc = (pc + 2) & ADDRESS_MASK;
 	}
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set Vx = kk
@@ -269,7 +398,7 @@ void Chip8::OP_6xkk()
 	registers[X(opcode)] = KK(opcode);
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set Vx = Vx + kk
@@ -278,7 +407,7 @@ void Chip8::OP_7xkk()
 	registers[X(opcode)] += KK(opcode);
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set Vx = Vy
@@ -287,7 +416,7 @@ void Chip8::OP_8xy0()
 	registers[X(opcode)] = registers[Y(opcode)];
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set Vx = Vx OR Vy
@@ -296,7 +425,7 @@ void Chip8::OP_8xy1()
 	registers[X(opcode)] |= registers[Y(opcode)];
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set Vx = Vx AND Vy
@@ -305,7 +434,7 @@ void Chip8::OP_8xy2()
 	registers[X(opcode)] &= registers[Y(opcode)];
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set Vx = Vx XOR Vy
@@ -314,7 +443,7 @@ void Chip8::OP_8xy3()
 	registers[X(opcode)] ^= registers[Y(opcode)];
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set Vx = Vx + Vy, set VF = carry
@@ -326,15 +455,15 @@ void Chip8::OP_8xy4()
 
 	uint16_t sum = registers[Vx] + registers[Vy];
 
-	//set overflow flag VF depending on sum
-	//0xF (decimal 15) represents the VF register (16th/final register)
-	registers[0xF] = sum > 255u ? 1 : 0;
-
 	//Only the lowest 8 bits of the result are stored in Vx (0xFF is decimal 255)
 	registers[Vx] = sum & 0xFFu;
 
+	//set overflow flag VF depending on sum, after the result so VF wins when x is F
+	//0xF (decimal 15) represents the VF register (16th/final register)
+	registers[0xF] = sum > 255u ? 1 : 0;
+
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set Vx = Vx - Vy, set VF = NOT borrow
@@ -343,25 +472,34 @@ void Chip8::OP_8xy5()
 	uint8_t Vx = X(opcode);
 	uint8_t Vy = Y(opcode);
 
-	registers[0xF] = registers[Vx] > registers[Vy] ? 1 : 0;
+	//NOT borrow - equal operands do not borrow
+	uint8_t notBorrow = registers[Vx] >= registers[Vy] ? 1 : 0;
 
 	registers[Vx] -= registers[Vy];
+	registers[0xF] = notBorrow;
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set Vx = Vx SHR 1
 void Chip8::OP_8xy6()
 {
+	if (quirks.shiftUsesVy)
+	{
+		OP_8xy6_alt();
+		return;
+	}
+
 	uint8_t Vx = X(opcode);
 
 	//Save least significant bit in VF (bitwise & binary 1)
-	registers[0xF] = registers[Vx] & 0x1u;
+	uint8_t lsb = registers[Vx] & 0x1u;
 	registers[Vx] >>= 1;
+	registers[0xF] = lsb;
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Alternate version (correct?)
@@ -373,11 +511,12 @@ void Chip8::OP_8xy6_alt()
 	uint8_t Vx = X(opcode);
 	uint8_t Vy = Y(opcode);
 
-	registers[0xF] = registers[Vy] & 0x1u;
+	uint8_t lsb = registers[Vy] & 0x1u;
 	registers[Vx] = registers[Vy] >> 1;
+	registers[0xF] = lsb;
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set Vx = Vy - Vx, set VF = NOT borrow
@@ -386,25 +525,33 @@ void Chip8::OP_8xy7()
 	uint8_t Vx = X(opcode);
 	uint8_t Vy = Y(opcode);
 
-	registers[0xF] = registers[Vy] > registers[Vx] ? 1 : 0;
+	uint8_t notBorrow = registers[Vy] >= registers[Vx] ? 1 : 0;
 
 	registers[Vx] = registers[Vy] - registers[Vx];
+	registers[0xF] = notBorrow;
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set Vx = Vx SHL 1
 void Chip8::OP_8xyE()
 {
+	if (quirks.shiftUsesVy)
+	{
+		OP_8xyE_alt();
+		return;
+	}
+
 	uint8_t Vx = X(opcode);
 
 	//Save most significant bit in VF (bitwise & binary 10000000 then >>)
-	registers[0xF] = (registers[Vx] & 0x80u) >> 7u;
+	uint8_t msb = (registers[Vx] & 0x80u) >> 7u;
 	registers[Vx] <<= 1;
+	registers[0xF] = msb;
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Alternate version (correct?)
@@ -416,11 +563,12 @@ void Chip8::OP_8xyE_alt()
 	uint8_t Vx = X(opcode);
 	uint8_t Vy = Y(opcode);
 
-	registers[0xF] = (registers[Vy] & 0x80u) >> 7u;
+	uint8_t msb = (registers[Vy] & 0x80u) >> 7u;
 	registers[Vx] = registers[Vy] << 1;
+	registers[0xF] = msb;
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Skip next instruction if Vx != Vy
@@ -428,11 +576,11 @@ void Chip8::OP_9xy0()
 {
 	if (registers[X(opcode)] != registers[Y(opcode)])
 	{
-		pc += 2;
+		pc = (pc + 2) & ADDRESS_MASK;
 	}
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set I = nnn (I = index register)
@@ -441,25 +589,27 @@ void Chip8::OP_Annn()
 	index = NNN(opcode);
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Jump to address nnn + V0
 void Chip8::OP_Bnnn()
 {
-	pc = NNN(opcode) + registers[0];
+	//nnn + V0 can run past the end of memory, wrap it
+	pc = (NNN(opcode) + registers[0]) & ADDRESS_MASK;
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set Vx = random byte AND kk
 void Chip8::OP_Cxkk()
 {
-	registers[X(opcode)] = randByte(randGen) & KK(opcode);
+	//the next byte of this instance's stream - key and counter travel with the machine when it is copied
+	registers[X(opcode)] = Chip8Random::Byte(rngKey, rngDraws++) & KK(opcode);
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Display n-byte sprite starting at memory address I at (Vx, Vy), set VF = collision
@@ -476,13 +626,19 @@ void Chip8::OP_Dxyn()
 
 	registers[0xF] = 0;
 
-	for (unsigned int row = 0; row < height; ++row)
+	//sprites that start on screen are clipped at the right and bottom edges, so
+	//every pixel written is inside video
+	unsigned int rows = yPos + height > VIDEO_HEIGHT ? VIDEO_HEIGHT - yPos : height;
+	unsigned int cols = xPos + 8u > VIDEO_WIDTH ? VIDEO_WIDTH - xPos : 8;
+	CheckSpan(*this, rows);
+
+	for (unsigned int row = 0; row < rows; ++row)
 	{
 		//start at memory address I
-		uint8_t spriteByte = memory[index + row];
+		uint8_t spriteByte = memory[(index + row) & ADDRESS_MASK];
 
 		//sprite will always be 8 pixels wide
-		for (unsigned int col = 0; col < 8; ++col)
+		for (unsigned int col = 0; col < cols; ++col)
 		{
 			//0x80u >> col scans through byte, 1 bit at a time
 			uint8_t spritePixel = spriteByte & (0x80u >> col);
@@ -502,32 +658,36 @@ void Chip8::OP_Dxyn()
 		}
 	}
 
+	++stats.draws;
+	stats.collisions += registers[0xF];
+
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Skip next instruction if key with value of Vx is pressed
 void Chip8::OP_Ex9E()
 {
-	if (keypad[registers[X(opcode)]])
+	//only the low nibble names a key
+	if (keypad[registers[X(opcode)] & 0xFu])
 	{
-		pc += 2;
+		pc = (pc + 2) & ADDRESS_MASK;
 	}
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Skip next instruction if key with the value of Vx is not pressed
 void Chip8::OP_ExA1()
 {
-	if (!keypad[registers[X(opcode)]])
+	if (!keypad[registers[X(opcode)] & 0xFu])
 	{
-		pc += 2;
+		pc = (pc + 2) & ADDRESS_MASK;
 	}
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set Vx = delay timer value
@@ -536,27 +696,28 @@ void Chip8::OP_Fx07()
 	registers[X(opcode)] = delayTimer;
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Wait for a key press, store the value of the key in Vx 
 void Chip8::OP_Fx0A()
 {
 	bool pressed = false;
-	for (int i = 0; i < 16; ++i)
+	for (unsigned int i = 0; i < KEY_COUNT; ++i)
 	{
-		if (keyList[i])
+		if (keypad[i])
 		{
 			registers[X(opcode)] = i;
-			break;
 			pressed = true;
+			break;
 		}
 	}
 	//if no key press, decrement PC by 2, causing instruction to repeat indefinitely
-	pc -= !pressed ? 2 : 0;
+	pc = (pc - (!pressed ? 2 : 0)) & ADDRESS_MASK;
+	keyWait = !pressed;
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set delay timer = Vx
@@ -565,7 +726,7 @@ void Chip8::OP_Fx15()
 	delayTimer = registers[X(opcode)];
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set sound timer = Vx
@@ -574,7 +735,7 @@ void Chip8::OP_Fx18()
 	soundTimer = registers[X(opcode)];
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 
 }
 
@@ -584,7 +745,7 @@ void Chip8::OP_Fx1E()
 	index += registers[X(opcode)];
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Set I = address of sprite for digit Vx
@@ -594,7 +755,7 @@ void Chip8::OP_Fx29()
 	index = FONT_START_ADDRESS + (5 * registers[X(opcode)]);
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Store BCD representation of Vx in memory locations I, I+1 and I+2
@@ -604,26 +765,35 @@ void Chip8::OP_Fx33()
 {
 	uint8_t decimalVal = registers[X(opcode)];
 
-	memory[index + 2] = decimalVal % 10;
+	//I can point anywhere, wrap at the end of memory
+	CheckSpan(*this, 3);
+	memory[(index + 2) & ADDRESS_MASK] = decimalVal % 10;
 	decimalVal /= 10;
-	memory[index + 1] = (decimalVal % 10);
+	memory[(index + 1) & ADDRESS_MASK] = (decimalVal % 10);
 	decimalVal /= 10;
-	memory[index] = decimalVal % 10;
+	memory[index & ADDRESS_MASK] = decimalVal % 10;
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Store the values of registers V0 to VX inclusive in memory starting at address I
 void Chip8::OP_Fx55()
 {
+	CheckSpan(*this, X(opcode) + 1u);
+	if (quirks.loadStoreMovesI)
+	{
+		OP_Fx55_alt();
+		return;
+	}
+
 	uint8_t Vx = X(opcode);
 	for (int i = 0; i <= Vx; ++i)
 	{
-		memory[index + i] = registers[i];
+		memory[(index + i) & ADDRESS_MASK] = registers[i];
 
 		//print current function
-		std::cout << __FUNCTION__ << std::endl;
+		TRACE_OP();
 	}
 }
 
@@ -635,24 +805,31 @@ void Chip8::OP_Fx55_alt()
 	uint8_t Vx = X(opcode);
 	for (int i = 0; i <= Vx; ++i)
 	{
-		memory[index + i] = registers[i];
+		memory[(index + i) & ADDRESS_MASK] = registers[i];
 	}
 	index = index + Vx + 1;
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
 
 //Fill registers V0 to VX inclusive with the values stored in memory starting at address I
 void Chip8::OP_Fx65()
 {
+	CheckSpan(*this, X(opcode) + 1u);
+	if (quirks.loadStoreMovesI)
+	{
+		OP_Fx65_alt();
+		return;
+	}
+
 	uint8_t Vx = X(opcode);
 	for (int i = 0; i <= Vx; ++i)
 	{
-		registers[i] = memory[index + i];
+		registers[i] = memory[(index + i) & ADDRESS_MASK];
 
 		//print current function
-		std::cout << __FUNCTION__ << std::endl;
+		TRACE_OP();
 	}
 }
 
@@ -664,11 +841,11 @@ void Chip8::OP_Fx65_alt()
 	uint8_t Vx = X(opcode);
 	for (int i = 0; i <= Vx; ++i)
 	{
-		registers[i] = memory[index + i];
+		registers[i] = memory[(index + i) & ADDRESS_MASK];
 	}
 
 	index = index + Vx + 1;
 
 	//print current function
-	std::cout << __FUNCTION__ << std::endl;
+	TRACE_OP();
 }
@@ -1,7 +1,11 @@
 #pragma once
 #include "defines.h"
+#include "Random.h"
 
-#include <random>
+#include <algorithm>
+#include <array>
+#include <string>
+#include <type_traits>
 
 const unsigned int KEY_COUNT = 16;
 const unsigned int MEMORY_MAX = 4096;
@@ -14,35 +18,169 @@ const unsigned int START_ADDRESS = 0x200;
 const unsigned int FONT_SIZE = 80;
 const unsigned int FONT_START_ADDRESS = 0x50;
 
-class Chip8
+//addresses are masked into memory rather than checked
+const unsigned int ADDRESS_MASK = MEMORY_MAX - 1;
+static_assert((MEMORY_MAX & ADDRESS_MASK) == 0, "MEMORY_MAX must be a power of two");
+
+//machine exceptions - what an untrusted ROM or state did that the hardware has no
+//answer for; the machine carries on in a defined way and the bit stays set in
+//Chip8State::faults until Reset() or ClearFaults()
+enum Chip8Fault : uint8_t
+{
+	FAULT_STACK_OVERFLOW = 0x01,	//2nnn with every stack level in use - the call is ignored
+	FAULT_STACK_UNDERFLOW = 0x02,	//00EE with an empty stack - the return is ignored
+	FAULT_ADDRESS_WRAP = 0x04,		//Dxyn/Fx33/Fx55/Fx65 ran past the end of memory and wrapped to 0
+	FAULT_INVALID_OPCODE = 0x08,	//no instruction decodes to it - nothing is done
+	FAULT_ROM_SIZE = 0x10			//LoadROM() dropped what did not fit after START_ADDRESS
+};
+
+//everything that makes up a running machine - plain data with no constructor,
+//so a save state, a pool slot or a clone is a single copy
+struct Chip8State
+{
+	uint8_t memory[MEMORY_MAX];		//general memory
+	uint32_t video[VIDEO_WIDTH * VIDEO_HEIGHT];	//64 px * 32 px display memory buffer
+
+	uint8_t registers[REGISTER_COUNT];	//dedicated CPU storage
+	uint16_t index;	//Index Register - stores memory addresses for use in operations
+	uint16_t pc;	//Program Counter - holds address of next instruction
+	uint16_t stack[STACK_LEVELS + 1];	//keep track of execution order (call stack), then a guard slot
+	uint8_t sp;	//Stack Pointer (to index of stack array) - keep track of stack level where most recent value was placed
+	uint8_t delayTimer;
+	uint8_t soundTimer;
+	uint16_t opcode;
+	bool keyWait;	//Fx0A found no key down and will run again
+	uint8_t faults;	//Chip8Fault bits raised so far
+	uint32_t rngDraws;	//bytes Cxkk has drawn from its stream
+	uint64_t rngKey;	//Cxkk stream of this seed and instance (Chip8Random::Key)
+	uint64_t cycles;	//emulated 1802 machine cycles, advanced by RunFrame() only
+	bool keypad[KEY_COUNT];
+};
+
+static_assert(std::is_trivial<Chip8State>::value, "Chip8State must stay plain data");
+
+//----------------------------------
+//			Hardened access
+//----------------------------------
+
+//A state can come from an untrusted ROM, LoadState() or gdb, so pc, I and sp may
+//hold anything. Memory addresses are masked with ADDRESS_MASK and sp is clamped
+//into the stack and its guard slot, so no value reaches outside Chip8State; what
+//would have gone wrong is ORed into faults with a select rather than a branch.
+//Shared by the interpreter and recompiled code (Recompiled.h).
+
+//2nnn: push returnAddress unless the stack is full; returns whether the call happens
+inline bool PushStack(Chip8State& s, uint16_t returnAddress)
+{
+	unsigned int top = std::min<unsigned int>(s.sp, STACK_LEVELS);
+	bool full = top == STACK_LEVELS;
+	//a full stack writes the guard slot, which nothing reads
+	s.stack[top] = returnAddress;
+	s.sp = static_cast<uint8_t>(top + !full);
+	s.faults |= full ? FAULT_STACK_OVERFLOW : 0;
+	return !full;
+}
+
+//00EE: the address to return to, or fallback (the next instruction) with an empty stack
+inline uint16_t PopStack(Chip8State& s, uint16_t fallback)
+{
+	unsigned int top = std::min<unsigned int>(s.sp, STACK_LEVELS);
+	bool empty = top == 0;
+	s.sp = static_cast<uint8_t>(top - !empty);
+	s.faults |= empty ? FAULT_STACK_UNDERFLOW : 0;
+	return empty ? fallback : s.stack[s.sp];
+}
+
+//count bytes from I are about to be read or written through ADDRESS_MASK
+inline void CheckSpan(Chip8State& s, unsigned int count)
 {
+	s.faults |= s.index + count > MEMORY_MAX ? FAULT_ADDRESS_WRAP : 0;
+}
+
+//behaviours that differ between CHIP-8 interpreters; all false is what this
+//interpreter has always done
+struct Quirks
+{
+	bool shiftUsesVy;		//8xy6/8xyE shift Vy into Vx rather than shifting Vx in place
+	bool loadStoreMovesI;	//Fx55/Fx65 leave I one past the last register
+};
+
+//named profiles for the command line and batch runs
+const Quirks QUIRKS_MODERN = { false, false };
+const Quirks QUIRKS_VIP = { true, true };
+
+//QUIRKS_MODERN for "modern", QUIRKS_VIP for "vip"; false for anything else
+bool QuirksByName(const std::string& name, Quirks& quirks);
+
+//"stack overflow, invalid opcode" for the bits set in faults, "none" for 0
+std::string FaultNames(uint8_t faults);
+
+//running totals read by Metrics - kept out of Chip8State so save states don't
+//carry them; plain integers, only the thread running the machine touches them
+struct Chip8Stats
+{
+	uint64_t instructions;
+	uint64_t draws;
+	uint64_t collisions;		//draws that set VF
+	uint64_t timerUnderflows;	//delay or sound timer ran out (ticked from 1 to 0)
+};
+
+class Chip8 : private Chip8State
+{
+	//debug engine variant - drives Cycle() one instruction at a time and inspects state
+	friend class Debugger;
+	//remote debugging - only touches state between instructions
+	friend class GdbStub;
+	//differential fuzzing harness (tools/fuzz_chip8.cpp) compares full machine state
+	friend struct Chip8Fuzzer;
+	//ahead-of-time compiled ROMs run on the state directly and hand back to Cycle()
+	friend class Recompiled;
+
 public:
 	Chip8();
+	//back to power-on state (fonts loaded, memory and display cleared) without reallocating
+	//the seeded overload makes Cxkk reproducible; instances of one batch share the
+	//seed and differ in instance id
+	void Reset();
+	void Reset(uint32_t seed, uint32_t instance = 0);
+	void SaveState(Chip8State& state) const;
+	void LoadState(const Chip8State& state);
 	void LoadROM(char const* filename);
+	//load an image already in memory (benchmarks, fuzzing, batch runs)
+	void LoadROM(const uint8_t* data, size_t size);
+	//untimed: one instruction and one timer tick, paced by the caller
 	void Cycle();
+	//the two halves of Cycle()
+	void Step();
+	void TickTimers();
+	//COSMAC VIP timed mode: instructions until the cycle counter reaches the next
+	//60 Hz frame boundary (Dxyn waits for it), then one timer tick
+	//returns the number of instructions executed
+	unsigned int RunFrame();
+	uint64_t Cycles() const { return cycles; }
+	//blocked in Fx0A - every further Step() repeats the wait until a key goes down
+	bool WaitingForKey() const { return keyWait; }
+	//waiting with both timers at 0: more cycles change nothing until there is input
+	bool Idle() const { return keyWait && delayTimer == 0 && soundTimer == 0; }
+	//cleared by Reset()
+	const Chip8Stats& Stats() const { return stats; }
+	//read-only view of all MEMORY_MAX bytes (memory scans, watched values)
+	const uint8_t* Memory() const { return memory; }
+	//Chip8Fault bits raised since Reset() or ClearFaults()
+	uint8_t Faults() const { return faults; }
+	void ClearFaults() { faults = 0; }
+	//kept across Reset(), like the ROM's expectations they describe
+	void SetQuirks(const Quirks& value) { quirks = value; }
 
 	//public accessed by main.cpp
-	uint32_t video[VIDEO_WIDTH * VIDEO_HEIGHT]{};	//64 px * 32 px display memory buffer
-	bool keypad[KEY_COUNT]{};
+	using Chip8State::video;
+	using Chip8State::keypad;
 	//game speed control
 	float speed = 0;
-	float* pGameSpeed = &speed;
 
 private:
-	uint8_t registers[REGISTER_COUNT]{};	//dedicated CPU storage
-	uint8_t memory[MEMORY_MAX]{};		//general memory
-	uint16_t index{};	//Index Register - stores memory addresses for use in operations
-	uint16_t pc{};	//Program Counter - holds address of next instruction
-	uint16_t stack[STACK_LEVELS]{};	//keep track of execution order (call stack)
-	uint8_t sp{};	//Stack Pointer (to index of stack array) - keep track of stack level where most recent value was placed
-	uint8_t delayTimer{};
-	uint8_t soundTimer{};
-	uint16_t opcode;
-
-	std::vector<uint8_t> keyList;
-
-	std::mt19937 randGen;
-	std::uniform_int_distribution<int> randByte; //uint8_t not valid template parameter?
+	Chip8Stats stats;
+	Quirks quirks = QUIRKS_MODERN;
 
 	void Table0();
 	void Table8();
@@ -136,15 +274,14 @@ private:
 
 	//define pointer-to-function type
 	using Chip8Func = void (Chip8::*)();
-	typedef void (Chip8::* Chip8Func)();
-	//index up to 0xF + 1 (16)
-	Chip8Func table[0xF + 1]{ &Chip8::OP_NULL };
-	//index up to 0xE + 1 (15)
-	Chip8Func table0[0xE + 1]{ &Chip8::OP_NULL };
-	//index up to 0xE + 1 (15)
-	Chip8Func table8[0xE + 1]{ &Chip8::OP_NULL };
-	//index up to 0xE + 1 (15)
-	Chip8Func tableE[0xE + 1]{ &Chip8::OP_NULL };
-	//index up to 0x65 + 1 (102)
-	Chip8Func tableF[0x65 + 1]{ &Chip8::OP_NULL };
+	//dispatch tables are shared by every instance and built at compile time
+	//sub tables cover every value of their index so no opcode can read past them
+	static const Chip8Func table[0xF + 1];
+	static const Chip8Func table0[0xF + 1];
+	static const Chip8Func table8[0xF + 1];
+	static const Chip8Func tableE[0xF + 1];
+	static const std::array<Chip8Func, 0xFF + 1> tableF;
+	static constexpr std::array<Chip8Func, 0xFF + 1> BuildTableF();
 };
+
+static_assert(std::is_trivially_copyable<Chip8>::value, "Chip8 instances are copied and pooled as plain data");
@@ -0,0 +1,46 @@
+#include "Chip8Pool.h"
+
+#include <new>
+
+
+Chip8Pool::Chip8Pool(size_t capacity)
+	//operator new[] storage is aligned for any fundamental type, and sizeof(Chip8) keeps every slot aligned
+	: arena(new unsigned char[capacity * sizeof(Chip8)]), capacity(capacity)
+{
+	freeList.reserve(capacity);
+}
+
+Chip8* Chip8Pool::Acquire()
+{
+	return Acquire(static_cast<uint32_t>(CLOCKCOUNT));
+}
+
+Chip8* Chip8Pool::Acquire(uint32_t seed, uint32_t instance)
+{
+	Chip8* chip8 = nullptr;
+
+	if (!freeList.empty())
+	{
+		chip8 = freeList.back();
+		freeList.pop_back();
+	}
+	else if (constructed < capacity)
+	{
+		chip8 = new (Slot(constructed++)) Chip8();
+	}
+	else
+	{
+		return nullptr;
+	}
+
+	chip8->Reset(seed, instance);
+	return chip8;
+}
+
+void Chip8Pool::Release(Chip8* chip8)
+{
+	if (chip8)
+	{
+		freeList.push_back(chip8);
+	}
+}
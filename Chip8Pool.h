@@ -0,0 +1,39 @@
+#pragma once
+#include "Chip8.h"
+
+#include <memory>
+#include <vector>
+
+//Fixed capacity pool of interpreter instances for batch runs that create and
+//discard many short-lived machines.
+//
+//All instances live in one arena allocated up front and are constructed the first
+//time their slot is handed out. Released instances go on a free list and are only
+//Reset() when acquired again, so Acquire/Release never touch the heap.
+class Chip8Pool
+{
+public:
+	explicit Chip8Pool(size_t capacity);
+
+	Chip8Pool(const Chip8Pool&) = delete;
+	Chip8Pool& operator=(const Chip8Pool&) = delete;
+
+	//a power-on instance, or nullptr when every slot is in use
+	Chip8* Acquire();
+	Chip8* Acquire(uint32_t seed, uint32_t instance = 0);
+	void Release(Chip8* chip8);
+
+	size_t Capacity() const { return capacity; }
+	size_t InUse() const { return constructed - freeList.size(); }
+
+private:
+	//Chip8 has no destructor to run, so the arena can be dropped as raw storage
+	static_assert(std::is_trivially_destructible<Chip8>::value, "pooled instances are never destroyed individually");
+
+	std::unique_ptr<unsigned char[]> arena;
+	size_t capacity;
+	size_t constructed = 0;
+	std::vector<Chip8*> freeList;
+
+	Chip8* Slot(size_t i) { return reinterpret_cast<Chip8*>(arena.get() + i * sizeof(Chip8)); }
+};
@@ -0,0 +1,918 @@
+#include "Debugger.h"
+#include "Disassembler.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+
+
+Debugger::Debugger(Chip8& chip8)
+	: chip8(chip8)
+{
+	//history starts where the debugger was attached
+	ClearHistory();
+}
+
+//----------------------------------
+//			Execution
+//----------------------------------
+
+bool Debugger::MemoryAccess(uint16_t opcode, uint16_t& start, unsigned int& length, bool& write) const
+{
+	start = chip8.index;
+
+	switch (I(opcode))
+	{
+	case 0xD:
+	{
+		//sprite read
+		length = opcode & 0x000Fu;
+		write = false;
+		return length > 0;
+	}
+	case 0xF:
+	{
+		switch (KK(opcode))
+		{
+		case 0x33:
+		{
+			length = 3;
+			write = true;
+			return true;
+		}
+		case 0x55:
+		{
+			length = X(opcode) + 1;
+			write = true;
+			return true;
+		}
+		case 0x65:
+		{
+			length = X(opcode) + 1;
+			write = false;
+			return true;
+		}
+		}
+	} break;
+	}
+
+	return false;
+}
+
+bool Debugger::ConditionHit() const
+{
+	for (const BreakCondition& condition : conditions)
+	{
+		uint8_t value = chip8.registers[condition.reg];
+		bool hit = false;
+
+		switch (condition.compare)
+		{
+		case Compare::Equal: hit = value == condition.value; break;
+		case Compare::NotEqual: hit = value != condition.value; break;
+		case Compare::Less: hit = value < condition.value; break;
+		case Compare::Greater: hit = value > condition.value; break;
+		case Compare::LessEqual: hit = value <= condition.value; break;
+		case Compare::GreaterEqual: hit = value >= condition.value; break;
+		}
+
+		if (hit)
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+uint16_t Debugger::RegisterWrites(uint16_t opcode) const
+{
+	uint16_t vx = static_cast<uint16_t>(1u << X(opcode));
+	const uint16_t VF = 1u << 0xF;
+
+	switch (I(opcode))
+	{
+	case 0x6:
+	case 0x7:
+	case 0xC:
+		return vx;
+	case 0x8:
+	{
+		switch (opcode & 0x000Fu)
+		{
+		case 0x0: case 0x1: case 0x2: case 0x3:
+			return vx;
+		case 0x4: case 0x5: case 0x6: case 0x7: case 0xE:
+			return vx | VF;
+		}
+	} break;
+	case 0xD:
+		return VF;
+	case 0xF:
+	{
+		switch (KK(opcode))
+		{
+		case 0x07:
+		case 0x0A:
+			return vx;
+		case 0x65:
+			return static_cast<uint16_t>((2u << X(opcode)) - 1);
+		}
+	} break;
+	}
+
+	return 0;
+}
+
+StopReason Debugger::WatchCheck(uint16_t opcode)
+{
+	uint16_t start;
+	unsigned int length;
+	bool write;
+
+	if (MemoryAccess(opcode, start, length, write))
+	{
+		const std::bitset<MEMORY_MAX>& watch = write ? writeWatch : readWatch;
+		for (unsigned int i = 0; i < length; ++i)
+		{
+			uint16_t address = (start + i) & ADDRESS_MASK;
+			if (watch[address])
+			{
+				lastWatchAddress = address;
+				return write ? StopReason::WatchWrite : StopReason::WatchRead;
+			}
+		}
+	}
+
+	return StopReason::None;
+}
+
+StopReason Debugger::Execute()
+{
+	//running forward from the past starts a new future
+	if (position < historyEnd)
+	{
+		Truncate();
+	}
+	if (memcmp(chip8.keypad, lastKeypad, sizeof(lastKeypad)) != 0)
+	{
+		//after a rewind onto a logged change the new keypad replaces it - replay
+		//applies only one change per position
+		if (inputLog.empty() || inputLog.back().position != position)
+		{
+			inputLog.emplace_back();
+			inputLog.back().position = position;
+		}
+		memcpy(inputLog.back().keypad, chip8.keypad, sizeof(chip8.keypad));
+		memcpy(lastKeypad, chip8.keypad, sizeof(lastKeypad));
+	}
+
+	//decode ahead of Cycle() so the handlers themselves stay untouched
+	uint16_t opcode = (chip8.memory[chip8.pc & ADDRESS_MASK] << 8u) | chip8.memory[(chip8.pc + 1) & ADDRESS_MASK];
+	StopReason reason = WatchCheck(opcode);
+	uint8_t faults = chip8.faults;
+
+	chip8.Cycle();
+
+	historyEnd = ++position;
+	if (position - checkpoints.back().position >= historyInterval)
+	{
+		AddCheckpoint();
+	}
+
+	if (reason == StopReason::None && (chip8.faults & ~faults) != 0)
+	{
+		reason = StopReason::Fault;
+	}
+	if (reason == StopReason::None && !conditions.empty() && ConditionHit())
+	{
+		reason = StopReason::Condition;
+	}
+
+	return reason;
+}
+
+StopReason Debugger::Continue(unsigned int limit)
+{
+	for (unsigned int i = 0; i < limit; ++i)
+	{
+		//the instruction we are stopped on never re-triggers its own breakpoint
+		if (i > 0 && breakpoints[chip8.pc & ADDRESS_MASK])
+		{
+			return lastStop = StopReason::Breakpoint;
+		}
+
+		StopReason reason = Execute();
+		if (reason != StopReason::None)
+		{
+			return lastStop = reason;
+		}
+	}
+
+	return lastStop = StopReason::Limit;
+}
+
+void Debugger::Resume()
+{
+	stopped = false;
+	resuming = true;
+	lastStop = StopReason::None;
+}
+
+StopReason Debugger::Run()
+{
+	if (!resuming && breakpoints[chip8.pc & ADDRESS_MASK])
+	{
+		stopped = true;
+		return lastStop = StopReason::Breakpoint;
+	}
+	resuming = false;
+
+	StopReason reason = Execute();
+	if (reason != StopReason::None)
+	{
+		stopped = true;
+		lastStop = reason;
+	}
+
+	return reason;
+}
+
+StopReason Debugger::Step(unsigned int count)
+{
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		StopReason reason = Execute();
+		if (reason != StopReason::None)
+		{
+			return lastStop = reason;
+		}
+	}
+
+	return lastStop = StopReason::Step;
+}
+
+StopReason Debugger::StepOver(unsigned int limit)
+{
+	uint16_t opcode = (chip8.memory[chip8.pc & ADDRESS_MASK] << 8u) | chip8.memory[(chip8.pc + 1) & ADDRESS_MASK];
+
+	//anything other than CALL is a plain step
+	if (I(opcode) != 0x2)
+	{
+		return Step();
+	}
+
+	uint8_t depth = chip8.sp;
+	uint16_t returnAddress = (chip8.pc + 2) & ADDRESS_MASK;
+
+	for (unsigned int i = 0; i < limit; ++i)
+	{
+		if (i > 0 && breakpoints[chip8.pc & ADDRESS_MASK])
+		{
+			return lastStop = StopReason::Breakpoint;
+		}
+
+		StopReason reason = Execute();
+		if (reason != StopReason::None)
+		{
+			return lastStop = reason;
+		}
+
+		if (chip8.sp == depth && chip8.pc == returnAddress)
+		{
+			return lastStop = StopReason::Return;
+		}
+	}
+
+	return lastStop = StopReason::Limit;
+}
+
+StopReason Debugger::StepOut(unsigned int limit)
+{
+	uint8_t depth = chip8.sp;
+
+	for (unsigned int i = 0; i < limit; ++i)
+	{
+		if (i > 0 && breakpoints[chip8.pc & ADDRESS_MASK])
+		{
+			return lastStop = StopReason::Breakpoint;
+		}
+
+		StopReason reason = Execute();
+		if (reason != StopReason::None)
+		{
+			return lastStop = reason;
+		}
+
+		if (chip8.sp < depth)
+		{
+			return lastStop = StopReason::Return;
+		}
+	}
+
+	return lastStop = StopReason::Limit;
+}
+
+//----------------------------------
+//			Reverse execution
+//----------------------------------
+
+void Debugger::AddCheckpoint()
+{
+	Checkpoint checkpoint;
+	checkpoint.position = position;
+	chip8.SaveState(checkpoint.state);
+	checkpoints.push_back(checkpoint);
+	TrimHistory();
+}
+
+//drop the oldest checkpoints over the limit and the input only they needed
+void Debugger::TrimHistory()
+{
+	while (checkpoints.size() > historyLimit)
+	{
+		checkpoints.pop_front();
+	}
+	while (!inputLog.empty() && inputLog.front().position < checkpoints.front().position)
+	{
+		inputLog.pop_front();
+	}
+}
+
+void Debugger::Truncate()
+{
+	while (checkpoints.back().position > position)
+	{
+		checkpoints.pop_back();
+	}
+	while (!inputLog.empty() && inputLog.back().position > position)
+	{
+		inputLog.pop_back();
+	}
+	historyEnd = position;
+}
+
+void Debugger::ApplyInput(std::deque<InputChange>::const_iterator& input, uint64_t at)
+{
+	if (input != inputLog.end() && input->position == at)
+	{
+		memcpy(chip8.keypad, input->keypad, sizeof(input->keypad));
+		++input;
+	}
+}
+
+void Debugger::Replay(uint64_t target)
+{
+	//closest checkpoint at or before target, then the same instructions with the same input
+	auto checkpoint = std::upper_bound(checkpoints.begin(), checkpoints.end(), target,
+		[](uint64_t value, const Checkpoint& c) { return value < c.position; }) - 1;
+	chip8.LoadState(checkpoint->state);
+	//re-running instructions already counted is not new work
+	Chip8Stats stats = chip8.stats;
+
+	std::deque<InputChange>::const_iterator input = std::lower_bound(inputLog.begin(), inputLog.end(), checkpoint->position,
+		[](const InputChange& change, uint64_t value) { return change.position < value; });
+	for (uint64_t at = checkpoint->position; at < target; ++at)
+	{
+		ApplyInput(input, at);
+		chip8.Cycle();
+	}
+	//the keypad the next instruction saw
+	ApplyInput(input, target);
+	chip8.stats = stats;
+
+	position = target;
+	memcpy(lastKeypad, chip8.keypad, sizeof(lastKeypad));
+}
+
+bool Debugger::FindLast(Search search, uint16_t target, uint64_t& found, StopReason& reason)
+{
+	//newest segment first: each is re-executed from its checkpoint up to the next one,
+	//without counting the instructions again
+	Chip8Stats stats = chip8.stats;
+	for (size_t segment = checkpoints.size(); segment-- > 0;)
+	{
+		uint64_t start = checkpoints[segment].position;
+		if (start >= position)
+		{
+			continue;
+		}
+		uint64_t end = segment + 1 < checkpoints.size() ? std::min(checkpoints[segment + 1].position, position) : position;
+
+		chip8.LoadState(checkpoints[segment].state);
+		std::deque<InputChange>::const_iterator input = std::lower_bound(inputLog.begin(), inputLog.end(), start,
+			[](const InputChange& change, uint64_t value) { return change.position < value; });
+
+		bool hit = false;
+		for (uint64_t at = start; at < end; ++at)
+		{
+			ApplyInput(input, at);
+			uint16_t opcode = (chip8.memory[chip8.pc & ADDRESS_MASK] << 8u) | chip8.memory[(chip8.pc + 1) & ADDRESS_MASK];
+			bool before = false;
+			StopReason after = StopReason::None;
+
+			switch (search)
+			{
+			case Search::Stop:
+			{
+				if (breakpoints[chip8.pc & ADDRESS_MASK])
+				{
+					found = at;
+					reason = StopReason::Breakpoint;
+					hit = true;
+				}
+				after = WatchCheck(opcode);
+			} break;
+			case Search::MemoryWrite:
+			{
+				uint16_t first;
+				unsigned int length;
+				bool write;
+				before = MemoryAccess(opcode, first, length, write) && write && ((target - first) & ADDRESS_MASK) < length;
+			} break;
+			case Search::RegisterWrite:
+				break;
+			}
+
+			uint8_t faults = chip8.faults;
+			chip8.Cycle();
+
+			//Fx0A only writes once a key is down
+			if (search == Search::RegisterWrite && (RegisterWrites(opcode) >> target & 1u)
+				&& !(I(opcode) == 0xF && KK(opcode) == 0x0A && chip8.keyWait))
+			{
+				before = true;
+			}
+			if (search == Search::Stop && after == StopReason::None && (chip8.faults & ~faults) != 0)
+			{
+				after = StopReason::Fault;
+			}
+			if (search == Search::Stop && after == StopReason::None && !conditions.empty() && ConditionHit())
+			{
+				after = StopReason::Condition;
+			}
+
+			if (before)
+			{
+				found = at;
+				reason = StopReason::LastWrite;
+				hit = true;
+			}
+			else if (after != StopReason::None && at + 1 < position)
+			{
+				found = at + 1;
+				reason = after;
+				hit = true;
+			}
+		}
+
+		if (hit)
+		{
+			chip8.stats = stats;
+			Replay(found);
+			return true;
+		}
+	}
+
+	chip8.stats = stats;
+	return false;
+}
+
+StopReason Debugger::ReverseStep(unsigned int count)
+{
+	uint64_t oldest = checkpoints.front().position;
+	if (position - oldest < count)
+	{
+		Replay(oldest);
+		return lastStop = StopReason::HistoryStart;
+	}
+
+	Replay(position - count);
+	return lastStop = StopReason::Step;
+}
+
+StopReason Debugger::ReverseContinue()
+{
+	uint64_t found;
+	StopReason reason;
+	if (FindLast(Search::Stop, 0, found, reason))
+	{
+		return lastStop = reason;
+	}
+
+	Replay(checkpoints.front().position);
+	return lastStop = StopReason::HistoryStart;
+}
+
+StopReason Debugger::ReverseToWrite(uint16_t address)
+{
+	uint64_t found;
+	StopReason reason;
+	if (FindLast(Search::MemoryWrite, address & ADDRESS_MASK, found, reason))
+	{
+		lastWatchAddress = address & ADDRESS_MASK;
+		return lastStop = reason;
+	}
+
+	Replay(checkpoints.front().position);
+	return lastStop = StopReason::HistoryStart;
+}
+
+StopReason Debugger::ReverseToRegisterWrite(uint8_t reg)
+{
+	uint64_t found;
+	StopReason reason;
+	if (FindLast(Search::RegisterWrite, reg & 0xFu, found, reason))
+	{
+		return lastStop = reason;
+	}
+
+	Replay(checkpoints.front().position);
+	return lastStop = StopReason::HistoryStart;
+}
+
+void Debugger::SetHistory(unsigned int interval, size_t limit)
+{
+	historyInterval = std::max(interval, 1u);
+	historyLimit = std::max<size_t>(limit, 1);
+	TrimHistory();
+}
+
+void Debugger::ClearHistory()
+{
+	checkpoints.clear();
+	inputLog.clear();
+	historyEnd = position;
+	AddCheckpoint();
+	memcpy(lastKeypad, chip8.keypad, sizeof(lastKeypad));
+}
+
+void Debugger::StateChanged()
+{
+	if (position < historyEnd)
+	{
+		Truncate();
+	}
+
+	//replays that reach this point must start from the changed machine
+	if (checkpoints.back().position == position)
+	{
+		chip8.SaveState(checkpoints.back().state);
+	}
+	else
+	{
+		AddCheckpoint();
+	}
+	memcpy(lastKeypad, chip8.keypad, sizeof(lastKeypad));
+}
+
+//----------------------------------
+//			Breakpoints
+//----------------------------------
+
+void Debugger::SetBreakpoint(uint16_t address, bool enabled)
+{
+	breakpoints[address & ADDRESS_MASK] = enabled;
+}
+
+void Debugger::SetWatchpoint(uint16_t address, unsigned int length, bool read, bool write)
+{
+	//longer would only go round memory again
+	length = std::min(length, MEMORY_MAX);
+	for (unsigned int i = 0; i < length; ++i)
+	{
+		uint16_t watched = (address + i) & ADDRESS_MASK;
+		readWatch[watched] = read;
+		writeWatch[watched] = write;
+	}
+}
+
+void Debugger::ChangeWatchpoint(uint16_t address, unsigned int length, bool read, bool write, bool enabled)
+{
+	length = std::min(length, MEMORY_MAX);
+	for (unsigned int i = 0; i < length; ++i)
+	{
+		uint16_t watched = (address + i) & ADDRESS_MASK;
+		if (read)
+		{
+			readWatch[watched] = enabled;
+		}
+		if (write)
+		{
+			writeWatch[watched] = enabled;
+		}
+	}
+}
+
+void Debugger::AddCondition(const BreakCondition& condition)
+{
+	conditions.push_back(condition);
+}
+
+void Debugger::AddDisplay(const MemoryWatch& watch)
+{
+	displays.push_back(watch);
+}
+
+void Debugger::ClearAll()
+{
+	breakpoints.reset();
+	readWatch.reset();
+	writeWatch.reset();
+	conditions.clear();
+	displays.clear();
+}
+
+//----------------------------------
+//			Terminal UI
+//----------------------------------
+
+const char* Debugger::ReasonName(StopReason reason) const
+{
+	switch (reason)
+	{
+	case StopReason::Step: return "step";
+	case StopReason::Breakpoint: return "breakpoint";
+	case StopReason::WatchRead: return "read watchpoint";
+	case StopReason::WatchWrite: return "write watchpoint";
+	case StopReason::Condition: return "condition";
+	case StopReason::Fault: return "fault";
+	case StopReason::Return: return "returned";
+	case StopReason::Limit: return "instruction limit";
+	case StopReason::LastWrite: return "last write";
+	case StopReason::HistoryStart: return "start of history";
+	default: return "running";
+	}
+}
+
+void Debugger::PrintState(std::ostream& out) const
+{
+	char line[96];
+
+	snprintf(line, sizeof(line), "[%s] #%llu pc=0x%03X I=0x%03X sp=%u DT=%02X ST=%02X\n", ReasonName(lastStop),
+		static_cast<unsigned long long>(position), chip8.pc, chip8.index, chip8.sp, chip8.delayTimer, chip8.soundTimer);
+	out << line;
+	if (lastStop == StopReason::WatchRead || lastStop == StopReason::WatchWrite)
+	{
+		snprintf(line, sizeof(line), "watched address 0x%03X\n", lastWatchAddress);
+		out << line;
+	}
+	if (chip8.faults != 0)
+	{
+		out << "faults: " << FaultNames(chip8.faults) << "\n";
+	}
+
+	for (unsigned int i = 0; i < REGISTER_COUNT; ++i)
+	{
+		snprintf(line, sizeof(line), "V%X=%02X%s", i, chip8.registers[i], i == 7 || i == 0xF ? "\n" : " ");
+		out << line;
+	}
+
+	for (const MemoryWatch& watch : displays)
+	{
+		snprintf(line, sizeof(line), "%s [0x%03X] = %02X (%u)\n", watch.name.c_str(), watch.address,
+			chip8.memory[watch.address], chip8.memory[watch.address]);
+		out << line;
+	}
+
+	out << "stack:";
+	for (unsigned int i = 0; i < chip8.sp && i < STACK_LEVELS; ++i)
+	{
+		snprintf(line, sizeof(line), " 0x%03X", chip8.stack[i]);
+		out << line;
+	}
+	out << "\n";
+
+	//a few instructions either side of pc
+	unsigned int first = chip8.pc >= 6 ? chip8.pc - 6 : chip8.pc & 1u;
+	for (unsigned int address = first; address < chip8.pc + 10u && address + 1 < MEMORY_MAX; address += 2)
+	{
+		uint16_t opcode = (chip8.memory[address] << 8u) | chip8.memory[address + 1];
+		snprintf(line, sizeof(line), "%c%c0x%03X  %04X  ", address == chip8.pc ? '>' : ' ',
+			breakpoints[address] ? '*' : ' ', address, opcode);
+		out << line << Disassemble(opcode) << "\n";
+	}
+}
+
+void Debugger::PrintMemory(std::ostream& out, uint16_t address, unsigned int length) const
+{
+	char line[16];
+
+	for (unsigned int i = 0; i < length; ++i)
+	{
+		uint16_t current = (address + i) & ADDRESS_MASK;
+		if (i % 16 == 0)
+		{
+			snprintf(line, sizeof(line), "%s0x%03X:", i ? "\n" : "", current);
+			out << line;
+		}
+		snprintf(line, sizeof(line), " %02X", chip8.memory[current]);
+		out << line;
+	}
+	out << "\n";
+}
+
+//V<x> or v<x>, x a single hex digit
+static bool ParseRegister(const std::string& text, uint8_t& reg)
+{
+	if (text.size() != 2 || (text[0] != 'V' && text[0] != 'v') || !isxdigit(static_cast<unsigned char>(text[1])))
+	{
+		return false;
+	}
+	reg = static_cast<uint8_t>(strtoul(text.c_str() + 1, nullptr, 16));
+	return true;
+}
+
+bool Debugger::Command(const std::string& line, std::ostream& out)
+{
+	//all numbers are hex
+	const unsigned int RUN_LIMIT = 10000000;
+
+	std::istringstream input(line);
+	std::string command;
+	input >> command >> std::hex;
+
+	if (command.empty() || command == "r")
+	{
+		PrintState(out);
+	}
+	else if (command == "s")
+	{
+		unsigned int count = 1;
+		input >> count;
+		Step(count);
+		PrintState(out);
+	}
+	else if (command == "n")
+	{
+		StepOver(RUN_LIMIT);
+		PrintState(out);
+	}
+	else if (command == "f")
+	{
+		StepOut(RUN_LIMIT);
+		PrintState(out);
+	}
+	else if (command == "c")
+	{
+		Resume();
+	}
+	else if (command == "rs")
+	{
+		unsigned int count = 1;
+		input >> count;
+		ReverseStep(count);
+		PrintState(out);
+	}
+	else if (command == "rc")
+	{
+		ReverseContinue();
+		PrintState(out);
+	}
+	else if (command == "rw")
+	{
+		unsigned int address;
+		if (input >> address)
+		{
+			ReverseToWrite(static_cast<uint16_t>(address));
+			PrintState(out);
+		}
+	}
+	else if (command == "rv")
+	{
+		//rv V<x>
+		std::string text;
+		uint8_t reg;
+		if (!(input >> text) || !ParseRegister(text, reg))
+		{
+			out << "usage: rv V<x>\n";
+		}
+		else
+		{
+			ReverseToRegisterWrite(reg);
+			PrintState(out);
+		}
+	}
+	else if (command == "history")
+	{
+		//history [interval] [checkpoints]
+		unsigned int interval;
+		unsigned int limit = static_cast<unsigned int>(historyLimit);
+		if (input >> interval)
+		{
+			input >> limit;
+			SetHistory(interval, limit);
+		}
+
+		char line[128];
+		snprintf(line, sizeof(line), "history: %zu of %zu checkpoints, every %X instructions, back to #%llu (%zu KB)\n",
+			checkpoints.size(), historyLimit, historyInterval, static_cast<unsigned long long>(checkpoints.front().position),
+			checkpoints.size() * sizeof(Checkpoint) / 1024);
+		out << line;
+	}
+	else if (command == "b" || command == "d")
+	{
+		unsigned int address;
+		if (input >> address)
+		{
+			SetBreakpoint(address, command == "b");
+		}
+	}
+	else if (command == "w")
+	{
+		//w <addr> [len] [r|w|rw]
+		unsigned int address;
+		unsigned int length = 1;
+		std::string access = "w";
+		if (input >> address)
+		{
+			input >> length >> access;
+			SetWatchpoint(address, length, access.find('r') != std::string::npos, access.find('w') != std::string::npos);
+		}
+	}
+	else if (command == "if")
+	{
+		//if V<x> <op> <value>
+		std::string reg;
+		std::string op;
+		unsigned int value;
+		BreakCondition condition{};
+		if (!(input >> reg >> op >> value) || !ParseRegister(reg, condition.reg))
+		{
+			out << "usage: if V<x> <op> <value>\n";
+		}
+		else
+		{
+			condition.value = static_cast<uint8_t>(value);
+
+			if (op == "==") condition.compare = Compare::Equal;
+			else if (op == "!=") condition.compare = Compare::NotEqual;
+			else if (op == "<") condition.compare = Compare::Less;
+			else if (op == ">") condition.compare = Compare::Greater;
+			else if (op == "<=") condition.compare = Compare::LessEqual;
+			else if (op == ">=") condition.compare = Compare::GreaterEqual;
+			else
+			{
+				out << "unknown comparison " << op << "\n";
+				return true;
+			}
+
+			AddCondition(condition);
+		}
+	}
+	else if (command == "disp")
+	{
+		//disp <addr>[:name]
+		std::string text;
+		MemoryWatch watch;
+		if (input >> text && ParseWatch(text, watch))
+		{
+			AddDisplay(watch);
+		}
+		else
+		{
+			out << "usage: disp <addr>[:name]\n";
+		}
+	}
+	else if (command == "x")
+	{
+		unsigned int address = chip8.index;
+		unsigned int length = 16;
+		input >> address >> length;
+		PrintMemory(out, address, length);
+	}
+	else if (command == "clear")
+	{
+		ClearAll();
+	}
+	else if (command == "q")
+	{
+		return false;
+	}
+	else
+	{
+		out << "commands (numbers in hex):\n"
+			"  r                   show registers, stack and disassembly\n"
+			"  s [n]               step n instructions\n"
+			"  n                   step over CALL\n"
+			"  f                   run to return\n"
+			"  c                   continue until a break\n"
+			"  rs [n]              step back n instructions\n"
+			"  rc                  run back to the previous break\n"
+			"  rw <addr>           run back to the last write of addr\n"
+			"  rv V<x>             run back to the last write of Vx\n"
+			"  history [interval] [count]  show / set checkpointing for reverse execution\n"
+			"  b <addr> / d <addr> set / delete pc breakpoint\n"
+			"  w <addr> [len] [r|w|rw]  memory watchpoint\n"
+			"  if V<x> <op> <val>  break when register comparison is true (== != < > <= >=)\n"
+			"  disp <addr>[:name]  show the byte at addr with every stop\n"
+			"  x [addr] [len]      dump memory (default I)\n"
+			"  clear               remove all breakpoints, watchpoints, conditions and displays\n"
+			"  q                   quit\n";
+	}
+
+	return true;
+}
@@ -0,0 +1,169 @@
+#pragma once
+#include "Chip8.h"
+#include "MemoryScanner.h"
+
+#include <bitset>
+#include <deque>
+#include <ostream>
+#include <string>
+#include <vector>
+
+enum class StopReason
+{
+	None,		//still running
+	Step,		//requested number of instructions executed
+	Breakpoint,	//pc reached a breakpoint
+	WatchRead,	//Fx65/Dxyn read a watched address
+	WatchWrite,	//Fx33/Fx55 wrote a watched address
+	Condition,	//a register condition became true
+	Fault,		//the instruction raised a Chip8Fault not already set
+	Return,		//step over / run to return finished
+	Limit,		//instruction limit reached without another stop
+	LastWrite,	//ran back to the instruction that last wrote the address or register
+	HistoryStart	//ran back to the oldest recorded instruction without another stop
+};
+
+enum class Compare : uint8_t
+{
+	Equal,
+	NotEqual,
+	Less,
+	Greater,
+	LessEqual,
+	GreaterEqual
+};
+
+//break when registers[reg] <compare> value
+struct BreakCondition
+{
+	uint8_t reg;
+	Compare compare;
+	uint8_t value;
+};
+
+//reverse execution defaults: a checkpoint every interval instructions, at most this
+//many kept (a Chip8State is about 12 KB, so about 12 MB)
+const unsigned int HISTORY_INTERVAL = 1000;
+const size_t HISTORY_CHECKPOINTS = 1024;
+
+//Debug engine variant. Wraps a Chip8 and executes it one Cycle() at a time,
+//checking breakpoints/watchpoints between instructions, so the production
+//Cycle() loop carries no debug checks at all.
+//
+//Every instruction executed here is also recorded for reverse execution: the
+//machine is checkpointed every interval instructions and keypad changes are
+//logged, so going back restores the closest earlier checkpoint and re-executes
+//at most one interval. Checkpoints are a ring, so history reaches back
+//interval * checkpoints instructions; running forward from the past discards
+//the recorded future.
+class Debugger
+{
+public:
+	explicit Debugger(Chip8& chip8);
+
+	//execute up to limit instructions, stopping on breakpoints, watchpoints and conditions
+	StopReason Continue(unsigned int limit);
+	//leave the stopped state for a free run; Run() then executes one paced instruction at a time
+	void Resume();
+	StopReason Run();
+	StopReason Step(unsigned int count = 1);
+	//like Step, but runs a whole CALL until it returns
+	StopReason StepOver(unsigned int limit);
+	//run until the current subroutine returns (sp drops below its current level)
+	StopReason StepOut(unsigned int limit);
+
+	StopReason ReverseStep(unsigned int count = 1);
+	//back to the last breakpoint, watchpoint, condition or fault stop
+	StopReason ReverseContinue();
+	//back to just before the last instruction that wrote address / register Vx
+	StopReason ReverseToWrite(uint16_t address);
+	StopReason ReverseToRegisterWrite(uint8_t reg);
+
+	void SetHistory(unsigned int interval, size_t checkpoints);
+	//forget the recorded past, e.g. after the machine ran without the debugger
+	void ClearHistory();
+	//the machine was changed other than by executing (gdb register or memory writes)
+	void StateChanged();
+	//instructions executed since the debugger was attached
+	uint64_t Position() const { return position; }
+
+	void SetBreakpoint(uint16_t address, bool enabled);
+	//both kinds of watch on every address set as given
+	void SetWatchpoint(uint16_t address, unsigned int length, bool read, bool write);
+	//only the kinds selected by read/write set to enabled, the other left as it is
+	void ChangeWatchpoint(uint16_t address, unsigned int length, bool read, bool write, bool enabled);
+	void AddCondition(const BreakCondition& condition);
+	//shown with the state at every stop
+	void AddDisplay(const MemoryWatch& watch);
+	void ClearAll();
+
+	//registers, stack and disassembly around pc
+	void PrintState(std::ostream& out) const;
+	void PrintMemory(std::ostream& out, uint16_t address, unsigned int length) const;
+	//terminal UI: run one command line, returns false when the user quits
+	bool Command(const std::string& line, std::ostream& out);
+
+	//false while running freely after a "c" command
+	bool stopped = true;
+	StopReason lastStop = StopReason::None;
+	//address that triggered the last watchpoint stop
+	uint16_t lastWatchAddress{};
+
+private:
+	struct Checkpoint
+	{
+		uint64_t position;
+		Chip8State state;
+	};
+
+	//keypad as it was when the instruction at position ran
+	struct InputChange
+	{
+		uint64_t position;
+		bool keypad[KEY_COUNT];
+	};
+
+	enum class Search
+	{
+		Stop,
+		MemoryWrite,
+		RegisterWrite
+	};
+
+	Chip8& chip8;
+
+	std::bitset<MEMORY_MAX> breakpoints;
+	std::bitset<MEMORY_MAX> readWatch;
+	std::bitset<MEMORY_MAX> writeWatch;
+	std::vector<BreakCondition> conditions;
+	std::vector<MemoryWatch> displays;
+	//set when resuming so the breakpoint we are stopped on does not fire again
+	bool resuming = false;
+
+	std::deque<Checkpoint> checkpoints;
+	std::deque<InputChange> inputLog;
+	uint64_t position = 0;
+	uint64_t historyEnd = 0;	//newest position recorded
+	bool lastKeypad[KEY_COUNT];
+	unsigned int historyInterval = HISTORY_INTERVAL;
+	size_t historyLimit = HISTORY_CHECKPOINTS;
+
+	//execute the instruction at pc and report watchpoint/condition hits
+	StopReason Execute();
+	StopReason WatchCheck(uint16_t opcode);
+	//bit n set for every Vn opcode may write
+	uint16_t RegisterWrites(uint16_t opcode) const;
+
+	void AddCheckpoint();
+	void TrimHistory();
+	void Truncate();
+	//machine as it was at target, which must not be older than the oldest checkpoint
+	void Replay(uint64_t target);
+	void ApplyInput(std::deque<InputChange>::const_iterator& input, uint64_t at);
+	//latest position before the current one matching search, false if none is recorded
+	bool FindLast(Search search, uint16_t target, uint64_t& found, StopReason& reason);
+	//address range touched by opcode through I, returns false if it does not access memory
+	bool MemoryAccess(uint16_t opcode, uint16_t& start, unsigned int& length, bool& write) const;
+	bool ConditionHit() const;
+	const char* ReasonName(StopReason reason) const;
+};
@@ -0,0 +1,488 @@
+#include "Disassembler.h"
+
+#include <cstdio>
+#include <cstring>
+
+
+//operand layout of an instruction, used to pick printf arguments
+enum class Operands : uint8_t
+{
+	None,
+	NNN,
+	X,
+	XKK,
+	XY,
+	XYN,
+	Raw
+};
+
+struct OpInfo
+{
+	const char* format;
+	Operands operands;
+	Flow flow;
+};
+
+const OpInfo INVALID_OP{ "DW 0x%04X", Operands::Raw, Flow::Invalid };
+
+//----------------------------------
+//			Decode tables
+//----------------------------------
+
+//these mirror Chip8::table, table0, table8, tableE and tableF entry for entry,
+//so an opcode with no handler in the interpreter is reported as invalid here too
+
+//indexed by I(opcode); nullptr format means "look up in sub table"
+const OpInfo table[0xF + 1] =
+{
+	{ nullptr, Operands::None, Flow::Invalid },				//0 -> table0
+	{ "JP 0x%03X", Operands::NNN, Flow::Jump },
+	{ "CALL 0x%03X", Operands::NNN, Flow::Call },
+	{ "SE V%X, 0x%02X", Operands::XKK, Flow::Skip },
+	{ "SNE V%X, 0x%02X", Operands::XKK, Flow::Skip },
+	{ "SE V%X, V%X", Operands::XY, Flow::Skip },
+	{ "LD V%X, 0x%02X", Operands::XKK, Flow::Next },
+	{ "ADD V%X, 0x%02X", Operands::XKK, Flow::Next },
+	{ nullptr, Operands::None, Flow::Invalid },				//8 -> table8
+	{ "SNE V%X, V%X", Operands::XY, Flow::Skip },
+	{ "LD I, 0x%03X", Operands::NNN, Flow::Next },
+	{ "JP V0, 0x%03X", Operands::NNN, Flow::Indirect },
+	{ "RND V%X, 0x%02X", Operands::XKK, Flow::Next },
+	{ "DRW V%X, V%X, %X", Operands::XYN, Flow::Next },
+	{ nullptr, Operands::None, Flow::Invalid },				//E -> tableE
+	{ nullptr, Operands::None, Flow::Invalid }				//F -> tableF
+};
+
+//indexed by opcode & 0xF, same size as Chip8::table0
+const OpInfo table0[0xF + 1] =
+{
+	{ "CLS", Operands::None, Flow::Next },
+	INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP,
+	INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP,
+	{ "RET", Operands::None, Flow::Return },
+	INVALID_OP
+};
+
+//indexed by opcode & 0xF, same size as Chip8::table8
+const OpInfo table8[0xF + 1] =
+{
+	{ "LD V%X, V%X", Operands::XY, Flow::Next },
+	{ "OR V%X, V%X", Operands::XY, Flow::Next },
+	{ "AND V%X, V%X", Operands::XY, Flow::Next },
+	{ "XOR V%X, V%X", Operands::XY, Flow::Next },
+	{ "ADD V%X, V%X", Operands::XY, Flow::Next },
+	{ "SUB V%X, V%X", Operands::XY, Flow::Next },
+	{ "SHR V%X {, V%X}", Operands::XY, Flow::Next },
+	{ "SUBN V%X, V%X", Operands::XY, Flow::Next },
+	INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP,
+	{ "SHL V%X {, V%X}", Operands::XY, Flow::Next },
+	INVALID_OP
+};
+
+//indexed by opcode & 0xF, same size as Chip8::tableE
+const OpInfo tableE[0xF + 1] =
+{
+	INVALID_OP,
+	{ "SKNP V%X", Operands::X, Flow::Skip },
+	INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP,
+	INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP, INVALID_OP,
+	{ "SKP V%X", Operands::X, Flow::Skip },
+	INVALID_OP
+};
+
+//indexed by KK(opcode), sparse so look it up through a switch
+//(same entries as Chip8::tableF)
+static const OpInfo* LookupF(unsigned int kk)
+{
+	static const OpInfo fx07{ "LD V%X, DT", Operands::X, Flow::Next };
+	static const OpInfo fx0A{ "LD V%X, K", Operands::X, Flow::Next };
+	static const OpInfo fx15{ "LD DT, V%X", Operands::X, Flow::Next };
+	static const OpInfo fx18{ "LD ST, V%X", Operands::X, Flow::Next };
+	static const OpInfo fx1E{ "ADD I, V%X", Operands::X, Flow::Next };
+	static const OpInfo fx29{ "LD F, V%X", Operands::X, Flow::Next };
+	static const OpInfo fx33{ "LD B, V%X", Operands::X, Flow::Next };
+	static const OpInfo fx55{ "LD [I], V%X", Operands::X, Flow::Next };
+	static const OpInfo fx65{ "LD V%X, [I]", Operands::X, Flow::Next };
+
+	switch (kk)
+	{
+	case 0x07: return &fx07;
+	case 0x0A: return &fx0A;
+	case 0x15: return &fx15;
+	case 0x18: return &fx18;
+	case 0x1E: return &fx1E;
+	case 0x29: return &fx29;
+	case 0x33: return &fx33;
+	case 0x55: return &fx55;
+	case 0x65: return &fx65;
+	default: return &INVALID_OP;
+	}
+}
+
+//same dispatch as Chip8::Cycle -> Table0/Table8/TableE/TableF
+static const OpInfo& Decode(uint16_t opcode)
+{
+	unsigned int sub = opcode & 0x000Fu;
+
+	switch (I(opcode))
+	{
+	case 0x0: return table0[sub];
+	case 0x8: return table8[sub];
+	case 0xE: return tableE[sub];
+	case 0xF: return *LookupF(KK(opcode));
+	default: return table[I(opcode)];
+	}
+}
+
+Flow DecodeFlow(uint16_t opcode)
+{
+	return Decode(opcode).flow;
+}
+
+std::string Disassemble(uint16_t opcode)
+{
+	const OpInfo& op = Decode(opcode);
+	char text[32];
+
+	switch (op.operands)
+	{
+	case Operands::None: snprintf(text, sizeof(text), "%s", op.format); break;
+	case Operands::NNN: snprintf(text, sizeof(text), op.format, NNN(opcode)); break;
+	case Operands::X: snprintf(text, sizeof(text), op.format, X(opcode)); break;
+	case Operands::XKK: snprintf(text, sizeof(text), op.format, X(opcode), KK(opcode)); break;
+	case Operands::XY: snprintf(text, sizeof(text), op.format, X(opcode), Y(opcode)); break;
+	case Operands::XYN: snprintf(text, sizeof(text), op.format, X(opcode), Y(opcode), opcode & 0x000Fu); break;
+	case Operands::Raw: snprintf(text, sizeof(text), op.format, opcode); break;
+	}
+
+	return text;
+}
+
+//----------------------------------
+//			Analyser
+//----------------------------------
+
+uint16_t Analyser::Fetch(uint16_t address) const
+{
+	return (image[address] << 8u) | image[address + 1];
+}
+
+void Analyser::MarkRange(uint16_t address, unsigned int length, uint8_t flag)
+{
+	for (unsigned int i = 0; i < length && address + i < MEMORY_MAX; ++i)
+	{
+		map[address + i] |= flag;
+	}
+}
+
+void Analyser::Analyse(const uint8_t* memory, uint16_t entry)
+{
+	image = memory;
+	memset(map, 0, sizeof(map));
+	memset(blockIndex, 0xFF, sizeof(blockIndex));
+	blocks.clear();
+	hasIndirect = false;
+
+	romEnd = MEMORY_MAX;
+	while (romEnd > START_ADDRESS && image[romEnd - 1] == 0)
+	{
+		--romEnd;
+	}
+
+	//every address is pushed at most once (guarded by MAP_LEADER), so a fixed stack is enough
+	uint16_t work[MEMORY_MAX];
+	unsigned int count = 0;
+
+	auto push = [&](unsigned int address)
+	{
+		address &= ADDRESS_MASK;
+		if (!(map[address] & MAP_LEADER))
+		{
+			map[address] |= MAP_LEADER;
+			work[count++] = address;
+		}
+	};
+
+	push(entry);
+
+	//pass 1: trace every path and mark instructions, leaders and data referenced through I
+	while (count > 0)
+	{
+		uint16_t pc = work[--count];
+		//value of I if set by an Annn earlier in this run, -1 if unknown
+		int index = -1;
+
+		while (pc + 1u < MEMORY_MAX && !(map[pc] & MAP_INSN))
+		{
+			uint16_t opcode = Fetch(pc);
+			Flow flow = DecodeFlow(opcode);
+
+			map[pc] |= MAP_INSN | MAP_CODE;
+			map[pc + 1] |= MAP_CODE;
+
+			if (flow == Flow::Next)
+			{
+				//track I so sprite and BCD/register dump data can be told apart from code
+				switch (I(opcode))
+				{
+				case 0xA:
+				{
+					index = NNN(opcode);
+				} break;
+				case 0xD:
+				{
+					if (index >= 0)
+					{
+						MarkRange(index, opcode & 0x000Fu, MAP_SPRITE);
+					}
+				} break;
+				case 0xF:
+				{
+					switch (KK(opcode))
+					{
+					case 0x33: if (index >= 0) MarkRange(index, 3, MAP_DATA); break;
+					case 0x55:
+					case 0x65: if (index >= 0) MarkRange(index, X(opcode) + 1, MAP_DATA); break;
+					case 0x1E:
+					case 0x29: index = -1; break;
+					}
+				} break;
+				}
+
+				pc += 2;
+				continue;
+			}
+
+			switch (flow)
+			{
+			case Flow::Skip:
+			{
+				push(pc + 2);
+				push(pc + 4);
+			} break;
+			case Flow::Jump:
+			{
+				map[NNN(opcode)] |= MAP_TARGET;
+				push(NNN(opcode));
+			} break;
+			case Flow::Call:
+			{
+				map[NNN(opcode)] |= MAP_TARGET;
+				push(NNN(opcode));
+				push(pc + 2);
+			} break;
+			case Flow::Indirect:
+			{
+				map[pc] |= MAP_INDIRECT;
+				hasIndirect = true;
+			} break;
+			default:
+				break;
+			}
+			break;
+		}
+	}
+
+	//pass 2: cut basic blocks at leaders, in address order
+	for (unsigned int leader = 0; leader < MEMORY_MAX; ++leader)
+	{
+		if ((map[leader] & (MAP_LEADER | MAP_INSN)) != (MAP_LEADER | MAP_INSN))
+		{
+			continue;
+		}
+
+		BasicBlock block;
+		block.start = leader;
+
+		unsigned int pc = leader;
+		for (;;)
+		{
+			block.exit = DecodeFlow(Fetch(pc));
+			pc += 2;
+
+			if (block.exit != Flow::Next || pc + 1u >= MEMORY_MAX
+				|| !(map[pc] & MAP_INSN) || (map[pc] & MAP_LEADER))
+			{
+				break;
+			}
+		}
+		block.end = pc;
+
+		blockIndex[leader] = static_cast<uint16_t>(blocks.size());
+		blocks.push_back(block);
+	}
+
+	//pass 3: resolve successor addresses to block indices
+	for (BasicBlock& block : blocks)
+	{
+		uint16_t last = block.end - 2;
+		uint16_t opcode = Fetch(last);
+
+		switch (block.exit)
+		{
+		case Flow::Next:
+		{
+			block.next = block.end < MEMORY_MAX ? blockIndex[block.end] : NO_BLOCK;
+		} break;
+		case Flow::Skip:
+		{
+			block.next = BlockAt(last + 2);
+			block.taken = BlockAt(last + 4);
+		} break;
+		case Flow::Jump:
+		{
+			block.taken = BlockAt(NNN(opcode));
+		} break;
+		case Flow::Call:
+		{
+			block.taken = BlockAt(NNN(opcode));
+			block.next = BlockAt(last + 2);
+		} break;
+		default:
+			break;
+		}
+	}
+}
+
+//----------------------------------
+//			Export
+//----------------------------------
+
+void Analyser::WriteBlock(std::ostream& out, const BasicBlock& block, const char* lineEnd) const
+{
+	char line[64];
+
+	for (unsigned int pc = block.start; pc < block.end; pc += 2)
+	{
+		uint16_t opcode = Fetch(pc);
+		snprintf(line, sizeof(line), "0x%03X  %04X  ", pc, opcode);
+		out << line << Disassemble(opcode) << lineEnd;
+	}
+}
+
+void Analyser::WriteData(std::ostream& out, uint16_t start, uint16_t end) const
+{
+	char line[64];
+
+	for (unsigned int address = start; address < end; ++address)
+	{
+		if (map[address] & MAP_SPRITE)
+		{
+			//one sprite row per line, drawn the way Dxyn would
+			char pixels[9]{};
+			for (unsigned int col = 0; col < 8; ++col)
+			{
+				pixels[col] = image[address] & (0x80u >> col) ? '#' : '.';
+			}
+			snprintf(line, sizeof(line), "0x%03X  %02X    DB 0x%02X  ; %s\n", address, image[address], image[address], pixels);
+		}
+		else
+		{
+			snprintf(line, sizeof(line), "0x%03X  %02X    DB 0x%02X%s\n", address, image[address], image[address],
+				map[address] & MAP_DATA ? "  ; data" : "");
+		}
+		out << line;
+	}
+}
+
+void Analyser::WriteText(std::ostream& out) const
+{
+	char line[96];
+
+	unsigned int address = 0;
+	while (address < MEMORY_MAX)
+	{
+		uint16_t block = blockIndex[address];
+		if (block != NO_BLOCK)
+		{
+			const BasicBlock& b = blocks[block];
+
+			snprintf(line, sizeof(line), "\nblock_%03X:", b.start);
+			out << line;
+			if (b.taken != NO_BLOCK)
+			{
+				snprintf(line, sizeof(line), "  taken -> block_%03X", blocks[b.taken].start);
+				out << line;
+			}
+			if (b.next != NO_BLOCK)
+			{
+				snprintf(line, sizeof(line), "  next -> block_%03X", blocks[b.next].start);
+				out << line;
+			}
+			if (b.exit == Flow::Indirect)
+			{
+				out << "  indirect";
+			}
+			out << "\n";
+
+			WriteBlock(out, b, "\n");
+			address = b.end;
+			continue;
+		}
+
+		//anything referenced as data, plus unreached ROM bytes, is dumped as bytes
+		bool isData = (map[address] & (MAP_SPRITE | MAP_DATA))
+			|| (address >= START_ADDRESS && address < romEnd);
+		if (isData && !(map[address] & MAP_CODE))
+		{
+			unsigned int end = address;
+			while (end < MEMORY_MAX && blockIndex[end] == NO_BLOCK && !(map[end] & MAP_CODE)
+				&& ((map[end] & (MAP_SPRITE | MAP_DATA)) || (end >= START_ADDRESS && end < romEnd)))
+			{
+				++end;
+			}
+
+			out << "\n";
+			WriteData(out, address, end);
+			address = end;
+			continue;
+		}
+
+		++address;
+	}
+}
+
+void Analyser::WriteDot(std::ostream& out) const
+{
+	char line[96];
+
+	out << "digraph rom {\n";
+	out << "\tnode [shape=box fontname=\"monospace\"];\n";
+
+	for (const BasicBlock& b : blocks)
+	{
+		snprintf(line, sizeof(line), "\tb%03X [label=\"", b.start);
+		out << line;
+		WriteBlock(out, b, "\\l");
+		out << "\"" << (b.exit == Flow::Indirect ? " style=dashed" : "") << "];\n";
+	}
+
+	for (const BasicBlock& b : blocks)
+	{
+		const char* takenLabel = b.exit == Flow::Call ? "call" : (b.exit == Flow::Skip ? "skip" : "jump");
+		const char* nextLabel = b.exit == Flow::Call ? "return" : "next";
+
+		if (b.taken != NO_BLOCK)
+		{
+			snprintf(line, sizeof(line), "\tb%03X -> b%03X [label=\"%s\"];\n", b.start, blocks[b.taken].start, takenLabel);
+			out << line;
+		}
+		if (b.next != NO_BLOCK)
+		{
+			snprintf(line, sizeof(line), "\tb%03X -> b%03X [label=\"%s\"];\n", b.start, blocks[b.next].start, nextLabel);
+			out << line;
+		}
+		if (b.exit == Flow::Indirect)
+		{
+			snprintf(line, sizeof(line), "\tb%03X -> indirect [style=dashed];\n", b.start);
+			out << line;
+		}
+	}
+
+	if (hasIndirect)
+	{
+		out << "\tindirect [shape=ellipse label=\"JP V0 + nnn\"];\n";
+	}
+
+	out << "}\n";
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "Chip8.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//control flow effect of a decoded instruction
+enum class Flow : uint8_t
+{
+	Next,		//falls through to pc + 2
+	Skip,		//falls through to pc + 2 or pc + 4 (3xkk, 4xkk, 5xy0, 9xy0, Ex9E, ExA1)
+	Jump,		//1nnn
+	Call,		//2nnn
+	Return,		//00EE
+	Indirect,	//Bnnn - target depends on V0
+	Invalid		//no handler in the opcode tables (OP_NULL)
+};
+
+//per-byte flags produced by the analyser
+const uint8_t MAP_CODE = 0x01;		//byte belongs to a reachable instruction
+const uint8_t MAP_SPRITE = 0x02;	//byte is read by Dxyn through a known I
+const uint8_t MAP_DATA = 0x04;		//byte is read or written by Fx33/Fx55/Fx65 through a known I
+const uint8_t MAP_LEADER = 0x08;	//first instruction of a basic block
+const uint8_t MAP_TARGET = 0x10;	//target of a jump or call
+const uint8_t MAP_INDIRECT = 0x20;	//instruction is a Bnnn
+const uint8_t MAP_INSN = 0x40;		//an instruction starts at this byte
+
+const uint16_t NO_BLOCK = 0xFFFF;
+
+//Decode an opcode the same way Chip8::Cycle walks its function pointer tables
+Flow DecodeFlow(uint16_t opcode);
+//Mnemonic for an opcode, e.g. "LD VA, 0x02"
+std::string Disassemble(uint16_t opcode);
+
+struct BasicBlock
+{
+	uint16_t start{};	//address of first instruction
+	uint16_t end{};		//address one past the last instruction
+	uint16_t taken = NO_BLOCK;	//jump/call/skip target block
+	uint16_t next = NO_BLOCK;	//fall through (or return site after a call) block
+	Flow exit = Flow::Next;		//flow of the last instruction
+};
+
+//Static control flow analysis of a memory image, starting at the reset vector
+//The results are plain arrays so they can be used as pre-decode hints at load time
+class Analyser
+{
+public:
+	//memory must hold a full MEMORY_MAX image with the ROM loaded at START_ADDRESS
+	void Analyse(const uint8_t* memory, uint16_t entry = START_ADDRESS);
+
+	void WriteText(std::ostream& out) const;
+	void WriteDot(std::ostream& out) const;
+
+	bool IsCode(uint16_t address) const { return (map[address & ADDRESS_MASK] & MAP_CODE) != 0; }
+	//index into blocks of the block starting at address, or NO_BLOCK
+	uint16_t BlockAt(uint16_t address) const { return blockIndex[address & ADDRESS_MASK]; }
+
+	uint8_t map[MEMORY_MAX]{};
+	uint16_t blockIndex[MEMORY_MAX]{};
+	std::vector<BasicBlock> blocks;
+	//one past the last non-zero byte of the ROM
+	unsigned int romEnd = START_ADDRESS;
+	bool hasIndirect = false;
+
+private:
+	const uint8_t* image = nullptr;
+
+	uint16_t Fetch(uint16_t address) const;
+	void MarkRange(uint16_t address, unsigned int length, uint8_t flag);
+	void WriteBlock(std::ostream& out, const BasicBlock& block, const char* lineEnd) const;
+	void WriteData(std::ostream& out, uint16_t start, uint16_t end) const;
+};
@@ -0,0 +1,115 @@
+#include "FrameBlender.h"
+
+#include <algorithm>
+
+#if !defined(CHIP8_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CHIP8_BLEND_SSE2
+#include <emmintrin.h>
+#endif
+
+
+FrameBlender::FrameBlender(unsigned int width, unsigned int height)
+	: pixels(width * height), level(width * height, 0), output(width * height, 0)
+{
+}
+
+void FrameBlender::SetOff()
+{
+	mode = BlendMode::Off;
+}
+
+void FrameBlender::SetOr(unsigned int frames)
+{
+	mode = BlendMode::Or;
+	orFrames = static_cast<uint8_t>(std::min(std::max(frames, 1u), 255u));
+	//every pixel starts out as long unlit
+	std::fill(level.begin(), level.end(), 0xFF);
+}
+
+void FrameBlender::SetPhosphor(unsigned int decayPercent)
+{
+	mode = BlendMode::Phosphor;
+	decay = static_cast<uint16_t>(std::min(decayPercent, 100u) * 256 / 100);
+	std::fill(level.begin(), level.end(), 0);
+}
+
+const uint32_t* FrameBlender::Apply(const uint32_t* video)
+{
+	if (mode == BlendMode::Off)
+	{
+		return video;
+	}
+
+	unsigned int i = 0;
+
+#ifdef CHIP8_BLEND_SSE2
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	const __m128i frames = _mm_set1_epi8(static_cast<char>(orFrames));
+	const __m128i multiplier = _mm_set1_epi16(static_cast<short>(decay));
+
+	//16 pixels at a time: 4 loads of 4 pixels narrowed to one byte mask each
+	for (; i + 16 <= pixels; i += 16)
+	{
+		__m128i unlit0 = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(video + i)), zero);
+		__m128i unlit1 = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(video + i + 4)), zero);
+		__m128i unlit2 = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(video + i + 8)), zero);
+		__m128i unlit3 = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(video + i + 12)), zero);
+		__m128i unlit = _mm_packs_epi16(_mm_packs_epi32(unlit0, unlit1), _mm_packs_epi32(unlit2, unlit3));
+
+		__m128i current = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&level[i]));
+		__m128i shown;
+
+		if (mode == BlendMode::Or)
+		{
+			//frames since lit, saturating at 255; shown while below orFrames
+			current = _mm_and_si128(_mm_adds_epu8(current, one), unlit);
+			shown = _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(frames, current), zero), _mm_set1_epi8(-1));
+		}
+		else
+		{
+			//brightness * decay / 256 in 16 bit lanes, lit pixels back to full
+			__m128i low = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(current, zero), multiplier), 8);
+			__m128i high = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(current, zero), multiplier), 8);
+			current = _mm_or_si128(_mm_packus_epi16(low, high), _mm_xor_si128(unlit, _mm_set1_epi8(-1)));
+			shown = current;
+		}
+
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&level[i]), current);
+
+		//replicate each byte into all four bytes of its pixel
+		__m128i low16 = _mm_unpacklo_epi8(shown, shown);
+		__m128i high16 = _mm_unpackhi_epi8(shown, shown);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&output[i]), _mm_unpacklo_epi16(low16, low16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&output[i + 4]), _mm_unpackhi_epi16(low16, low16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&output[i + 8]), _mm_unpacklo_epi16(high16, high16));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(&output[i + 12]), _mm_unpackhi_epi16(high16, high16));
+	}
+#endif
+
+	ApplyScalar(video, i);
+	return output.data();
+}
+
+//reference path, and the tail the SIMD loop leaves
+void FrameBlender::ApplyScalar(const uint32_t* video, unsigned int start)
+{
+	for (unsigned int i = start; i < pixels; ++i)
+	{
+		bool lit = video[i] != 0;
+		uint8_t shown;
+
+		if (mode == BlendMode::Or)
+		{
+			level[i] = lit ? 0 : static_cast<uint8_t>(std::min(level[i] + 1, 255));
+			shown = level[i] < orFrames ? 0xFF : 0;
+		}
+		else
+		{
+			level[i] = lit ? 0xFF : static_cast<uint8_t>((level[i] * decay) >> 8);
+			shown = level[i];
+		}
+
+		output[i] = shown * 0x01010101u;
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include "Chip8.h"
+
+#include <vector>
+
+enum class BlendMode
+{
+	Off,		//display passed through unchanged
+	Or,			//a pixel stays lit while it was lit in any of the last N frames
+	Phosphor	//lit pixels fade out by a fixed fraction per frame
+};
+
+//Anti-flicker display stage. Games erase and redraw sprites with XOR, so a frame
+//presented between the two draws shows the sprite missing. Apply() is called once
+//per presented frame and keeps one byte of persistence per pixel: frames since the
+//pixel was last lit (Or) or its brightness (Phosphor). The output is a grey level
+//in every byte of the pixel, so lit pixels stay 0xFFFFFFFF as the interpreter
+//draws them. Uses SSE2 where available (define CHIP8_NO_SIMD to force the scalar
+//path); any size works, the display is 64x32.
+class FrameBlender
+{
+public:
+	explicit FrameBlender(unsigned int width = VIDEO_WIDTH, unsigned int height = VIDEO_HEIGHT);
+
+	void SetOff();
+	//OR of the current and previous frames - 1 is no blending
+	void SetOr(unsigned int frames);
+	//brightness kept per frame, 0-100 percent
+	void SetPhosphor(unsigned int decayPercent);
+
+	BlendMode Mode() const { return mode; }
+	bool Enabled() const { return mode != BlendMode::Off; }
+
+	//blended copy of video, valid until the next call
+	const uint32_t* Apply(const uint32_t* video);
+
+private:
+	unsigned int pixels;
+	BlendMode mode = BlendMode::Off;
+	uint8_t orFrames = 1;
+	uint16_t decay = 0;		//multiplier out of 256
+
+	std::vector<uint8_t> level;
+	std::vector<uint32_t> output;
+
+	void ApplyScalar(const uint32_t* video, unsigned int start);
+};
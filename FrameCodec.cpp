@@ -0,0 +1,100 @@
+#include "FrameCodec.h"
+
+
+void PackVideo(const uint32_t* video, uint8_t* bits)
+{
+	for (unsigned int i = 0; i < VIDEO_WIDTH * VIDEO_HEIGHT; i += 8)
+	{
+		uint8_t byte = 0;
+		for (unsigned int bit = 0; bit < 8; ++bit)
+		{
+			byte = static_cast<uint8_t>((byte << 1) | (video[i + bit] != 0));
+		}
+		bits[i / 8] = byte;
+	}
+}
+
+void UnpackVideo(const uint8_t* bits, uint32_t* video)
+{
+	for (unsigned int i = 0; i < VIDEO_WIDTH * VIDEO_HEIGHT; ++i)
+	{
+		video[i] = (bits[i / 8] & (0x80u >> (i % 8))) ? 0xFFFFFFFF : 0;
+	}
+}
+
+void RleEncode(const uint8_t* data, size_t size, std::vector<uint8_t>& out)
+{
+	size_t i = 0;
+
+	while (i < size)
+	{
+		bool zero = data[i] == 0;
+		size_t run = 1;
+		while (i + run < size && run < 0x80 && (data[i + run] == 0) == zero)
+		{
+			++run;
+		}
+
+		if (zero)
+		{
+			out.push_back(static_cast<uint8_t>(run - 1));
+		}
+		else
+		{
+			out.push_back(static_cast<uint8_t>(0x80 | (run - 1)));
+			out.insert(out.end(), data + i, data + i + run);
+		}
+		i += run;
+	}
+}
+
+bool RleDecode(const uint8_t* data, size_t length, uint8_t* out, size_t size)
+{
+	size_t in = 0;
+	size_t written = 0;
+
+	while (in < length)
+	{
+		uint8_t control = data[in++];
+		size_t run = (control & 0x7F) + 1;
+		if (written + run > size)
+		{
+			return false;
+		}
+
+		if (control & 0x80)
+		{
+			if (in + run > length)
+			{
+				return false;
+			}
+			for (size_t i = 0; i < run; ++i)
+			{
+				out[written++] = data[in++];
+			}
+		}
+		else
+		{
+			for (size_t i = 0; i < run; ++i)
+			{
+				out[written++] = 0;
+			}
+		}
+	}
+
+	return written == size;
+}
+
+std::vector<uint8_t> EncodePacket(uint8_t type, uint8_t channel, uint32_t sequence, const uint8_t* bits)
+{
+	std::vector<uint8_t> packet = { 'C', '8', type, channel,
+		static_cast<uint8_t>(sequence), static_cast<uint8_t>(sequence >> 8),
+		static_cast<uint8_t>(sequence >> 16), static_cast<uint8_t>(sequence >> 24), 0, 0 };
+
+	RleEncode(bits, FRAME_BYTES, packet);
+
+	size_t length = packet.size() - PACKET_HEADER;
+	packet[8] = static_cast<uint8_t>(length);
+	packet[9] = static_cast<uint8_t>(length >> 8);
+	return packet;
+}
@@ -0,0 +1,28 @@
+#pragma once
+#include "Chip8.h"
+
+#include <vector>
+
+//1 bit per pixel display frames and the packet format of the frame stream
+//(FrameServer / tools/viewer.cpp). Bits are MSB first, row major, like sprite data.
+
+const unsigned int FRAME_BYTES = VIDEO_WIDTH * VIDEO_HEIGHT / 8;
+
+//stream packet: 'C' '8' type channel sequence(u32 LE) length(u16 LE) payload
+//the payload is the RLE of the whole frame (key) or of frame XOR previous frame (delta)
+const unsigned int PACKET_HEADER = 10;
+const uint8_t PACKET_KEY = 0;
+const uint8_t PACKET_DELTA = 1;
+
+//any non-zero pixel is lit
+void PackVideo(const uint32_t* video, uint8_t* bits);
+//lit pixels become 0xFFFFFFFF, like the interpreter draws them
+void UnpackVideo(const uint8_t* bits, uint32_t* video);
+
+//control byte n: n < 0x80 is a run of n + 1 zero bytes, otherwise (n & 0x7F) + 1 literal bytes follow
+void RleEncode(const uint8_t* data, size_t size, std::vector<uint8_t>& out);
+//false if the input is malformed or does not decode to exactly size bytes
+bool RleDecode(const uint8_t* data, size_t length, uint8_t* out, size_t size);
+
+//complete packet, header included
+std::vector<uint8_t> EncodePacket(uint8_t type, uint8_t channel, uint32_t sequence, const uint8_t* bits);
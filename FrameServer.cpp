@@ -0,0 +1,251 @@
+#include "FrameServer.h"
+#include "Socket.h"
+
+#include <algorithm>
+
+
+//how long the server thread sleeps in poll() when no viewer is writable
+const int SERVER_POLL_MS = 5;
+
+FrameServer::FrameServer(unsigned int channels)
+	: channels(new Channel[channels]), channelCount(channels)
+{
+}
+
+FrameServer::~FrameServer()
+{
+	shutdown = true;
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+
+	for (Viewer& viewer : viewers)
+	{
+		CloseSocket(viewer.fd);
+	}
+	CloseSocket(listenFd);
+#ifndef _WIN32
+	if (!unixPath.empty())
+	{
+		unlink(unixPath.c_str());
+	}
+#endif
+}
+
+bool FrameServer::ListenTcp(unsigned short port)
+{
+	listenFd = ListenTcpSocket(port);
+	if (listenFd < 0)
+	{
+		return false;
+	}
+
+	thread = std::thread(&FrameServer::ServerLoop, this);
+	return true;
+}
+
+bool FrameServer::ListenUnix(const char* path)
+{
+	listenFd = ListenUnixSocket(path);
+	if (listenFd < 0)
+	{
+		return false;
+	}
+
+	unixPath = path;
+	thread = std::thread(&FrameServer::ServerLoop, this);
+	return true;
+}
+
+//----------------------------------
+//			Emulation threads
+//----------------------------------
+
+bool FrameServer::Publish(unsigned int channel, const uint32_t* video)
+{
+	Frame frame;
+	PackVideo(video, frame.bits);
+
+	if (!channels[channel].queue.Push(frame))
+	{
+		channels[channel].dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+//----------------------------------
+//			Server thread
+//----------------------------------
+
+void FrameServer::ServerLoop()
+{
+	std::vector<pollfd> fds;
+
+	while (!shutdown)
+	{
+		fds.clear();
+		pollfd listener{};
+		listener.fd = listenFd;
+		listener.events = POLLIN;
+		fds.push_back(listener);
+		for (const Viewer& viewer : viewers)
+		{
+			pollfd client{};
+			client.fd = viewer.fd;
+			client.events = static_cast<short>(POLLIN | (viewer.out.empty() ? 0 : POLLOUT));
+			fds.push_back(client);
+		}
+
+		poll(fds.data(), static_cast<unsigned int>(fds.size()), SERVER_POLL_MS);
+
+		//subscriptions and disconnects
+		for (size_t i = 0; i < viewers.size(); ++i)
+		{
+			Viewer& viewer = viewers[i];
+			short events = fds[i + 1].revents;
+
+			if (events & POLLIN)
+			{
+				uint8_t request[16];
+				int received = static_cast<int>(recv(viewer.fd, reinterpret_cast<char*>(request), sizeof(request), 0));
+				if (received == 0 || (received < 0 && !WouldBlock()))
+				{
+					viewer.closed = true;
+				}
+				else if (received > 0 && request[received - 1] < channelCount)
+				{
+					viewer.channel = request[received - 1];
+					Resync(viewer);
+				}
+			}
+			else if (events & (POLLERR | POLLHUP))
+			{
+				viewer.closed = true;
+			}
+		}
+
+		if (fds[0].revents & POLLIN)
+		{
+			int fd = static_cast<int>(accept(listenFd, nullptr, nullptr));
+			if (fd >= 0)
+			{
+				SetNonBlocking(fd);
+				Viewer viewer;
+				viewer.fd = fd;
+				viewers.push_back(std::move(viewer));
+			}
+		}
+
+		//new frames from the instances
+		for (unsigned int channel = 0; channel < channelCount; ++channel)
+		{
+			Frame frame;
+			while (channels[channel].queue.Pop(frame))
+			{
+				Broadcast(channel, frame);
+			}
+		}
+
+		for (Viewer& viewer : viewers)
+		{
+			Flush(viewer);
+		}
+
+		for (size_t i = viewers.size(); i-- > 0;)
+		{
+			if (viewers[i].closed)
+			{
+				CloseSocket(viewers[i].fd);
+				viewers.erase(viewers.begin() + i);
+			}
+		}
+		viewerCount.store(static_cast<unsigned int>(viewers.size()), std::memory_order_relaxed);
+	}
+}
+
+void FrameServer::Broadcast(unsigned int channel, const Frame& frame)
+{
+	Channel& source = channels[channel];
+
+	Frame delta;
+	uint8_t changed = 0;
+	for (unsigned int i = 0; i < FRAME_BYTES; ++i)
+	{
+		delta.bits[i] = frame.bits[i] ^ source.current.bits[i];
+		changed |= delta.bits[i];
+	}
+
+	//nothing new on screen - nothing to send
+	if (changed == 0)
+	{
+		return;
+	}
+
+	source.current = frame;
+	++source.sequence;
+	source.keyFrame.reset();
+
+	Packet packet;
+	for (Viewer& viewer : viewers)
+	{
+		if (viewer.channel != static_cast<int>(channel) || viewer.closed)
+		{
+			continue;
+		}
+
+		if (viewer.out.size() >= MAX_BACKLOG)
+		{
+			Resync(viewer);
+			continue;
+		}
+
+		//one encoding shared by every viewer of the channel
+		if (!packet)
+		{
+			packet = std::make_shared<const std::vector<uint8_t>>(EncodePacket(PACKET_DELTA, static_cast<uint8_t>(channel), source.sequence, delta.bits));
+		}
+		viewer.out.push_back(packet);
+	}
+}
+
+FrameServer::Packet FrameServer::KeyFrame(unsigned int channel)
+{
+	Channel& source = channels[channel];
+	if (!source.keyFrame)
+	{
+		source.keyFrame = std::make_shared<const std::vector<uint8_t>>(EncodePacket(PACKET_KEY, static_cast<uint8_t>(channel), source.sequence, source.current.bits));
+	}
+	return source.keyFrame;
+}
+
+//drop everything queued except a partly sent packet, then send the whole current frame
+void FrameServer::Resync(Viewer& viewer)
+{
+	size_t keep = viewer.offset > 0 ? 1 : 0;
+	viewer.out.resize(std::min(keep, viewer.out.size()));
+	viewer.out.push_back(KeyFrame(viewer.channel));
+}
+
+void FrameServer::Flush(Viewer& viewer)
+{
+	while (!viewer.out.empty() && !viewer.closed)
+	{
+		const std::vector<uint8_t>& packet = *viewer.out.front();
+		int sent = SendBytes(viewer.fd, packet.data() + viewer.offset, packet.size() - viewer.offset);
+		if (sent < 0)
+		{
+			//socket buffer full - try again on the next POLLOUT
+			viewer.closed = !WouldBlock();
+			return;
+		}
+
+		viewer.offset += sent;
+		if (viewer.offset == packet.size())
+		{
+			viewer.out.pop_front();
+			viewer.offset = 0;
+		}
+	}
+}
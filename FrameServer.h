@@ -0,0 +1,89 @@
+#pragma once
+#include "FrameCodec.h"
+#include "RingBuffer.h"
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+//Streams the displays of several headless instances to any number of viewers
+//(tools/viewer.cpp) over loopback TCP or a Unix domain socket.
+//
+//Each instance publishes to its own channel through a lock-free queue, so the
+//emulation threads never wait on the server, let alone on a viewer. The server
+//thread turns every changed frame into one immutable packet (XOR delta against
+//the previous frame, RLE, sequence numbered) shared by all viewers of that
+//channel. Sends are non-blocking; a viewer that falls more than a few packets
+//behind has its backlog discarded and is resynchronised with a key frame.
+//
+//A viewer subscribes by sending a single byte, the channel number, and may send
+//another at any time to switch.
+class FrameServer
+{
+public:
+	explicit FrameServer(unsigned int channels);
+	~FrameServer();
+
+	bool ListenTcp(unsigned short port);
+	bool ListenUnix(const char* path);
+
+	//emulation thread of this channel: returns false (and counts it) when the
+	//server has not caught up with earlier frames
+	bool Publish(unsigned int channel, const uint32_t* video);
+
+	unsigned int Channels() const { return channelCount; }
+	unsigned long Dropped(unsigned int channel) const { return channels[channel].dropped.load(std::memory_order_relaxed); }
+	unsigned int Viewers() const { return viewerCount.load(std::memory_order_relaxed); }
+
+private:
+	typedef std::shared_ptr<const std::vector<uint8_t>> Packet;
+
+	struct Frame
+	{
+		uint8_t bits[FRAME_BYTES];
+	};
+
+	struct Channel
+	{
+		RingBuffer<Frame, 8> queue;
+		std::atomic<unsigned long> dropped{ 0 };
+
+		//server thread only
+		Frame current{};
+		uint32_t sequence = 0;
+		Packet keyFrame;	//key frame of current, built when a viewer first needs it
+	};
+
+	struct Viewer
+	{
+		int fd;
+		int channel = -1;
+		std::deque<Packet> out;
+		size_t offset = 0;	//bytes of out.front() already sent
+		bool closed = false;
+	};
+
+	//queued packets a viewer may fall behind by before it is resynchronised
+	static const size_t MAX_BACKLOG = 16;
+
+	std::unique_ptr<Channel[]> channels;
+	unsigned int channelCount;
+
+	int listenFd = -1;
+	std::string unixPath;
+	std::thread thread;
+	std::atomic<bool> shutdown{ false };
+	std::atomic<unsigned int> viewerCount{ 0 };
+
+	//server thread only
+	std::vector<Viewer> viewers;
+
+	void ServerLoop();
+	void Broadcast(unsigned int channel, const Frame& frame);
+	Packet KeyFrame(unsigned int channel);
+	void Resync(Viewer& viewer);
+	void Flush(Viewer& viewer);
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+//Display and input backend driven by the emulator loop - SDL_Layer draws to a
+//window, TerminalLayer to the terminal it was started from (e.g. over SSH).
+//Buffers are rows of 32-bit pixels, 0 dark and 0xFFFFFFFF fully lit, as in
+//Chip8::video and FrameBlender output; pitch is the number of bytes in a row.
+class Frontend
+{
+public:
+	virtual ~Frontend() = default;
+
+	//a whole frame, to be shown winWidth x winHeight where the backend has a size
+	virtual void Update(const void* buffer, int pitch, int winWidth, int winHeight) = 0;
+	//refresh between frames, for effects drawn over the last one (SDL scanlines)
+	virtual void Filter(const void* /*buffer*/, int /*pitch*/, int /*winWidth*/, int /*winHeight*/) {}
+	//keypad into keys, speed keys into *pGameSpeed; true when the user asked to quit
+	virtual bool ProcessInput(bool* keys, float* pGameSpeed) = 0;
+	//sleep until an event arrives or timeoutMs has passed; the event is left for ProcessInput()
+	virtual void WaitInput(int timeoutMs) = 0;
+	virtual void SetTitle(const char* title) = 0;
+
+	//false when the backend could not start
+	bool flag = true;
+	//uncapped fast forward, toggled by the ` key
+	bool turbo = false;
+	//key presses and releases seen by ProcessInput()
+	unsigned long inputEvents = 0;
+
+protected:
+	//the = and - keys: *pGameSpeed is the delay between instructions in ms, 0 to 32
+	static void HalveDelay(float* pGameSpeed)
+	{
+		if (*pGameSpeed == 0.25)
+		{
+			*pGameSpeed = 0;
+		}
+		else
+		{
+			*pGameSpeed /= 2;
+		}
+	}
+
+	static void DoubleDelay(float* pGameSpeed)
+	{
+		if (*pGameSpeed == 0)
+		{
+			*pGameSpeed = 0.25;
+		}
+		else
+		{
+			*pGameSpeed *= 2;
+		}
+		//set minimum speed
+		*pGameSpeed = *pGameSpeed > 32 ? 32 : *pGameSpeed;
+	}
+};
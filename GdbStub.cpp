@@ -0,0 +1,737 @@
+#include "GdbStub.h"
+#include "Socket.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+
+//register numbers in the g/G/p/P packets
+const unsigned int REG_I = REGISTER_COUNT;
+const unsigned int REG_PC = REGISTER_COUNT + 1;
+const unsigned int REG_SP = REGISTER_COUNT + 2;
+const unsigned int REG_TOTAL = REGISTER_COUNT + 3;
+
+static const char HEX_DIGITS[] = "0123456789abcdef";
+
+static void AppendHex(std::string& out, uint8_t byte)
+{
+	out += HEX_DIGITS[byte >> 4];
+	out += HEX_DIGITS[byte & 0xF];
+}
+
+static int HexValue(char c)
+{
+	if (c >= '0' && c <= '9') return c - '0';
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+	return -1;
+}
+
+//decode little endian hex bytes, returns false on malformed input
+static bool ParseHexBytes(const std::string& hex, size_t offset, unsigned int count, unsigned int& value)
+{
+	value = 0;
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		if (offset + i * 2 + 1 >= hex.size())
+		{
+			return false;
+		}
+		int high = HexValue(hex[offset + i * 2]);
+		int low = HexValue(hex[offset + i * 2 + 1]);
+		if (high < 0 || low < 0)
+		{
+			return false;
+		}
+		value |= static_cast<unsigned int>((high << 4) | low) << (8 * i);
+	}
+	return true;
+}
+
+GdbStub::GdbStub(Chip8& chip8)
+	: chip8(chip8), debugger(chip8)
+{
+}
+
+GdbStub::~GdbStub()
+{
+	shutdown = true;
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+
+	CloseSocket(clientFd);
+	CloseSocket(listenFd);
+#ifndef _WIN32
+	if (!unixPath.empty())
+	{
+		unlink(unixPath.c_str());
+	}
+#endif
+}
+
+bool GdbStub::ListenTcp(unsigned short port)
+{
+	listenFd = ListenTcpSocket(port);
+	if (listenFd < 0)
+	{
+		return false;
+	}
+
+	thread = std::thread(&GdbStub::ServerLoop, this);
+	return true;
+}
+
+bool GdbStub::ListenUnix(const char* path)
+{
+	listenFd = ListenUnixSocket(path);
+	if (listenFd < 0)
+	{
+		return false;
+	}
+
+	unixPath = path;
+	thread = std::thread(&GdbStub::ServerLoop, this);
+	return true;
+}
+
+//----------------------------------
+//			Emulation thread
+//----------------------------------
+
+void GdbStub::Service()
+{
+	//held for exactly one instruction, the stub thread waits on it for state access
+	std::lock_guard<std::mutex> lock(mutex);
+
+	if (!serviced)
+	{
+		serviced = true;
+		servicedSignal.notify_all();
+	}
+
+	switch (runState)
+	{
+	case RunState::Halted:
+		break;
+	case RunState::Stepping:
+	{
+		stopReason = debugger.Step();
+		runState = RunState::Halted;
+		stopPending = true;
+	} break;
+	case RunState::Running:
+	{
+		StopReason reason = debugger.Run();
+		if (reason != StopReason::None)
+		{
+			stopReason = reason;
+			runState = RunState::Halted;
+			stopPending = true;
+		}
+	} break;
+	}
+}
+
+//----------------------------------
+//			Stub thread
+//----------------------------------
+
+void GdbStub::ServerLoop()
+{
+	while (!shutdown)
+	{
+		pollfd listener{};
+		listener.fd = listenFd;
+		listener.events = POLLIN;
+
+		if (poll(&listener, 1, 200) <= 0)
+		{
+			continue;
+		}
+
+		clientFd = static_cast<int>(accept(listenFd, nullptr, nullptr));
+		if (clientFd < 0)
+		{
+			continue;
+		}
+
+		Session();
+
+		CloseSocket(clientFd);
+		clientFd = -1;
+	}
+}
+
+void GdbStub::Session()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		//gdb expects the target to be stopped when it attaches; the emulation thread
+		//switches to Service() once it sees attached, and only after that is the
+		//machine ours between instructions
+		runState = RunState::Halted;
+		serviced = false;
+		attached = true;
+		while (!serviced && !shutdown)
+		{
+			servicedSignal.wait_for(lock, std::chrono::milliseconds(200));
+		}
+
+		stopReason = StopReason::None;
+		stopPending = false;
+		noAck = false;
+		inStart = inEnd = 0;
+		debugger.ClearAll();
+		//the machine ran on its own since the last session
+		debugger.ClearHistory();
+	}
+
+	while (!shutdown)
+	{
+		bool running;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (stopPending)
+			{
+				stopPending = false;
+				SendPacket(StopReply());
+			}
+			running = runState != RunState::Halted;
+		}
+
+		std::string packet;
+		bool interrupt = false;
+		//poll quickly while running so stop replies go out promptly
+		int status = ReadPacket(packet, interrupt, running ? 10 : 200);
+		if (status < 0)
+		{
+			break;
+		}
+		if (status == 0)
+		{
+			continue;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		if (interrupt)
+		{
+			if (runState != RunState::Halted)
+			{
+				runState = RunState::Halted;
+				stopReason = StopReason::None;
+				stopPending = true;
+			}
+			continue;
+		}
+
+		if (!HandlePacket(packet))
+		{
+			break;
+		}
+	}
+
+	//let the machine carry on without us
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		debugger.ClearAll();
+		runState = RunState::Running;
+	}
+	attached = false;
+}
+
+int GdbStub::ReadPacket(std::string& packet, bool& interrupt, int timeoutMs)
+{
+	for (;;)
+	{
+		//consume whatever is already buffered
+		while (inStart < inEnd)
+		{
+			char c = inBuffer[inStart];
+
+			if (c == 0x03)
+			{
+				++inStart;
+				interrupt = true;
+				return 1;
+			}
+			if (c != '$')
+			{
+				//acks, nacks and line noise
+				++inStart;
+				continue;
+			}
+
+			size_t hash = inStart + 1;
+			while (hash < inEnd && inBuffer[hash] != '#')
+			{
+				++hash;
+			}
+			if (hash + 2 >= inEnd)
+			{
+				break;
+			}
+
+			packet.assign(&inBuffer[inStart + 1], hash - inStart - 1);
+
+			uint8_t sum = 0;
+			for (char p : packet)
+			{
+				sum += static_cast<uint8_t>(p);
+			}
+			bool valid = HexValue(inBuffer[hash + 1]) == (sum >> 4) && HexValue(inBuffer[hash + 2]) == (sum & 0xF);
+			inStart = hash + 3;
+
+			if (!noAck)
+			{
+				SendBytes(clientFd, valid ? "+" : "-", 1);
+			}
+			if (valid)
+			{
+				return 1;
+			}
+		}
+
+		//compact and read more
+		if (inStart > 0)
+		{
+			memmove(inBuffer, &inBuffer[inStart], inEnd - inStart);
+			inEnd -= inStart;
+			inStart = 0;
+		}
+		if (inEnd == sizeof(inBuffer))
+		{
+			//oversized packet, drop it
+			inEnd = 0;
+		}
+
+		pollfd client{};
+		client.fd = clientFd;
+		client.events = POLLIN;
+
+		int ready = poll(&client, 1, timeoutMs);
+		if (shutdown)
+		{
+			return -1;
+		}
+		if (ready <= 0)
+		{
+			return 0;
+		}
+
+		int received = static_cast<int>(recv(clientFd, &inBuffer[inEnd], static_cast<int>(sizeof(inBuffer) - inEnd), 0));
+		if (received <= 0)
+		{
+			return -1;
+		}
+		inEnd += received;
+	}
+}
+
+void GdbStub::SendPacket(const std::string& payload)
+{
+	uint8_t sum = 0;
+	for (char c : payload)
+	{
+		sum += static_cast<uint8_t>(c);
+	}
+
+	std::string framed;
+	framed.reserve(payload.size() + 4);
+	framed += '$';
+	framed += payload;
+	framed += '#';
+	AppendHex(framed, sum);
+
+	SendBytes(clientFd, framed.data(), framed.size());
+}
+
+std::string GdbStub::StopReply() const
+{
+	char reply[32];
+
+	switch (stopReason)
+	{
+	case StopReason::None:
+		return "S02";	//SIGINT
+	case StopReason::WatchWrite:
+		snprintf(reply, sizeof(reply), "T05watch:%x;", debugger.lastWatchAddress);
+		return reply;
+	case StopReason::WatchRead:
+		snprintf(reply, sizeof(reply), "T05rwatch:%x;", debugger.lastWatchAddress);
+		return reply;
+	case StopReason::HistoryStart:
+		return "T05replaylog:begin;";
+	case StopReason::Fault:
+		return "S0B";	//SIGSEGV
+	default:
+		return "S05";	//SIGTRAP
+	}
+}
+
+bool GdbStub::HandlePacket(const std::string& packet)
+{
+	char command = packet[0];
+
+	switch (command)
+	{
+	case '?':
+	{
+		SendPacket(StopReply());
+	} break;
+
+	case 'g':
+	{
+		SendPacket(ReadRegisters());
+	} break;
+
+	case 'G':
+	{
+		WriteRegisters(packet.substr(1));
+		debugger.StateChanged();
+		SendPacket("OK");
+	} break;
+
+	case 'p':
+	{
+		std::string hex;
+		unsigned int reg = static_cast<unsigned int>(strtoul(packet.c_str() + 1, nullptr, 16));
+		SendPacket(ReadRegister(reg, hex) ? hex : "E01");
+	} break;
+
+	case 'P':
+	{
+		size_t equals = packet.find('=');
+		unsigned int reg = static_cast<unsigned int>(strtoul(packet.c_str() + 1, nullptr, 16));
+		if (equals == std::string::npos || !WriteRegister(reg, packet.substr(equals + 1)))
+		{
+			SendPacket("E01");
+			break;
+		}
+		debugger.StateChanged();
+		SendPacket("OK");
+	} break;
+
+	case 'm':
+	case 'M':
+	{
+		//m addr,length / M addr,length:XX...
+		char* end;
+		unsigned long address = strtoul(packet.c_str() + 1, &end, 16);
+		unsigned long length = *end == ',' ? strtoul(end + 1, &end, 16) : 0;
+
+		//written so a huge address or length cannot wrap past the check
+		if (address >= MEMORY_MAX || length > MEMORY_MAX - address)
+		{
+			SendPacket("E01");
+			break;
+		}
+
+		if (command == 'm')
+		{
+			std::string hex;
+			for (unsigned long i = 0; i < length; ++i)
+			{
+				AppendHex(hex, chip8.memory[address + i]);
+			}
+			SendPacket(hex);
+		}
+		else
+		{
+			//every byte is decoded before any is written, so a bad one changes nothing
+			size_t colon = packet.find(':');
+			bool ok = colon != std::string::npos && packet.size() - colon - 1 >= length * 2;
+			uint8_t bytes[MEMORY_MAX];
+			for (unsigned long i = 0; ok && i < length; ++i)
+			{
+				unsigned int value;
+				ok = ParseHexBytes(packet, colon + 1 + i * 2, 1, value);
+				bytes[i] = static_cast<uint8_t>(value);
+			}
+			if (!ok)
+			{
+				SendPacket("E01");
+				break;
+			}
+			memcpy(&chip8.memory[address], bytes, length);
+			debugger.StateChanged();
+			SendPacket("OK");
+		}
+	} break;
+
+	case 'Z':
+	case 'z':
+	{
+		//Z<type>,addr,kind - 0/1 breakpoint, 2 write, 3 read, 4 access watchpoint
+		bool insert = command == 'Z';
+		char* end;
+		unsigned long type = strtoul(packet.c_str() + 1, &end, 16);
+		unsigned long address = *end == ',' ? strtoul(end + 1, &end, 16) : 0;
+		unsigned long length = *end == ',' ? strtoul(end + 1, &end, 16) : 1;
+
+		switch (type)
+		{
+		case 0:
+		case 1:
+			debugger.SetBreakpoint(static_cast<uint16_t>(address), insert);
+			break;
+		//only the kinds the packet names - a read and a write watchpoint can share an address
+		case 2:
+			debugger.ChangeWatchpoint(static_cast<uint16_t>(address), length, false, true, insert);
+			break;
+		case 3:
+			debugger.ChangeWatchpoint(static_cast<uint16_t>(address), length, true, false, insert);
+			break;
+		case 4:
+			debugger.ChangeWatchpoint(static_cast<uint16_t>(address), length, true, true, insert);
+			break;
+		default:
+			SendPacket("");
+			return true;
+		}
+		SendPacket("OK");
+	} break;
+
+	case 'c':
+	{
+		//optional resume address
+		if (packet.size() > 1)
+		{
+			chip8.pc = static_cast<uint16_t>(strtoul(packet.c_str() + 1, nullptr, 16));
+			debugger.StateChanged();
+		}
+		debugger.Resume();
+		runState = RunState::Running;
+	} break;
+
+	case 's':
+	{
+		if (packet.size() > 1)
+		{
+			chip8.pc = static_cast<uint16_t>(strtoul(packet.c_str() + 1, nullptr, 16));
+			debugger.StateChanged();
+		}
+		runState = RunState::Stepping;
+	} break;
+
+	case 'b':
+	{
+		//bs / bc - reverse step and continue, done here while the machine is halted
+		if (packet == "bs")
+		{
+			stopReason = debugger.ReverseStep();
+		}
+		else if (packet == "bc")
+		{
+			stopReason = debugger.ReverseContinue();
+		}
+		else
+		{
+			SendPacket("");
+			break;
+		}
+		runState = RunState::Halted;
+		stopPending = true;
+	} break;
+
+	case 'H':
+	{
+		SendPacket("OK");
+	} break;
+
+	case 'k':
+	{
+		return false;
+	}
+
+	case 'D':
+	{
+		SendPacket("OK");
+		return false;
+	}
+
+	case 'q':
+	{
+		if (packet.compare(0, 10, "qSupported") == 0)
+		{
+			char reply[128];
+			snprintf(reply, sizeof(reply), "PacketSize=%x;qXfer:features:read+;QStartNoAckMode+;ReverseStep+;ReverseContinue+", GDB_PACKET_SIZE);
+			SendPacket(reply);
+		}
+		else if (packet == "qAttached")
+		{
+			SendPacket("1");
+		}
+		else if (packet == "qC")
+		{
+			SendPacket("QC1");
+		}
+		else if (packet == "qfThreadInfo")
+		{
+			SendPacket("m1");
+		}
+		else if (packet == "qsThreadInfo")
+		{
+			SendPacket("l");
+		}
+		else if (packet.compare(0, 31, "qXfer:features:read:target.xml:") == 0)
+		{
+			char* end;
+			unsigned long offset = strtoul(packet.c_str() + 31, &end, 16);
+			unsigned long length = *end == ',' ? strtoul(end + 1, nullptr, 16) : 0;
+			std::string xml = TargetXml();
+
+			if (offset >= xml.size())
+			{
+				SendPacket("l");
+			}
+			else
+			{
+				std::string chunk = xml.substr(offset, length);
+				SendPacket((offset + chunk.size() >= xml.size() ? "l" : "m") + chunk);
+			}
+		}
+		else
+		{
+			SendPacket("");
+		}
+	} break;
+
+	case 'Q':
+	{
+		if (packet == "QStartNoAckMode")
+		{
+			SendPacket("OK");
+			noAck = true;
+		}
+		else
+		{
+			SendPacket("");
+		}
+	} break;
+
+	default:
+	{
+		//unsupported packets get an empty reply so the client falls back
+		SendPacket("");
+	} break;
+	}
+
+	return true;
+}
+
+//----------------------------------
+//			Registers
+//----------------------------------
+
+std::string GdbStub::ReadRegisters() const
+{
+	std::string hex;
+	for (unsigned int reg = 0; reg < REG_TOTAL; ++reg)
+	{
+		std::string value;
+		ReadRegister(reg, value);
+		hex += value;
+	}
+	return hex;
+}
+
+void GdbStub::WriteRegisters(const std::string& hex)
+{
+	size_t offset = 0;
+	for (unsigned int reg = 0; reg < REG_TOTAL; ++reg)
+	{
+		size_t width = (reg == REG_I || reg == REG_PC) ? 4 : 2;
+		if (offset + width > hex.size())
+		{
+			return;
+		}
+		WriteRegister(reg, hex.substr(offset, width));
+		offset += width;
+	}
+}
+
+bool GdbStub::ReadRegister(unsigned int reg, std::string& hex) const
+{
+	hex.clear();
+
+	if (reg < REGISTER_COUNT)
+	{
+		AppendHex(hex, chip8.registers[reg]);
+	}
+	else if (reg == REG_I || reg == REG_PC)
+	{
+		uint16_t value = reg == REG_I ? chip8.index : chip8.pc;
+		AppendHex(hex, value & 0xFF);
+		AppendHex(hex, value >> 8);
+	}
+	else if (reg == REG_SP)
+	{
+		AppendHex(hex, chip8.sp);
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool GdbStub::WriteRegister(unsigned int reg, const std::string& hex)
+{
+	unsigned int value;
+
+	if (reg < REGISTER_COUNT || reg == REG_SP)
+	{
+		if (!ParseHexBytes(hex, 0, 1, value))
+		{
+			return false;
+		}
+		if (reg == REG_SP)
+		{
+			chip8.sp = static_cast<uint8_t>(value);
+		}
+		else
+		{
+			chip8.registers[reg] = static_cast<uint8_t>(value);
+		}
+	}
+	else if (reg == REG_I || reg == REG_PC)
+	{
+		if (!ParseHexBytes(hex, 0, 2, value))
+		{
+			return false;
+		}
+		(reg == REG_I ? chip8.index : chip8.pc) = static_cast<uint16_t>(value);
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+std::string GdbStub::TargetXml() const
+{
+	std::string xml =
+		"<?xml version=\"1.0\"?>"
+		"<!DOCTYPE target SYSTEM \"gdb-target.dtd\">"
+		"<target version=\"1.0\"><feature name=\"org.chip8.core\">";
+
+	char reg[96];
+	for (unsigned int i = 0; i < REGISTER_COUNT; ++i)
+	{
+		snprintf(reg, sizeof(reg), "<reg name=\"v%x\" bitsize=\"8\" type=\"uint8\" regnum=\"%u\"/>", i, i);
+		xml += reg;
+	}
+	xml += "<reg name=\"i\" bitsize=\"16\" type=\"data_ptr\"/>"
+		"<reg name=\"pc\" bitsize=\"16\" type=\"code_ptr\"/>"
+		"<reg name=\"sp\" bitsize=\"8\" type=\"uint8\"/>"
+		"</feature></target>";
+
+	return xml;
+}
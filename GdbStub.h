@@ -0,0 +1,94 @@
+#pragma once
+#include "Chip8.h"
+#include "Debugger.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+
+//largest packet payload the stub accepts, advertised to gdb as PacketSize
+const unsigned int GDB_PACKET_SIZE = 4096;
+
+//GDB remote serial protocol stub
+//
+//The stub thread owns the socket. The emulation thread keeps calling Cycle()
+//directly until a client attaches; after that it calls Service() instead, which
+//holds the stub mutex for exactly one instruction, so the stub thread only ever
+//sees the machine between instructions. A new session waits for the first
+//Service() call before it touches the machine, since the emulation thread may be
+//inside a Cycle() it started before it saw the client. Anything else the
+//emulation thread reads or writes while attached (keypad, video) goes under Lock(),
+//as bs/bc replay instructions on the stub thread.
+//
+//Reverse step and continue (bs/bc) run back through the Debugger's history,
+//which covers the current session.
+//
+//Register layout (also served as target.xml): V0-VF (8 bit), I (16 bit),
+//pc (16 bit), sp (8 bit), multi-byte registers little endian.
+class GdbStub
+{
+public:
+	explicit GdbStub(Chip8& chip8);
+	~GdbStub();
+
+	//listen on 127.0.0.1:port, or on a Unix domain socket path
+	bool ListenTcp(unsigned short port);
+	bool ListenUnix(const char* path);
+
+	//checked once per main loop iteration - the only cost while nobody is attached
+	bool Attached() const { return attached.load(std::memory_order_relaxed); }
+	//emulation thread: run one instruction unless the client has halted the machine
+	void Service();
+	//emulation thread: the machine to itself until the lock is dropped; not held across Service()
+	std::unique_lock<std::mutex> Lock() { return std::unique_lock<std::mutex>(mutex); }
+
+private:
+	enum class RunState
+	{
+		Halted,
+		Running,
+		Stepping
+	};
+
+	Chip8& chip8;
+	Debugger debugger;
+
+	int listenFd = -1;
+	int clientFd = -1;
+	std::string unixPath;
+	std::thread thread;
+	std::atomic<bool> attached{ false };
+	std::atomic<bool> shutdown{ false };
+
+	//everything below is guarded by mutex
+	std::mutex mutex;
+	RunState runState = RunState::Halted;
+	bool stopPending = false;
+	StopReason stopReason = StopReason::None;
+	bool noAck = false;
+	//the emulation thread has called Service() since the client attached
+	bool serviced = false;
+	std::condition_variable servicedSignal;
+
+	void ServerLoop();
+	void Session();
+	//1 packet or interrupt read, 0 timeout, -1 connection closed
+	int ReadPacket(std::string& packet, bool& interrupt, int timeoutMs);
+	void SendPacket(const std::string& payload);
+	//returns false when the client detaches or kills the session
+	bool HandlePacket(const std::string& packet);
+	std::string StopReply() const;
+
+	std::string ReadRegisters() const;
+	void WriteRegisters(const std::string& hex);
+	bool ReadRegister(unsigned int reg, std::string& hex) const;
+	bool WriteRegister(unsigned int reg, const std::string& hex);
+	std::string TargetXml() const;
+
+	//a whole packet of GDB_PACKET_SIZE, with its $ and #xx
+	char inBuffer[GDB_PACKET_SIZE + 4];
+	size_t inStart = 0;
+	size_t inEnd = 0;
+};
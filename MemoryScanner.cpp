@@ -0,0 +1,162 @@
+#include "MemoryScanner.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if !defined(CHIP8_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CHIP8_SCAN_SSE2
+#include <emmintrin.h>
+#endif
+
+
+bool ParseWatch(const std::string& text, MemoryWatch& watch)
+{
+	size_t colon = text.find(':');
+	std::string address = text.substr(0, colon);
+	char* end = nullptr;
+	unsigned long value = strtoul(address.c_str(), &end, 16);
+	if (address.empty() || *end != '\0' || value >= MEMORY_MAX)
+	{
+		return false;
+	}
+
+	watch.address = static_cast<uint16_t>(value);
+	if (colon != std::string::npos && colon + 1 < text.size())
+	{
+		watch.name = text.substr(colon + 1);
+	}
+	else
+	{
+		char name[8];
+		snprintf(name, sizeof(name), "0x%03X", watch.address);
+		watch.name = name;
+	}
+	return true;
+}
+
+MemoryScanner::MemoryScanner(size_t instances)
+	: instances(instances), then(instances * MEMORY_MAX), now(instances * MEMORY_MAX)
+{
+	ResetCandidates();
+}
+
+void MemoryScanner::Snapshot(Chip8* const* machines)
+{
+	then.swap(now);
+	for (size_t i = 0; i < instances; ++i)
+	{
+		memcpy(&now[i * MEMORY_MAX], machines[i]->Memory(), MEMORY_MAX);
+	}
+	++snapshots;
+}
+
+void MemoryScanner::ResetCandidates()
+{
+	memset(candidates, 0xFF, sizeof(candidates));
+}
+
+size_t MemoryScanner::Candidates() const
+{
+	size_t count = 0;
+	for (uint8_t candidate : candidates)
+	{
+		count += candidate != 0;
+	}
+	return count;
+}
+
+std::vector<uint16_t> MemoryScanner::Addresses() const
+{
+	std::vector<uint16_t> addresses;
+	for (unsigned int address = 0; address < MEMORY_MAX; ++address)
+	{
+		if (candidates[address])
+		{
+			addresses.push_back(static_cast<uint16_t>(address));
+		}
+	}
+	return addresses;
+}
+
+#ifdef CHIP8_SCAN_SSE2
+//0xFF in every lane where the predicate holds
+static inline __m128i Keep(ScanPredicate predicate, __m128i now, __m128i then, __m128i value, bool any)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ones = _mm_set1_epi8(-1);
+
+	switch (predicate)
+	{
+	case ScanPredicate::Equal: return _mm_cmpeq_epi8(now, value);
+	case ScanPredicate::Changed: return _mm_xor_si128(_mm_cmpeq_epi8(now, then), ones);
+	case ScanPredicate::Unchanged: return _mm_cmpeq_epi8(now, then);
+	//unsigned now > then is a non-zero saturating now - then
+	case ScanPredicate::Increased: return any ? _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(now, then), zero), ones)
+		: _mm_cmpeq_epi8(_mm_sub_epi8(now, then), value);
+	case ScanPredicate::Decreased: return any ? _mm_xor_si128(_mm_cmpeq_epi8(_mm_subs_epu8(then, now), zero), ones)
+		: _mm_cmpeq_epi8(_mm_sub_epi8(then, now), value);
+	}
+	return ones;
+}
+#else
+static inline bool Keep(ScanPredicate predicate, uint8_t now, uint8_t then, uint8_t value)
+{
+	switch (predicate)
+	{
+	case ScanPredicate::Equal: return now == value;
+	case ScanPredicate::Changed: return now != then;
+	case ScanPredicate::Unchanged: return now == then;
+	case ScanPredicate::Increased: return value == 0 ? now > then : static_cast<uint8_t>(now - then) == value;
+	case ScanPredicate::Decreased: return value == 0 ? now < then : static_cast<uint8_t>(then - now) == value;
+	}
+	return true;
+}
+#endif
+
+size_t MemoryScanner::Narrow(ScanPredicate predicate, uint8_t value)
+{
+	if (snapshots == 0 || (predicate != ScanPredicate::Equal && snapshots < 2))
+	{
+		return Candidates();
+	}
+
+	//instance by instance, so both buffers stream through in order; the mask stays in L1
+	for (size_t i = 0; i < instances; ++i)
+	{
+		const uint8_t* current = &now[i * MEMORY_MAX];
+		const uint8_t* previous = &then[i * MEMORY_MAX];
+		bool left = false;
+
+#ifdef CHIP8_SCAN_SSE2
+		const __m128i target = _mm_set1_epi8(static_cast<char>(value));
+		for (unsigned int address = 0; address < MEMORY_MAX; address += 16)
+		{
+			__m128i mask = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&candidates[address]));
+			if (_mm_movemask_epi8(mask) == 0)
+			{
+				continue;
+			}
+
+			__m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(current + address));
+			__m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + address));
+			mask = _mm_and_si128(mask, Keep(predicate, a, b, target, value == 0));
+			_mm_storeu_si128(reinterpret_cast<__m128i*>(&candidates[address]), mask);
+			left = left || _mm_movemask_epi8(mask) != 0;
+		}
+#else
+		for (unsigned int address = 0; address < MEMORY_MAX; ++address)
+		{
+			candidates[address] &= Keep(predicate, current[address], previous[address], value) ? 0xFF : 0;
+			left = left || candidates[address] != 0;
+		}
+#endif
+
+		if (!left)
+		{
+			return 0;
+		}
+	}
+
+	return Candidates();
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include "Chip8.h"
+
+#include <string>
+#include <vector>
+
+//a named byte of machine memory to follow - a debugger display or a headless metric
+struct MemoryWatch
+{
+	uint16_t address;
+	std::string name;
+};
+
+//"0x2F0" or "0x2F0:score" (hex, the 0x optional); an unnamed watch is named after its address
+bool ParseWatch(const std::string& text, MemoryWatch& watch);
+
+//what Narrow() keeps, comparing each address's byte in the latest snapshot (now) with
+//the one before (then)
+enum class ScanPredicate : uint8_t
+{
+	Equal,		//now == value
+	Changed,	//now != then
+	Unchanged,	//now == then
+	Increased,	//now == then + value, or now > then for value 0
+	Decreased	//now == then - value, or now < then for value 0
+};
+
+//Cheat-engine style memory search over many instances of one ROM, to find where it
+//keeps its score, lives or level.
+//
+//Snapshot() copies the memory of every instance into one contiguous buffer, one
+//MEMORY_MAX stripe per instance, keeping the snapshot before it. Narrow() drops
+//every candidate address where the predicate fails in any instance, so instances
+//fed different keys or Cxkk streams rule out bytes that only looked right by
+//chance. Both buffers and the candidate mask are scanned 16 bytes at a time with
+//SSE2 (plain loops with CHIP8_NO_SIMD or elsewhere), skipping stripes of addresses
+//already ruled out; 10k instances are about 40 MB per snapshot.
+class MemoryScanner
+{
+public:
+	explicit MemoryScanner(size_t instances);
+
+	//memory of machines[0..instances), which must be the same machines every time
+	void Snapshot(Chip8* const* machines);
+	//candidates left; the predicates comparing with then need two snapshots and keep
+	//everything until there are
+	size_t Narrow(ScanPredicate predicate, uint8_t value = 0);
+	//every address a candidate again; snapshots are kept
+	void ResetCandidates();
+
+	size_t Instances() const { return instances; }
+	size_t Snapshots() const { return snapshots; }
+	size_t Candidates() const;
+	std::vector<uint16_t> Addresses() const;
+	//byte at address in the latest snapshot of instance
+	uint8_t Value(size_t instance, uint16_t address) const { return now[instance * MEMORY_MAX + address]; }
+
+private:
+	size_t instances;
+	size_t snapshots = 0;
+	std::vector<uint8_t> then;
+	std::vector<uint8_t> now;
+	uint8_t candidates[MEMORY_MAX];	//0xFF while the address is a candidate, else 0
+};
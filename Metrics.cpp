@@ -0,0 +1,331 @@
+#include "Metrics.h"
+#include "Socket.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+
+//how long the exporter sleeps in poll() between checks of the JSON interval
+const int EXPORT_POLL_MS = 100;
+//an HTTP client gets this long to send its request line
+const int REQUEST_TIMEOUT_MS = 500;
+
+void InstanceMetrics::Publish(const Chip8Stats& stats)
+{
+	instructions.Set(stats.instructions);
+	draws.Set(stats.draws);
+	collisions.Set(stats.collisions);
+	timerUnderflows.Set(stats.timerUnderflows);
+}
+
+void InstanceMetrics::PublishMemory(const uint8_t* memory, const std::vector<MemoryWatch>& watches)
+{
+	for (size_t i = 0; i < watches.size() && i < METRICS_WATCHES; ++i)
+	{
+		watched[i].Set(memory[watches[i].address]);
+	}
+}
+
+void InstanceMetrics::RecordFrame(uint32_t frameTimeUs)
+{
+	unsigned int bucket = 0;
+	while (bucket < FRAME_TIME_BUCKETS - 1 && frameTimeUs > FRAME_TIME_BOUNDS_US[bucket])
+	{
+		++bucket;
+	}
+
+	frameTime[bucket].Add();
+	frameTimeSumUs.Add(frameTimeUs);
+	frames.Add();
+}
+
+Metrics::~Metrics()
+{
+	shutdown = true;
+	if (thread.joinable())
+	{
+		thread.join();
+	}
+
+	CloseSocket(listenFd);
+}
+
+InstanceMetrics& Metrics::Register(const std::string& name)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	instances.push_back(std::make_unique<InstanceMetrics>(name));
+	return *instances.back();
+}
+
+bool Metrics::Watch(const MemoryWatch& watch)
+{
+	if (watches.size() >= METRICS_WATCHES)
+	{
+		return false;
+	}
+	watches.push_back(watch);
+	return true;
+}
+
+bool Metrics::Start(unsigned short httpPort, const std::string& jsonPath, unsigned int intervalMs)
+{
+	if (httpPort != 0)
+	{
+		listenFd = ListenTcpSocket(httpPort);
+		if (listenFd < 0)
+		{
+			return false;
+		}
+	}
+
+	if (!jsonPath.empty())
+	{
+		json.open(jsonPath, std::ios::app);
+		if (!json.is_open())
+		{
+			return false;
+		}
+	}
+
+	interval = std::chrono::milliseconds(intervalMs);
+	lastSample = std::chrono::steady_clock::now();
+	thread = std::thread(&Metrics::ExportLoop, this);
+	return true;
+}
+
+//----------------------------------
+//			Exporter thread
+//----------------------------------
+
+void Metrics::ExportLoop()
+{
+	auto nextExport = lastSample + interval;
+
+	while (!shutdown)
+	{
+		if (listenFd >= 0)
+		{
+			pollfd listener{};
+			listener.fd = listenFd;
+			listener.events = POLLIN;
+			if (poll(&listener, 1, EXPORT_POLL_MS) > 0 && (listener.revents & POLLIN))
+			{
+				int fd = static_cast<int>(accept(listenFd, nullptr, nullptr));
+				if (fd >= 0)
+				{
+					Serve(fd);
+					CloseSocket(fd);
+				}
+			}
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(EXPORT_POLL_MS));
+		}
+
+		auto now = std::chrono::steady_clock::now();
+		if (now >= nextExport)
+		{
+			Sample();
+			if (json.is_open())
+			{
+				json << JsonLine() << std::endl;
+			}
+			nextExport = now + interval;
+		}
+	}
+}
+
+//instructions per second of every instance since the previous sample
+void Metrics::Sample()
+{
+	auto now = std::chrono::steady_clock::now();
+	double seconds = std::chrono::duration<double>(now - lastSample).count();
+	lastSample = now;
+
+	std::lock_guard<std::mutex> guard(lock);
+	rates.resize(instances.size());
+	for (size_t i = 0; i < instances.size(); ++i)
+	{
+		uint64_t total = instances[i]->instructions.Get();
+		//counters go back to 0 when a machine is reset
+		uint64_t executed = total >= rates[i].instructions ? total - rates[i].instructions : total;
+		rates[i].perSecond = seconds > 0 ? executed / seconds : 0;
+		rates[i].instructions = total;
+	}
+}
+
+//instances registered since the last sample have no rate yet
+double Metrics::PerSecond(size_t instance) const
+{
+	return instance < rates.size() ? rates[instance].perSecond : 0;
+}
+
+//one short-lived HTTP/1.0 exchange; the loopback client is trusted to be quick
+void Metrics::Serve(int fd)
+{
+	char request[1024];
+	size_t length = 0;
+
+	while (length < sizeof(request) - 1 && memchr(request, '\n', length) == nullptr)
+	{
+		pollfd client{};
+		client.fd = fd;
+		client.events = POLLIN;
+		if (poll(&client, 1, REQUEST_TIMEOUT_MS) <= 0)
+		{
+			return;
+		}
+
+		int received = static_cast<int>(recv(fd, request + length, static_cast<int>(sizeof(request) - 1 - length), 0));
+		if (received <= 0)
+		{
+			return;
+		}
+		length += received;
+	}
+	request[length] = '\0';
+
+	bool found = strncmp(request, "GET /metrics ", 13) == 0 || strncmp(request, "GET / ", 6) == 0;
+	std::string body = found ? Prometheus() : "not found\n";
+
+	std::ostringstream response;
+	response << (found ? "HTTP/1.0 200 OK\r\n" : "HTTP/1.0 404 Not Found\r\n")
+		<< "Content-Type: text/plain; version=0.0.4\r\n"
+		<< "Content-Length: " << body.size() << "\r\n"
+		<< "Connection: close\r\n\r\n"
+		<< body;
+
+	std::string out = response.str();
+	size_t sent = 0;
+	while (sent < out.size())
+	{
+		int count = SendBytes(fd, out.data() + sent, out.size() - sent);
+		if (count <= 0)
+		{
+			return;
+		}
+		sent += count;
+	}
+}
+
+std::string Metrics::Prometheus()
+{
+	std::ostringstream out;
+	std::lock_guard<std::mutex> guard(lock);
+
+	//one family at a time, as the text format requires
+	auto family = [&](const char* name, const char* type, const char* help, const Counter InstanceMetrics::* counter)
+	{
+		out << "# HELP " << name << ' ' << help << "\n# TYPE " << name << ' ' << type << '\n';
+		for (const auto& instance : instances)
+		{
+			out << name << "{instance=\"" << instance->name << "\"} " << ((*instance).*counter).Get() << '\n';
+		}
+	};
+
+	family("chip8_instructions_total", "counter", "Instructions executed.", &InstanceMetrics::instructions);
+	family("chip8_draws_total", "counter", "Dxyn draw calls.", &InstanceMetrics::draws);
+	family("chip8_collisions_total", "counter", "Dxyn draws that set VF.", &InstanceMetrics::collisions);
+	family("chip8_timer_underflows_total", "counter", "Delay or sound timer ran out.", &InstanceMetrics::timerUnderflows);
+	family("chip8_frames_total", "counter", "Frames presented.", &InstanceMetrics::frames);
+	family("chip8_dropped_frames_total", "counter", "Frames skipped or not delivered.", &InstanceMetrics::droppedFrames);
+	family("chip8_input_events_total", "counter", "Key presses and releases.", &InstanceMetrics::inputEvents);
+
+	out << "# HELP chip8_instructions_per_second Instructions executed per second since the previous sample.\n"
+		<< "# TYPE chip8_instructions_per_second gauge\n";
+	for (size_t i = 0; i < instances.size(); ++i)
+	{
+		out << "chip8_instructions_per_second{instance=\"" << instances[i]->name << "\"} " << std::fixed << std::setprecision(1) << PerSecond(i) << '\n';
+	}
+
+	if (!watches.empty())
+	{
+		out << "# HELP chip8_memory Watched bytes of machine memory.\n"
+			<< "# TYPE chip8_memory gauge\n";
+		for (const auto& instance : instances)
+		{
+			for (size_t w = 0; w < watches.size(); ++w)
+			{
+				char address[8];
+				snprintf(address, sizeof(address), "0x%03X", watches[w].address);
+				out << "chip8_memory{instance=\"" << instance->name << "\",name=\"" << watches[w].name << "\",address=\"" << address << "\"} "
+					<< instance->watched[w].Get() << '\n';
+			}
+		}
+	}
+
+	out << "# HELP chip8_frame_time_seconds Time between presented frames.\n"
+		<< "# TYPE chip8_frame_time_seconds histogram\n";
+	for (const auto& instance : instances)
+	{
+		uint64_t cumulative = 0;
+		for (unsigned int bucket = 0; bucket < FRAME_TIME_BUCKETS; ++bucket)
+		{
+			cumulative += instance->frameTime[bucket].Get();
+			out << "chip8_frame_time_seconds_bucket{instance=\"" << instance->name << "\",le=\"";
+			if (bucket < FRAME_TIME_BUCKETS - 1)
+			{
+				out << std::setprecision(4) << FRAME_TIME_BOUNDS_US[bucket] / 1e6;
+			}
+			else
+			{
+				out << "+Inf";
+			}
+			out << "\"} " << cumulative << '\n';
+		}
+		out << "chip8_frame_time_seconds_sum{instance=\"" << instance->name << "\"} " << std::setprecision(6) << instance->frameTimeSumUs.Get() / 1e6 << '\n'
+			<< "chip8_frame_time_seconds_count{instance=\"" << instance->name << "\"} " << cumulative << '\n';
+	}
+
+	return out.str();
+}
+
+std::string Metrics::JsonLine()
+{
+	std::ostringstream out;
+	std::lock_guard<std::mutex> guard(lock);
+
+	auto unixMs = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	out << "{\"time_ms\":" << unixMs << ",\"instances\":[";
+
+	for (size_t i = 0; i < instances.size(); ++i)
+	{
+		const InstanceMetrics& instance = *instances[i];
+		out << (i > 0 ? "," : "") << "{\"instance\":\"" << instance.name << '"'
+			<< ",\"instructions\":" << instance.instructions.Get()
+			<< ",\"instructions_per_second\":" << std::fixed << std::setprecision(1) << PerSecond(i)
+			<< ",\"draws\":" << instance.draws.Get()
+			<< ",\"collisions\":" << instance.collisions.Get()
+			<< ",\"timer_underflows\":" << instance.timerUnderflows.Get()
+			<< ",\"frames\":" << instance.frames.Get()
+			<< ",\"dropped_frames\":" << instance.droppedFrames.Get()
+			<< ",\"input_events\":" << instance.inputEvents.Get()
+			<< ",\"frame_time_us\":{\"bounds\":[";
+		for (unsigned int bucket = 0; bucket < FRAME_TIME_BUCKETS - 1; ++bucket)
+		{
+			out << (bucket > 0 ? "," : "") << FRAME_TIME_BOUNDS_US[bucket];
+		}
+		out << "],\"counts\":[";
+		for (unsigned int bucket = 0; bucket < FRAME_TIME_BUCKETS; ++bucket)
+		{
+			out << (bucket > 0 ? "," : "") << instance.frameTime[bucket].Get();
+		}
+		out << "],\"sum\":" << instance.frameTimeSumUs.Get() << '}';
+		if (!watches.empty())
+		{
+			out << ",\"memory\":{";
+			for (size_t w = 0; w < watches.size(); ++w)
+			{
+				out << (w > 0 ? "," : "") << '"' << watches[w].name << "\":" << instance.watched[w].Get();
+			}
+			out << '}';
+		}
+		out << '}';
+	}
+
+	out << "]}";
+	return out.str();
+}
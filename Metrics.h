@@ -0,0 +1,109 @@
+#pragma once
+#include "Chip8.h"
+#include "MemoryScanner.h"
+
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+//A value with a single writer. The owning thread updates it with a plain load and
+//store - no locked instruction - and the exporter reads it whenever it likes;
+//relaxed ordering is all a counter needs.
+class Counter
+{
+public:
+	void Add(uint64_t n = 1) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+	void Set(uint64_t n) { value.store(n, std::memory_order_relaxed); }
+	uint64_t Get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> value{ 0 };
+};
+
+//frame time histogram: upper bounds in microseconds, the last bucket takes the rest
+const unsigned int FRAME_TIME_BUCKETS = 8;
+const uint32_t FRAME_TIME_BOUNDS_US[FRAME_TIME_BUCKETS - 1] = { 4000, 8000, 16000, 17500, 20000, 33000, 50000 };
+//memory bytes every instance exports (score, lives... found with MemoryScanner)
+const unsigned int METRICS_WATCHES = 8;
+
+//Counters of one instance, written only by the thread that runs it. The machine
+//keeps its own totals in Chip8Stats and they are copied here once per frame, so
+//the interpreter loop pays nothing per instruction beyond a plain increment.
+struct alignas(64) InstanceMetrics
+{
+	explicit InstanceMetrics(const std::string& name) : name(name) {}
+
+	void Publish(const Chip8Stats& stats);
+	//the watched bytes of memory, in the order Metrics::Watch() added them
+	void PublishMemory(const uint8_t* memory, const std::vector<MemoryWatch>& watches);
+	//one presented frame, frameTimeUs since the one before
+	void RecordFrame(uint32_t frameTimeUs);
+
+	const std::string name;
+
+	Counter instructions;
+	Counter draws;
+	Counter collisions;
+	Counter timerUnderflows;
+
+	Counter frames;
+	Counter droppedFrames;
+	Counter inputEvents;
+	Counter frameTime[FRAME_TIME_BUCKETS];
+	Counter frameTimeSumUs;
+	Counter watched[METRICS_WATCHES];
+};
+
+//Registry of instance counters and their exporter. The exporter thread serves
+//Prometheus text on http://127.0.0.1:port/metrics and/or appends one JSON object
+//per interval to a file; it also works out instructions per second, so neither
+//output needs the scraper to take rates.
+class Metrics
+{
+public:
+	Metrics() = default;
+	~Metrics();
+
+	//counters for a new instance, valid as long as Metrics is; any thread
+	InstanceMetrics& Register(const std::string& name);
+	//export a byte of every instance's memory as a gauge; before Start(), false when
+	//METRICS_WATCHES are taken
+	bool Watch(const MemoryWatch& watch);
+	const std::vector<MemoryWatch>& Watches() const { return watches; }
+
+	//port 0 skips HTTP, an empty path skips the JSON file
+	bool Start(unsigned short httpPort, const std::string& jsonPath, unsigned int intervalMs = 1000);
+
+private:
+	struct Rate
+	{
+		uint64_t instructions = 0;
+		double perSecond = 0;
+	};
+
+	std::mutex lock;
+	std::vector<std::unique_ptr<InstanceMetrics>> instances;
+	std::vector<MemoryWatch> watches;
+
+	int listenFd = -1;
+	std::ofstream json;
+	std::chrono::milliseconds interval{ 1000 };
+	std::thread thread;
+	std::atomic<bool> shutdown{ false };
+
+	//exporter thread only
+	std::vector<Rate> rates;
+	std::chrono::steady_clock::time_point lastSample;
+
+	void ExportLoop();
+	void Sample();
+	double PerSecond(size_t instance) const;
+	void Serve(int fd);
+	std::string Prometheus();
+	std::string JsonLine();
+};
@@ -0,0 +1,136 @@
+#include "Mosaic.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+Mosaic::Mosaic(unsigned int tiles)
+	: tiles(std::max(1u, tiles))
+{
+	//as many columns as rows - tiles are 2:1 so the window comes out landscape
+	columns = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<double>(this->tiles))));
+	rows = (this->tiles + columns - 1) / columns;
+	atlas.assign(static_cast<size_t>(Width()) * Height(), 0);
+
+	for (unsigned int tile = 0; tile < this->tiles; ++tile)
+	{
+		DrawFrame(tile, tile == focus ? FOCUS_COLOUR : FRAME_COLOUR);
+	}
+
+	dirtyLeft = dirtyTop = 0;
+	dirtyRight = columns - 1;
+	dirtyBottom = rows - 1;
+}
+
+uint32_t* Mosaic::TilePixel(unsigned int tile, unsigned int x, unsigned int y)
+{
+	size_t row = (tile / columns) * TILE_HEIGHT + y;
+	size_t column = (tile % columns) * TILE_WIDTH + x;
+	return &atlas[row * Width() + column];
+}
+
+void Mosaic::Blit(unsigned int tile, const uint32_t* video)
+{
+	if (tile >= tiles)
+	{
+		return;
+	}
+
+	const size_t rowBytes = VIDEO_WIDTH * sizeof(uint32_t);
+	bool changed = false;
+
+	for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y)
+	{
+		uint32_t* row = TilePixel(tile, 1, y + 1);
+		const uint32_t* source = video + y * VIDEO_WIDTH;
+		if (memcmp(row, source, rowBytes) != 0)
+		{
+			memcpy(row, source, rowBytes);
+			changed = true;
+		}
+	}
+
+	if (changed)
+	{
+		MarkDirty(tile);
+	}
+}
+
+void Mosaic::SetFocus(unsigned int tile)
+{
+	if (tile >= tiles || tile == focus)
+	{
+		return;
+	}
+
+	DrawFrame(focus, FRAME_COLOUR);
+	MarkDirty(focus);
+	focus = tile;
+	DrawFrame(focus, FOCUS_COLOUR);
+	MarkDirty(focus);
+}
+
+bool Mosaic::TakeDirty(int& x, int& y, int& width, int& height)
+{
+	if (dirtyLeft > dirtyRight)
+	{
+		return false;
+	}
+
+	x = static_cast<int>(dirtyLeft * TILE_WIDTH);
+	y = static_cast<int>(dirtyTop * TILE_HEIGHT);
+	width = static_cast<int>((dirtyRight - dirtyLeft + 1) * TILE_WIDTH);
+	height = static_cast<int>((dirtyBottom - dirtyTop + 1) * TILE_HEIGHT);
+
+	dirtyLeft = dirtyTop = ~0u;
+	dirtyRight = dirtyBottom = 0;
+	return true;
+}
+
+int Mosaic::TileAt(int x, int y, int windowWidth, int windowHeight) const
+{
+	if (x < 0 || y < 0 || x >= windowWidth || y >= windowHeight)
+	{
+		return -1;
+	}
+
+	//the texture is stretched over the whole window
+	unsigned int column = static_cast<unsigned int>(static_cast<long long>(x) * Width() / windowWidth) / TILE_WIDTH;
+	unsigned int row = static_cast<unsigned int>(static_cast<long long>(y) * Height() / windowHeight) / TILE_HEIGHT;
+	unsigned int tile = row * columns + column;
+
+	return tile < tiles ? static_cast<int>(tile) : -1;
+}
+
+void Mosaic::DrawFrame(unsigned int tile, uint32_t colour)
+{
+	for (unsigned int x = 0; x < TILE_WIDTH; ++x)
+	{
+		*TilePixel(tile, x, 0) = colour;
+		*TilePixel(tile, x, TILE_HEIGHT - 1) = colour;
+	}
+	for (unsigned int y = 1; y < TILE_HEIGHT - 1; ++y)
+	{
+		*TilePixel(tile, 0, y) = colour;
+		*TilePixel(tile, TILE_WIDTH - 1, y) = colour;
+	}
+}
+
+void Mosaic::MarkDirty(unsigned int tile)
+{
+	unsigned int column = tile % columns;
+	unsigned int row = tile / columns;
+
+	if (dirtyLeft > dirtyRight)
+	{
+		dirtyLeft = dirtyRight = column;
+		dirtyTop = dirtyBottom = row;
+		return;
+	}
+
+	dirtyLeft = std::min(dirtyLeft, column);
+	dirtyRight = std::max(dirtyRight, column);
+	dirtyTop = std::min(dirtyTop, row);
+	dirtyBottom = std::max(dirtyBottom, row);
+}
@@ -0,0 +1,50 @@
+#pragma once
+#include "Chip8.h"
+
+#include <vector>
+
+//Packs the displays of many instances into one atlas image laid out as a grid,
+//so a single streaming texture (SDL_Layer) shows all of them.
+//
+//Each tile is the 64x32 display inside a one pixel frame; the focused tile's
+//frame is highlighted. Blit() only copies a display that changed and the atlas
+//tracks the bounding box of changed tiles, so the upload each frame covers what
+//was redrawn rather than every instance.
+class Mosaic
+{
+public:
+	explicit Mosaic(unsigned int tiles);
+
+	unsigned int Tiles() const { return tiles; }
+	int Width() const { return static_cast<int>(columns * TILE_WIDTH); }
+	int Height() const { return static_cast<int>(rows * TILE_HEIGHT); }
+	int Pitch() const { return Width() * static_cast<int>(sizeof(uint32_t)); }
+	const uint32_t* Atlas() const { return atlas.data(); }
+
+	void Blit(unsigned int tile, const uint32_t* video);
+	void SetFocus(unsigned int tile);
+	//changed area since the last call in atlas pixels, false when nothing changed
+	bool TakeDirty(int& x, int& y, int& width, int& height);
+	//tile under a point of a window showing the whole atlas, -1 for none
+	int TileAt(int x, int y, int windowWidth, int windowHeight) const;
+
+private:
+	static const unsigned int TILE_WIDTH = VIDEO_WIDTH + 2;
+	static const unsigned int TILE_HEIGHT = VIDEO_HEIGHT + 2;
+	//RGBA8888 like the interpreter's texture
+	static const uint32_t FRAME_COLOUR = 0x303030FF;
+	static const uint32_t FOCUS_COLOUR = 0xFFA000FF;
+
+	unsigned int tiles;
+	unsigned int columns;
+	unsigned int rows;
+	unsigned int focus = 0;
+	std::vector<uint32_t> atlas;
+
+	//dirty box in tile units, empty when first > last
+	unsigned int dirtyLeft, dirtyTop, dirtyRight, dirtyBottom;
+
+	uint32_t* TilePixel(unsigned int tile, unsigned int x, unsigned int y);
+	void DrawFrame(unsigned int tile, uint32_t colour);
+	void MarkDirty(unsigned int tile);
+};
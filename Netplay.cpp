@@ -0,0 +1,283 @@
+#include "Netplay.h"
+#include "Socket.h"
+
+#include <algorithm>
+
+
+//packet: 'N' 'P' session(u32) first frame(u32) ack(u32) count(u8) then count keypads (u16), all LE
+const unsigned int NETPLAY_HEADER = 15;
+//a stalled machine still sends this often, so acknowledgements keep flowing
+const int NETPLAY_RESEND_MS = 16;
+
+static void Put32(uint8_t* out, uint32_t value)
+{
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		out[i] = static_cast<uint8_t>(value >> (8 * i));
+	}
+}
+
+static uint32_t Get32(const uint8_t* in)
+{
+	return in[0] | in[1] << 8 | in[2] << 16 | static_cast<uint32_t>(in[3]) << 24;
+}
+
+Netplay::Netplay(Chip8& chip8, unsigned int instructionsPerFrame)
+	: chip8(chip8), instructionsPerFrame(instructionsPerFrame)
+{
+}
+
+Netplay::~Netplay()
+{
+	CloseSocket(fd);
+}
+
+bool Netplay::Open(unsigned short localPort, unsigned short peerPort)
+{
+	fd = ListenTcpSocket(localPort, SOCK_DGRAM);
+	if (fd < 0)
+	{
+		return false;
+	}
+	SetNonBlocking(fd);
+	this->peerPort = peerPort;
+
+	//FNV-1a of the power-on machine and the frame length - both sides must agree on both
+	Chip8State state;
+	chip8.SaveState(state);
+	session = 0x811C9DC5u;
+	for (uint8_t byte : state.memory)
+	{
+		session = (session ^ byte) * 0x01000193u;
+	}
+	session = (session ^ instructionsPerFrame) * 0x01000193u;
+
+	lastSend = Clock::now();
+	return true;
+}
+
+void Netplay::SetConditions(unsigned int delayMs, unsigned int jitterMs, unsigned int lossPercent, uint32_t seed)
+{
+	this->delayMs = delayMs;
+	this->jitterMs = jitterMs;
+	this->lossPercent = lossPercent;
+	rngState = seed != 0 ? seed : 1;
+}
+
+void Netplay::Poll()
+{
+	Receive();
+	Rollback();
+
+	auto now = Clock::now();
+	if (now - lastSend >= std::chrono::milliseconds(NETPLAY_RESEND_MS))
+	{
+		Send();
+	}
+
+	//packets held back by SetConditions() whose time has come
+	for (auto it = delayed.begin(); it != delayed.end();)
+	{
+		if (it->due <= now)
+		{
+			SendDatagram(fd, peerPort, it->packet.data(), it->packet.size());
+			it = delayed.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+bool Netplay::AdvanceFrame(const bool* keys)
+{
+	//too far ahead of the peer to predict, or about to overwrite keys it may still need
+	if (frame >= remoteFrames + NETPLAY_MAX_ROLLBACK || frame >= peerAck + NETPLAY_HISTORY)
+	{
+		++stats.stalls;
+		return false;
+	}
+
+	uint16_t mask = 0;
+	for (unsigned int key = 0; key < KEY_COUNT; ++key)
+	{
+		mask |= keys[key] ? 1u << key : 0;
+	}
+	localKeys[frame % NETPLAY_HISTORY] = mask;
+
+	RunFrame(frame);
+	++frame;
+	Send();
+	return true;
+}
+
+//----------------------------------
+//			Simulation
+//----------------------------------
+
+//known keys, or the last known ones held
+uint16_t Netplay::PeerKeys(uint32_t at) const
+{
+	if (at < remoteFrames)
+	{
+		return remoteKeys[at % NETPLAY_HISTORY];
+	}
+	return remoteFrames > 0 ? remoteKeys[(remoteFrames - 1) % NETPLAY_HISTORY] : 0;
+}
+
+void Netplay::RunFrame(uint32_t at)
+{
+	chip8.SaveState(states[at % NETPLAY_STATES]);
+
+	uint16_t peer = PeerKeys(at);
+	usedKeys[at % NETPLAY_HISTORY] = peer;
+	uint16_t keys = localKeys[at % NETPLAY_HISTORY] | peer;
+	for (unsigned int key = 0; key < KEY_COUNT; ++key)
+	{
+		chip8.keypad[key] = (keys >> key) & 1u;
+	}
+
+	if (instructionsPerFrame == 0)
+	{
+		chip8.RunFrame();
+		return;
+	}
+
+	for (unsigned int i = 0; i < instructionsPerFrame; ++i)
+	{
+		chip8.Cycle();
+	}
+}
+
+//back to the first frame that ran with the wrong keys, then forward to where we were
+void Netplay::Rollback()
+{
+	if (rollbackFrom >= frame)
+	{
+		rollbackFrom = UINT32_MAX;
+		return;
+	}
+
+	auto start = Clock::now();
+	unsigned int depth = frame - rollbackFrom;
+
+	chip8.LoadState(states[rollbackFrom % NETPLAY_STATES]);
+	for (uint32_t at = rollbackFrom; at < frame; ++at)
+	{
+		RunFrame(at);
+	}
+	rollbackFrom = UINT32_MAX;
+
+	uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - start).count();
+	++stats.rollbacks;
+	stats.resimulatedFrames += depth;
+	stats.deepestRollback = std::max(stats.deepestRollback, depth);
+	stats.rollbackUs += us;
+	stats.slowestRollbackUs = std::max(stats.slowestRollbackUs, us);
+}
+
+//----------------------------------
+//			Network
+//----------------------------------
+
+void Netplay::Receive()
+{
+	uint8_t packet[NETPLAY_HEADER + 2 * 255];
+
+	for (;;)
+	{
+		int length = static_cast<int>(recv(fd, reinterpret_cast<char*>(packet), sizeof(packet), 0));
+		if (length < 0)
+		{
+			//WouldBlock, or an ICMP error from a peer that is not there yet
+			return;
+		}
+
+		if (length < static_cast<int>(NETPLAY_HEADER) || packet[0] != 'N' || packet[1] != 'P'
+			|| length < static_cast<int>(NETPLAY_HEADER + 2 * packet[14]))
+		{
+			continue;
+		}
+		if (Get32(&packet[2]) != session)
+		{
+			++stats.rejected;
+			continue;
+		}
+		++stats.received;
+
+		uint32_t first = Get32(&packet[6]);
+		peerAck = std::max(peerAck, std::min(Get32(&packet[10]), frame));
+
+		//take keys in order only; anything past a gap comes again in a later packet
+		for (uint32_t i = 0; i < packet[14]; ++i)
+		{
+			uint32_t at = first + i;
+			if (at != remoteFrames)
+			{
+				continue;
+			}
+
+			uint16_t keys = static_cast<uint16_t>(packet[NETPLAY_HEADER + 2 * i] | packet[NETPLAY_HEADER + 2 * i + 1] << 8);
+			remoteKeys[at % NETPLAY_HISTORY] = keys;
+			++remoteFrames;
+
+			if (at < frame && keys != usedKeys[at % NETPLAY_HISTORY])
+			{
+				rollbackFrom = std::min(rollbackFrom, at);
+			}
+		}
+	}
+}
+
+//every local frame the peer has not acknowledged, and how far its keys have arrived
+void Netplay::Send()
+{
+	uint32_t count = frame - peerAck;
+	std::vector<uint8_t> packet(NETPLAY_HEADER + 2 * count);
+
+	packet[0] = 'N';
+	packet[1] = 'P';
+	Put32(&packet[2], session);
+	Put32(&packet[6], peerAck);
+	Put32(&packet[10], remoteFrames);
+	packet[14] = static_cast<uint8_t>(count);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		uint16_t keys = localKeys[(peerAck + i) % NETPLAY_HISTORY];
+		packet[NETPLAY_HEADER + 2 * i] = static_cast<uint8_t>(keys);
+		packet[NETPLAY_HEADER + 2 * i + 1] = static_cast<uint8_t>(keys >> 8);
+	}
+
+	Transmit(packet);
+	lastSend = Clock::now();
+}
+
+void Netplay::Transmit(const std::vector<uint8_t>& packet)
+{
+	++stats.sent;
+
+	if (lossPercent > 0 && Random() % 100 < lossPercent)
+	{
+		++stats.dropped;
+		return;
+	}
+
+	if (delayMs == 0 && jitterMs == 0)
+	{
+		SendDatagram(fd, peerPort, packet.data(), packet.size());
+		return;
+	}
+
+	unsigned int ms = delayMs + (jitterMs > 0 ? Random() % (jitterMs + 1) : 0);
+	delayed.push_back(Delayed{ Clock::now() + std::chrono::milliseconds(ms), packet });
+}
+
+//xorshift32
+uint32_t Netplay::Random()
+{
+	rngState ^= rngState << 13;
+	rngState ^= rngState >> 17;
+	rngState ^= rngState << 5;
+	return rngState;
+}
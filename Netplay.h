@@ -0,0 +1,115 @@
+#pragma once
+#include "Chip8.h"
+
+#include <chrono>
+#include <deque>
+#include <vector>
+
+//both machines are reset with this Cxkk seed before the ROM is loaded
+const uint32_t NETPLAY_SEED = 1;
+//frames the machine may run ahead of the last input received from the peer;
+//also the deepest rollback
+const unsigned int NETPLAY_MAX_ROLLBACK = 8;
+//frames of keys kept for resending and prediction, a power of two
+const unsigned int NETPLAY_HISTORY = 64;
+//saved states, enough for the deepest rollback; a power of two
+const unsigned int NETPLAY_STATES = 16;
+static_assert(NETPLAY_STATES > NETPLAY_MAX_ROLLBACK && NETPLAY_HISTORY >= 2 * NETPLAY_STATES, "netplay rings too small");
+
+struct NetplayStats
+{
+	uint64_t rollbacks;
+	uint64_t resimulatedFrames;
+	unsigned int deepestRollback;	//frames
+	uint64_t rollbackUs;			//total time spent restoring and re-simulating
+	uint64_t slowestRollbackUs;
+	uint64_t stalls;				//AdvanceFrame() calls that waited for the peer
+	uint64_t sent;
+	uint64_t received;
+	uint64_t dropped;				//lost on purpose by SetConditions()
+	uint64_t rejected;				//from another ROM or interpreter setup
+};
+
+//Rollback netplay for two processes sharing one keypad over loopback UDP.
+//
+//Both machines start from the same seed and ROM and advance in whole frames.
+//The keypad of frame f is this player's keys OR the peer's keys for frame f.
+//Local keys are sent as soon as their frame runs. The peer's keys are predicted
+//to stay as they last were. Every frame saves the machine state first - a
+//single copy of Chip8State. When the peer's keys for a past frame arrive and
+//differ from the prediction, the state of that frame is restored and the
+//frames since are run again. A machine more than NETPLAY_MAX_ROLLBACK frames
+//ahead of the peer's input stalls instead of guessing further.
+//
+//Every packet carries all local keys the peer has not acknowledged, so a lost
+//packet is made good by the next one and nothing is ever resent on a timer
+//alone. SetConditions() delays, jitters and drops outgoing packets for testing.
+class Netplay
+{
+public:
+	//instructionsPerFrame 0 runs frames with Chip8::RunFrame() (VIP timing)
+	Netplay(Chip8& chip8, unsigned int instructionsPerFrame);
+	~Netplay();
+
+	//UDP on 127.0.0.1:localPort, talking to 127.0.0.1:peerPort; the machine must
+	//be reset and loaded identically on both sides first
+	bool Open(unsigned short localPort, unsigned short peerPort);
+	//artificial latency and loss applied to every packet sent
+	void SetConditions(unsigned int delayMs, unsigned int jitterMs, unsigned int lossPercent, uint32_t seed);
+
+	//receive, rolling back if needed, and send anything due; call at least once per frame
+	void Poll();
+	//run one frame with this player's keys; false (nothing run) while stalled on the peer
+	bool AdvanceFrame(const bool* localKeys);
+
+	//frames run so far
+	uint32_t Frame() const { return frame; }
+	//frames the peer's keys are known for - the machine is exact up to here
+	uint32_t Confirmed() const { return remoteFrames; }
+	//frames of this player's keys the peer has acknowledged
+	uint32_t Acknowledged() const { return peerAck; }
+	const NetplayStats& Stats() const { return stats; }
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Delayed
+	{
+		Clock::time_point due;
+		std::vector<uint8_t> packet;
+	};
+
+	Chip8& chip8;
+	unsigned int instructionsPerFrame;
+	int fd = -1;
+	unsigned short peerPort = 0;
+	uint32_t session = 0;	//hash of the loaded machine; packets of another session are ignored
+
+	uint32_t frame = 0;
+	uint32_t remoteFrames = 0;
+	uint32_t peerAck = 0;
+	uint32_t rollbackFrom = UINT32_MAX;	//earliest mispredicted frame, UINT32_MAX if none
+
+	Chip8State states[NETPLAY_STATES];	//before the frame ran, by frame % NETPLAY_STATES
+	//by frame % NETPLAY_HISTORY
+	uint16_t localKeys[NETPLAY_HISTORY];
+	uint16_t remoteKeys[NETPLAY_HISTORY];	//peer's keys, valid below remoteFrames
+	uint16_t usedKeys[NETPLAY_HISTORY];		//peer's keys the frame actually ran with
+
+	unsigned int delayMs = 0;
+	unsigned int jitterMs = 0;
+	unsigned int lossPercent = 0;
+	uint32_t rngState = 1;
+	std::deque<Delayed> delayed;	//held back by SetConditions()
+	Clock::time_point lastSend;
+
+	NetplayStats stats{};
+
+	uint16_t PeerKeys(uint32_t at) const;
+	void RunFrame(uint32_t at);
+	void Receive();
+	void Rollback();
+	void Send();
+	void Transmit(const std::vector<uint8_t>& packet);
+	uint32_t Random();
+};
@@ -0,0 +1,88 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+//Counter-based random streams for Cxkk.
+//
+//A stream is named by a key made from the run's seed and the instance's id, and its
+//n-th byte is a pure function of (key, n): nothing is carried from one draw to the
+//next but the counter. A machine keeps just the key and the number of bytes drawn
+//(12 bytes of Chip8State), so a save state restores the stream exactly, every
+//instance of a batch gets its own stream whatever thread runs it and in whatever
+//order, and a batch of instances can draw in one loop with no dependency between
+//lanes (RandomBytes).
+//
+//A policy is a struct with static Key(seed, instance) and Byte(key, counter).
+//SplitMixRandom is the default; define CHIP8_RANDOM_PHILOX for Philox4x32-10.
+
+//SplitMix64's finaliser over a Weyl sequence: two multiplies per byte
+struct SplitMixRandom
+{
+	static const uint32_t ID = 1;
+
+	static uint64_t Mix(uint64_t z)
+	{
+		z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+		z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+		return z ^ (z >> 31);
+	}
+
+	//mixed once, so streams of neighbouring seeds or instances start far apart
+	static uint64_t Key(uint32_t seed, uint32_t instance)
+	{
+		return Mix(static_cast<uint64_t>(seed) << 32 | instance);
+	}
+
+	static uint8_t Byte(uint64_t key, uint32_t counter)
+	{
+		return static_cast<uint8_t>(Mix(key + (counter + 1ull) * 0x9E3779B97F4A7C15ull) >> 56);
+	}
+};
+
+//Philox4x32-10 (Salmon et al., Random123) with the counter in the first word;
+//twenty 32 x 32 -> 64 bit multiplies per byte, statistically the stronger of the two
+struct PhiloxRandom
+{
+	static const uint32_t ID = 2;
+
+	static uint64_t Key(uint32_t seed, uint32_t instance)
+	{
+		return static_cast<uint64_t>(seed) << 32 | instance;
+	}
+
+	static uint8_t Byte(uint64_t key, uint32_t counter)
+	{
+		uint32_t c0 = counter, c1 = 0, c2 = 0, c3 = 0;
+		uint32_t k0 = static_cast<uint32_t>(key), k1 = static_cast<uint32_t>(key >> 32);
+
+		for (unsigned int round = 0; round < 10; ++round)
+		{
+			uint64_t p0 = static_cast<uint64_t>(0xD2511F53u) * c0;
+			uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57u) * c2;
+			uint32_t n0 = static_cast<uint32_t>(p1 >> 32) ^ c1 ^ k0;
+			uint32_t n2 = static_cast<uint32_t>(p0 >> 32) ^ c3 ^ k1;
+			c1 = static_cast<uint32_t>(p1);
+			c3 = static_cast<uint32_t>(p0);
+			c0 = n0;
+			c2 = n2;
+			k0 += 0x9E3779B9u;
+			k1 += 0xBB67AE85u;
+		}
+		return static_cast<uint8_t>(c0 >> 24);
+	}
+};
+
+#ifdef CHIP8_RANDOM_PHILOX
+typedef PhiloxRandom Chip8Random;
+#else
+typedef SplitMixRandom Chip8Random;
+#endif
+
+//one byte for each of count streams, advancing their counters
+inline void RandomBytes(const uint64_t* keys, uint32_t* counters, uint8_t* out, size_t count)
+{
+	for (size_t i = 0; i < count; ++i)
+	{
+		out[i] = Chip8Random::Byte(keys[i], counters[i]++);
+	}
+}
@@ -0,0 +1,84 @@
+#include "Recompiled.h"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
+
+
+Recompiled::~Recompiled()
+{
+	if (library != nullptr)
+	{
+#ifdef _WIN32
+		FreeLibrary(static_cast<HMODULE>(library));
+#else
+		dlclose(library);
+#endif
+	}
+}
+
+bool Recompiled::Load(const char* path)
+{
+#ifdef _WIN32
+	library = LoadLibraryA(path);
+	if (library == nullptr)
+	{
+		error = std::string("unable to load ") + path;
+		return false;
+	}
+	RecompiledInfoFunc getInfo = reinterpret_cast<RecompiledInfoFunc>(GetProcAddress(static_cast<HMODULE>(library), "Chip8Recompiled"));
+#else
+	library = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+	if (library == nullptr)
+	{
+		error = dlerror();
+		return false;
+	}
+	RecompiledInfoFunc getInfo = reinterpret_cast<RecompiledInfoFunc>(dlsym(library, "Chip8Recompiled"));
+#endif
+
+	if (getInfo == nullptr)
+	{
+		error = std::string(path) + " has no Chip8Recompiled(), not written by tools/recompile";
+		return false;
+	}
+
+	const RecompiledInfo* candidate = getInfo();
+	if (candidate->abi != RECOMPILED_ABI || candidate->stateSize != sizeof(Chip8State) || candidate->random != Chip8Random::ID)
+	{
+		error = std::string(path) + " was built against another Chip8State, recompile it";
+		return false;
+	}
+
+	info = candidate;
+	return true;
+}
+
+bool Recompiled::Compatible(const Chip8& chip8) const
+{
+	return info->quirks.shiftUsesVy == chip8.quirks.shiftUsesVy
+		&& info->quirks.loadStoreMovesI == chip8.quirks.loadStoreMovesI;
+}
+
+void Recompiled::Run(Chip8& chip8, unsigned int count)
+{
+	Chip8State& state = chip8;
+
+	while (count > 0)
+	{
+		unsigned int done = info->run(state, chip8.stats, count);
+		compiled += done;
+		count -= done;
+
+		//whatever stopped the compiled code is the interpreter's, one instruction at a time
+		if (count > 0)
+		{
+			chip8.Cycle();
+			++interpreted;
+			--count;
+		}
+	}
+}
@@ -0,0 +1,132 @@
+#pragma once
+#include "Chip8.h"
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+
+//bumped whenever the generated code's view of Chip8State/Chip8Stats or the helpers below change
+const uint32_t RECOMPILED_ABI = 3;
+
+#ifdef _WIN32
+#define RECOMPILED_EXPORT __declspec(dllexport)
+#else
+#define RECOMPILED_EXPORT __attribute__((visibility("default")))
+#endif
+
+//runs at most budget instructions from s.pc and returns how many it ran; stops early
+//at anything it leaves to the interpreter
+typedef unsigned int (*RecompiledEntry)(Chip8State& s, Chip8Stats& stats, unsigned int budget);
+
+//what a library written by tools/recompile exports, through Chip8Recompiled()
+struct RecompiledInfo
+{
+	uint32_t abi;
+	uint32_t stateSize;		//sizeof(Chip8State) it was built against
+	Quirks quirks;			//baked in when the code was generated
+	uint32_t random;		//Chip8Random::ID it was built with
+	unsigned int blocks;
+	RecompiledEntry run;
+};
+
+typedef const RecompiledInfo* (*RecompiledInfoFunc)();
+
+//A ROM translated ahead of time into C++ (tools/recompile) and loaded from a shared
+//library, run in place of the interpreter.
+//
+//Run(chip8, n) does exactly what n Cycle() calls do. The compiled code runs whole
+//basic blocks; Bnnn, Fx0A and invalid opcodes, addresses it never saw (reached
+//through Bnnn) and the last few instructions of a budget too small for the next
+//block go through Cycle() one at a time. Every block checks on entry that its
+//bytes in memory are still the ROM's, so self-modifying code, another ROM or a
+//LoadState() fall back to the interpreter as well rather than run stale code.
+//
+//Only the untimed Cycle() loop is covered; COSMAC VIP timed frames (RunFrame())
+//stay with the interpreter.
+class Recompiled
+{
+public:
+	Recompiled() = default;
+	~Recompiled();
+
+	Recompiled(const Recompiled&) = delete;
+	Recompiled& operator=(const Recompiled&) = delete;
+
+	//false, with Error() set, when the library is missing or was built for another Chip8State
+	bool Load(const char* path);
+	bool Loaded() const { return info != nullptr; }
+	const RecompiledInfo& Info() const { return *info; }
+	const std::string& Error() const { return error; }
+
+	//the quirks the code was generated for are the machine's
+	bool Compatible(const Chip8& chip8) const;
+	//count instructions, timers ticking after each one like Cycle()
+	void Run(Chip8& chip8, unsigned int count);
+
+	//instructions run by the compiled code and by the interpreter since Load()
+	uint64_t Compiled() const { return compiled; }
+	uint64_t Interpreted() const { return interpreted; }
+
+private:
+	void* library = nullptr;
+	const RecompiledInfo* info = nullptr;
+	std::string error;
+	uint64_t compiled = 0;
+	uint64_t interpreted = 0;
+};
+
+//----------------------------------
+//			Generated code helpers
+//----------------------------------
+
+//the timer ticks of count Cycle() calls at once
+inline void RecompiledTick(Chip8State& s, Chip8Stats& stats, unsigned int count)
+{
+	if (s.delayTimer > 0)
+	{
+		s.delayTimer -= static_cast<uint8_t>(std::min<unsigned int>(count, s.delayTimer));
+		stats.timerUnderflows += s.delayTimer == 0;
+	}
+
+	if (s.soundTimer > 0)
+	{
+		s.soundTimer -= static_cast<uint8_t>(std::min<unsigned int>(count, s.soundTimer));
+		stats.timerUnderflows += s.soundTimer == 0;
+	}
+}
+
+//Dxyn, as Chip8::OP_Dxyn
+inline void RecompiledDraw(Chip8State& s, Chip8Stats& stats, uint8_t x, uint8_t y, unsigned int height)
+{
+	unsigned int xPos = x % VIDEO_WIDTH;
+	unsigned int yPos = y % VIDEO_HEIGHT;
+	unsigned int rows = yPos + height > VIDEO_HEIGHT ? VIDEO_HEIGHT - yPos : height;
+	unsigned int cols = xPos + 8u > VIDEO_WIDTH ? VIDEO_WIDTH - xPos : 8;
+	uint8_t collision = 0;
+	CheckSpan(s, rows);
+
+	for (unsigned int row = 0; row < rows; ++row)
+	{
+		uint8_t spriteByte = s.memory[(s.index + row) & ADDRESS_MASK];
+		uint32_t* screenPixel = &s.video[(yPos + row) * VIDEO_WIDTH + xPos];
+
+		for (unsigned int col = 0; col < cols; ++col)
+		{
+			if (spriteByte & (0x80u >> col))
+			{
+				collision |= screenPixel[col] == 0xFFFFFFFF;
+				screenPixel[col] ^= 0xFFFFFFFF;
+			}
+		}
+	}
+
+	s.registers[0xF] = collision;
+	++stats.draws;
+	stats.collisions += collision;
+}
+
+//next byte of the Cxkk stream
+inline uint8_t RecompiledRandom(Chip8State& s)
+{
+	return Chip8Random::Byte(s.rngKey, s.rngDraws++);
+}
@@ -0,0 +1,335 @@
+#include "Recorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+
+//two palette entries still need the minimum code size GIF allows
+const unsigned int LZW_MIN_CODE_SIZE = 2;
+
+//packs variable width LZW codes LSB first into 255 byte GIF data sub-blocks
+struct GifBlockWriter
+{
+	std::ofstream& file;
+	uint8_t block[255];
+	unsigned int blockSize = 0;
+	uint32_t bitBuffer = 0;
+	unsigned int bitCount = 0;
+
+	explicit GifBlockWriter(std::ofstream& file) : file(file) {}
+
+	void Code(unsigned int code, unsigned int size)
+	{
+		bitBuffer |= code << bitCount;
+		bitCount += size;
+		while (bitCount >= 8)
+		{
+			Byte(bitBuffer & 0xFF);
+			bitBuffer >>= 8;
+			bitCount -= 8;
+		}
+	}
+
+	void Byte(uint8_t byte)
+	{
+		block[blockSize++] = byte;
+		if (blockSize == sizeof(block))
+		{
+			FlushBlock();
+		}
+	}
+
+	void FlushBlock()
+	{
+		if (blockSize > 0)
+		{
+			file.put(static_cast<char>(blockSize));
+			file.write(reinterpret_cast<const char*>(block), blockSize);
+			blockSize = 0;
+		}
+	}
+
+	//last partial byte, last sub-block and the block terminator
+	void Finish()
+	{
+		if (bitCount > 0)
+		{
+			Byte(bitBuffer & 0xFF);
+		}
+		FlushBlock();
+		file.put(0);
+	}
+};
+
+static void Put16(std::ofstream& file, unsigned int value)
+{
+	file.put(static_cast<char>(value & 0xFF));
+	file.put(static_cast<char>((value >> 8) & 0xFF));
+}
+
+static unsigned int Pixel(const uint8_t* bits, unsigned int x, unsigned int y)
+{
+	return (bits[(y * VIDEO_WIDTH + x) / 8] >> (7 - x % 8)) & 1;
+}
+
+
+Recorder::~Recorder()
+{
+	Close();
+}
+
+bool Recorder::Open(const char* path, unsigned int scale)
+{
+	Close();
+
+	file.open(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	this->scale = std::max(1u, scale);
+	hasPending = false;
+	hasPrevious = false;
+	lastTimeMs = 0;
+	dropped = 0;
+	written = 0;
+
+	//header and logical screen: global palette of 2 entries, black and white
+	file.write("GIF89a", 6);
+	Put16(file, VIDEO_WIDTH * this->scale);
+	Put16(file, VIDEO_HEIGHT * this->scale);
+	file.put(static_cast<char>(0x80));
+	file.put(0);
+	file.put(0);
+	const uint8_t palette[6] = { 0x00, 0x00, 0x00, 0xFF, 0xFF, 0xFF };
+	file.write(reinterpret_cast<const char*>(palette), sizeof(palette));
+
+	//NETSCAPE2.0 application extension - loop forever
+	file.write("\x21\xFF\x0B" "NETSCAPE2.0" "\x03\x01\x00\x00\x00", 19);
+
+	stop = false;
+	thread = std::thread(&Recorder::EncoderLoop, this);
+	return true;
+}
+
+bool Recorder::Submit(const uint32_t* video, uint32_t timeMs, bool wait)
+{
+	Frame frame;
+
+	PackVideo(video, frame.bits);
+	frame.timeMs = timeMs;
+
+	while (!queue.Push(frame))
+	{
+		if (wait)
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	return true;
+}
+
+void Recorder::Close()
+{
+	if (!thread.joinable())
+	{
+		return;
+	}
+
+	stop.store(true, std::memory_order_release);
+	thread.join();
+}
+
+void Recorder::EncoderLoop()
+{
+	Frame frame;
+
+	while (true)
+	{
+		//read before popping so nothing submitted ahead of Close() is missed
+		bool closing = stop.load(std::memory_order_acquire);
+
+		if (queue.Pop(frame))
+		{
+			Encode(frame);
+			continue;
+		}
+
+		if (closing)
+		{
+			break;
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+	}
+
+	if (hasPending)
+	{
+		unsigned int delay = lastTimeMs / 10 > pending.timeMs / 10 ? lastTimeMs / 10 - pending.timeMs / 10 : 0;
+		WriteFrame(pending, std::max(delay, MIN_DELAY_CS));
+	}
+
+	file.put(0x3B);
+	file.close();
+}
+
+void Recorder::Encode(const Frame& frame)
+{
+	lastTimeMs = std::max(lastTimeMs, frame.timeMs);
+
+	if (!hasPending)
+	{
+		pending = frame;
+		hasPending = true;
+		return;
+	}
+
+	//unchanged - the pending frame just stays on screen longer
+	if (memcmp(frame.bits, pending.bits, sizeof(frame.bits)) == 0)
+	{
+		return;
+	}
+
+	//centisecond delays taken from the rounded timestamps so they never drift
+	unsigned int delay = frame.timeMs / 10 > pending.timeMs / 10 ? frame.timeMs / 10 - pending.timeMs / 10 : 0;
+	if (delay < MIN_DELAY_CS)
+	{
+		//too short to show - the new contents take over the pending frame's slot
+		uint32_t start = pending.timeMs;
+		pending = frame;
+		pending.timeMs = start;
+		return;
+	}
+
+	WriteFrame(pending, delay);
+	pending = frame;
+}
+
+void Recorder::WriteFrame(const Frame& frame, unsigned int delayCs)
+{
+	//only the rectangle that differs from the last image written
+	unsigned int left = 0;
+	unsigned int top = 0;
+	unsigned int right = VIDEO_WIDTH - 1;
+	unsigned int bottom = VIDEO_HEIGHT - 1;
+
+	if (hasPrevious)
+	{
+		left = VIDEO_WIDTH;
+		top = VIDEO_HEIGHT;
+		right = 0;
+		bottom = 0;
+
+		for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y)
+		{
+			for (unsigned int x = 0; x < VIDEO_WIDTH; x += 8)
+			{
+				uint8_t changed = frame.bits[(y * VIDEO_WIDTH + x) / 8] ^ previous.bits[(y * VIDEO_WIDTH + x) / 8];
+				for (unsigned int bit = 0; changed != 0 && bit < 8; ++bit)
+				{
+					if (changed & (0x80 >> bit))
+					{
+						left = std::min(left, x + bit);
+						right = std::max(right, x + bit);
+						top = std::min(top, y);
+						bottom = std::max(bottom, y);
+					}
+				}
+			}
+		}
+
+		//same image as before (a change that was superseded) - a single unchanged pixel carries the delay
+		if (left == VIDEO_WIDTH)
+		{
+			left = right = top = bottom = 0;
+		}
+	}
+
+	//graphic control extension: leave the previous image in place, delay in centiseconds
+	file.put(0x21);
+	file.put(static_cast<char>(0xF9));
+	file.put(4);
+	file.put(1 << 2);
+	Put16(file, std::min(delayCs, 0xFFFFu));
+	file.put(0);
+	file.put(0);
+
+	//image descriptor, no local palette
+	file.put(0x2C);
+	Put16(file, left * scale);
+	Put16(file, top * scale);
+	Put16(file, (right - left + 1) * scale);
+	Put16(file, (bottom - top + 1) * scale);
+	file.put(0);
+
+	WriteImageData(frame, left, top, right - left + 1, bottom - top + 1);
+
+	previous = frame;
+	hasPrevious = true;
+	written.fetch_add(1, std::memory_order_relaxed);
+}
+
+//LZW compress the scaled rectangle (display coordinates) of frame
+void Recorder::WriteImageData(const Frame& frame, unsigned int left, unsigned int top, unsigned int width, unsigned int height)
+{
+	const unsigned int clearCode = 1u << LZW_MIN_CODE_SIZE;
+	const unsigned int endCode = clearCode + 1;
+
+	memset(lzwDictionary, 0, sizeof(lzwDictionary));
+
+	unsigned int codeSize = LZW_MIN_CODE_SIZE + 1;
+	unsigned int lastCode = endCode;
+	int prefix = -1;
+
+	file.put(LZW_MIN_CODE_SIZE);
+	GifBlockWriter writer(file);
+	writer.Code(clearCode, codeSize);
+
+	for (unsigned int y = 0; y < height * scale; ++y)
+	{
+		for (unsigned int x = 0; x < width * scale; ++x)
+		{
+			unsigned int pixel = Pixel(frame.bits, left + x / scale, top + y / scale);
+
+			if (prefix < 0)
+			{
+				prefix = pixel;
+				continue;
+			}
+
+			if (lzwDictionary[prefix][pixel] != 0)
+			{
+				prefix = lzwDictionary[prefix][pixel];
+				continue;
+			}
+
+			writer.Code(prefix, codeSize);
+			lzwDictionary[prefix][pixel] = static_cast<uint16_t>(++lastCode);
+			if (lastCode >= (1u << codeSize))
+			{
+				++codeSize;
+			}
+
+			//table full - start again
+			if (lastCode == LZW_MAX_CODES - 1)
+			{
+				writer.Code(clearCode, codeSize);
+				memset(lzwDictionary, 0, sizeof(lzwDictionary));
+				codeSize = LZW_MIN_CODE_SIZE + 1;
+				lastCode = endCode;
+			}
+
+			prefix = pixel;
+		}
+	}
+
+	writer.Code(prefix, codeSize);
+	writer.Code(endCode, codeSize);
+	writer.Finish();
+}
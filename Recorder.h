@@ -0,0 +1,72 @@
+#pragma once
+#include "Chip8.h"
+#include "FrameCodec.h"
+#include "RingBuffer.h"
+
+#include <atomic>
+#include <fstream>
+#include <thread>
+
+//Gameplay recorder writing an animated GIF on a background encoder thread.
+//
+//Submit() packs the video buffer to 1 bit per pixel and pushes it onto a lock-free
+//queue; it never blocks, so when the encoder falls behind the frame is dropped and
+//counted instead. The encoder uses a two colour palette, writes only the rectangle
+//that changed since the previous image, and folds identical frames into the delay
+//of the one before. Nothing here touches SDL, so headless runs can record too.
+class Recorder
+{
+public:
+	Recorder() = default;
+	~Recorder();
+
+	//scale multiplies the 64x32 display in the output image
+	bool Open(const char* path, unsigned int scale = 4);
+	//emulation thread: timeMs is the frame's presentation time since recording started
+	//returns false when the queue was full and the frame was dropped; with wait set
+	//(offline runs) it yields until the encoder has room instead
+	bool Submit(const uint32_t* video, uint32_t timeMs, bool wait = false);
+	//drains the queue, writes the last frame and closes the file
+	void Close();
+
+	bool IsOpen() const { return thread.joinable(); }
+	unsigned long Dropped() const { return dropped.load(std::memory_order_relaxed); }
+	//images written to the file, after identical frames were merged
+	unsigned long Written() const { return written.load(std::memory_order_relaxed); }
+
+private:
+	struct Frame
+	{
+		uint8_t bits[FRAME_BYTES];
+		uint32_t timeMs;
+	};
+
+	static const size_t QUEUE_FRAMES = 64;
+	//GIF LZW codes are at most 12 bits
+	static const unsigned int LZW_MAX_CODES = 4096;
+	//GIF viewers stretch anything shorter than 2 centiseconds, so faster changes are
+	//superseded by the next frame instead of being written
+	static const unsigned int MIN_DELAY_CS = 2;
+
+	RingBuffer<Frame, QUEUE_FRAMES> queue;
+	std::thread thread;
+	std::atomic<bool> stop{ false };
+	std::atomic<unsigned long> dropped{ 0 };
+	std::atomic<unsigned long> written{ 0 };
+
+	//encoder thread only
+	std::ofstream file;
+	unsigned int scale = 4;
+	Frame pending{};		//newest distinct frame, written once its delay is known
+	Frame previous{};		//last frame written to the file
+	bool hasPending = false;
+	bool hasPrevious = false;
+	uint32_t lastTimeMs = 0;
+	//child code for each (code, pixel) pair, 0 when absent - only palette indices 0 and 1 occur
+	uint16_t lzwDictionary[LZW_MAX_CODES][2];
+
+	void EncoderLoop();
+	void Encode(const Frame& frame);
+	void WriteFrame(const Frame& frame, unsigned int delayCs);
+	void WriteImageData(const Frame& frame, unsigned int left, unsigned int top, unsigned int width, unsigned int height);
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+
+//Bounded single producer / single consumer queue.
+//Push and Pop never block, lock or allocate. Push fails when the queue is full so
+//the producer can count the drop and carry on instead of waiting for the consumer.
+template <typename T, size_t Capacity>
+class RingBuffer
+{
+	static_assert(Capacity != 0 && (Capacity & (Capacity - 1)) == 0, "capacity must be a power of two");
+
+public:
+	//producer thread only
+	bool Push(const T& item)
+	{
+		size_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) == Capacity)
+		{
+			return false;
+		}
+
+		items[h & (Capacity - 1)] = item;
+		head.store(h + 1, std::memory_order_release);
+		return true;
+	}
+
+	//consumer thread only
+	bool Pop(T& item)
+	{
+		size_t t = tail.load(std::memory_order_relaxed);
+		if (t == head.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		item = items[t & (Capacity - 1)];
+		tail.store(t + 1, std::memory_order_release);
+		return true;
+	}
+
+	size_t Size() const
+	{
+		return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+	}
+
+private:
+	T items[Capacity];
+	//separate cache lines so producer and consumer do not share one
+	alignas(64) std::atomic<size_t> head{ 0 };
+	alignas(64) std::atomic<size_t> tail{ 0 };
+};
@@ -0,0 +1,28 @@
+#include "RunAhead.h"
+
+
+const uint32_t* RunAhead::Speculate(const Chip8& chip8, unsigned int instructionsPerFrame)
+{
+	if (frames == 0)
+	{
+		return chip8.video;
+	}
+
+	shadow = chip8;
+
+	if (timed)
+	{
+		for (unsigned int frame = 0; frame < frames; ++frame)
+		{
+			shadow.RunFrame();
+		}
+		return shadow.video;
+	}
+
+	for (unsigned long i = 0, count = static_cast<unsigned long>(frames) * instructionsPerFrame; i < count; ++i)
+	{
+		shadow.Cycle();
+	}
+
+	return shadow.video;
+}
@@ -0,0 +1,30 @@
+#pragma once
+#include "Chip8.h"
+
+//Run-ahead input lag reduction.
+//
+//The real machine advances normally. When a frame is presented, its state is
+//copied into a shadow machine (a plain copy of the contiguous state, no
+//allocation) which runs frames more frames with the keypad as it is now; the
+//shadow's display is shown instead. Anything the game would react to within
+//that many frames appears immediately. Cxkk stays in step because the RNG state
+//is part of the copy.
+class RunAhead
+{
+public:
+	explicit RunAhead(unsigned int frames) : frames(frames) {}
+
+	unsigned int Frames() const { return frames; }
+	void SetFrames(unsigned int value) { frames = value; }
+	//speculate with Chip8::RunFrame() (VIP timing) instead of counted instructions
+	void SetTimed(bool value) { timed = value; }
+
+	//display of chip8 frames * instructionsPerFrame instructions from now, or frames
+	//timed frames from now
+	const uint32_t* Speculate(const Chip8& chip8, unsigned int instructionsPerFrame);
+
+private:
+	unsigned int frames;
+	bool timed = false;
+	Chip8 shadow;
+};
@@ -52,7 +52,8 @@ void SDL_Layer::Filter(const void* buffer, int pitch, int winWidth, int winHeigh
 		for (int topLeftY = 0; topLeftY < winHeight; topLeftY += 4)
 		{
 			SDL_SetRenderDrawColor(renderer, 0, 0, 0, 255);
-			SDL_RenderFillRect(renderer, &Lines(0, topLeftY, winWidth, 2));
+			SDL_Rect line = Lines(0, topLeftY, winWidth, 2);
+			SDL_RenderFillRect(renderer, &line);
 		}
 		SDL_RenderPresent(renderer);
 	}break;
@@ -71,6 +72,29 @@ void SDL_Layer::Update(const void* buffer, int pitch, int winWidth, int winHeigh
 	SDL_RenderPresent(renderer);
 }
 
+void SDL_Layer::Update(const void* buffer, int pitch, const SDL_Rect& region)
+{
+	SDL_UpdateTexture(texture, &region, buffer, pitch);
+	SDL_SetTextureColorMod(texture, red, green, blue);
+	SDL_RenderCopy(renderer, texture, nullptr, nullptr);
+	SDL_RenderPresent(renderer);
+}
+
+void SDL_Layer::WaitInput(int timeoutMs)
+{
+	SDL_WaitEventTimeout(nullptr, timeoutMs);
+}
+
+void SDL_Layer::GetWindowSize(int& width, int& height)
+{
+	SDL_GetWindowSize(window, &width, &height);
+}
+
+void SDL_Layer::SetTitle(const char* title)
+{
+	SDL_SetWindowTitle(window, title);
+}
+
 bool SDL_Layer::ProcessInput(bool* keys, float* pGameSpeed)
 {
 	bool quit = false;
@@ -81,6 +105,11 @@ bool SDL_Layer::ProcessInput(bool* keys, float* pGameSpeed)
 	//process each event in turn
 	while (SDL_PollEvent(&event))
 	{
+		if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP)
+		{
+			++inputEvents;
+		}
+
 		//handle each event type separately
 		switch (event.type)
 		{
@@ -182,30 +211,19 @@ bool SDL_Layer::ProcessInput(bool* keys, float* pGameSpeed)
 			//slow down
 			case SDLK_EQUALS:
 			{
-				if (*pGameSpeed == 0.25)
-				{
-					*pGameSpeed = 0;
-				}
-				else
-				{
-					*pGameSpeed /= 2;
-				}
+				HalveDelay(pGameSpeed);
 			} break;
 
 			//fast forward
 			case SDLK_MINUS:
 			{
-				if (*pGameSpeed == 0)
-				{
-					*pGameSpeed = 0.25;
-				}
-				else
-				{
-					*pGameSpeed *= 2;
-				}
-				//set minimum speed
-				*pGameSpeed = *pGameSpeed > 32 ? 32 : *pGameSpeed;
+				DoubleDelay(pGameSpeed);
 			} break;
+			//turbo on/off - the key left of 1
+			case SDLK_BACKQUOTE:
+			{
+				turbo = !turbo;
+			}break;
 			case SDLK_TAB:
 			{
 				if (filterNum == 1)
@@ -264,6 +282,13 @@ bool SDL_Layer::ProcessInput(bool* keys, float* pGameSpeed)
 			}
 		} break;
 
+		case SDL_MOUSEBUTTONDOWN:
+		{
+			clicked = true;
+			clickX = event.button.x;
+			clickY = event.button.y;
+		} break;
+
 		case SDL_KEYUP:
 		{
 			switch (event.key.keysym.sym)
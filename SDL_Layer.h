@@ -1,19 +1,25 @@
 #pragma once
+#include "Frontend.h"
 #include <SDL.h>
 
 class SDL_Window;
 class SDL_Renderer;
 class SDL_Texture;
 
-class SDL_Layer
+class SDL_Layer : public Frontend
 {
 public:
 	SDL_Layer(const char* title, int winWidth, int winHeight, int textureWidth, int textureHeight);
 	~SDL_Layer();
-	void Update(const void* buffer, int pitch, int winWidth, int winHeight);
+	void Update(const void* buffer, int pitch, int winWidth, int winHeight) override;
+	//upload only region of the texture - buffer points at the region's top left pixel
+	void Update(const void* buffer, int pitch, const SDL_Rect& region);
 	SDL_Rect Lines(int topLeftX, int topLeftY, int rectWidth, int rectHeight);
-	void Filter(const void* buffer, int pitch, int winWidth, int winHeight);
-	bool ProcessInput(bool* keys, float* pGameSpeed);
+	void Filter(const void* buffer, int pitch, int winWidth, int winHeight) override;
+	bool ProcessInput(bool* keys, float* pGameSpeed) override;
+	void WaitInput(int timeoutMs) override;
+	void GetWindowSize(int& width, int& height);
+	void SetTitle(const char* title) override;
 
 	uint8_t red{ 255 };
 	uint8_t green{ 255 };
@@ -21,7 +27,11 @@ public:
 
 	int filterNum = 0;
 	int colourNum = 0;
-	bool flag = true;
+
+	//last mouse click in window coordinates, cleared by whoever handles it
+	bool clicked = false;
+	int clickX = 0;
+	int clickY = 0;
 
 private:
 	SDL_Window * window{};
@@ -0,0 +1,219 @@
+#pragma once
+//Minimal socket helpers shared by the network front ends (loopback only)
+
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#pragma comment(lib, "Ws2_32.lib")
+typedef int socklen_t;
+#define poll WSAPoll
+#else
+#include <arpa/inet.h>
+#include <cerrno>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+#include <cstring>
+
+inline void SocketStartup()
+{
+#ifdef _WIN32
+	static bool started = false;
+	if (!started)
+	{
+		WSADATA data;
+		WSAStartup(MAKEWORD(2, 2), &data);
+		started = true;
+	}
+#endif
+}
+
+inline void CloseSocket(int fd)
+{
+	if (fd < 0)
+	{
+		return;
+	}
+#ifdef _WIN32
+	closesocket(fd);
+#else
+	close(fd);
+#endif
+}
+
+inline void SetNonBlocking(int fd)
+{
+#ifdef _WIN32
+	u_long mode = 1;
+	ioctlsocket(fd, FIONBIO, &mode);
+#else
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+#endif
+}
+
+//send without raising SIGPIPE when the peer has gone away
+inline int SendBytes(int fd, const void* data, size_t length)
+{
+#ifdef MSG_NOSIGNAL
+	return static_cast<int>(send(fd, static_cast<const char*>(data), length, MSG_NOSIGNAL));
+#else
+	return static_cast<int>(send(fd, static_cast<const char*>(data), static_cast<int>(length), 0));
+#endif
+}
+
+//one datagram to 127.0.0.1:port
+inline int SendDatagram(int fd, unsigned short port, const void* data, size_t length)
+{
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	return static_cast<int>(sendto(fd, static_cast<const char*>(data), static_cast<int>(length), 0,
+		reinterpret_cast<const sockaddr*>(&address), sizeof(address)));
+}
+
+//a non-blocking send or recv found nothing to do
+inline bool WouldBlock()
+{
+#ifdef _WIN32
+	return WSAGetLastError() == WSAEWOULDBLOCK;
+#else
+	return errno == EAGAIN || errno == EWOULDBLOCK;
+#endif
+}
+
+//stream socket listening on 127.0.0.1:port (or a datagram socket bound to it), -1 on failure
+inline int ListenTcpSocket(unsigned short port, int type = SOCK_STREAM)
+{
+	SocketStartup();
+
+	int fd = static_cast<int>(socket(AF_INET, type, 0));
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	int reuse = 1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<const char*>(&reuse), sizeof(reuse));
+
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+		|| (type == SOCK_STREAM && listen(fd, 8) != 0))
+	{
+		CloseSocket(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+//stream socket listening on a Unix domain socket path, -1 with errno set on failure
+//(EEXIST when something other than a socket is at the path), always -1 on Windows
+inline int ListenUnixSocket(const char* path)
+{
+#ifdef _WIN32
+	(void)path;
+	return -1;
+#else
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if (strlen(path) >= sizeof(address.sun_path))
+	{
+		CloseSocket(fd);
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+	//a socket left by an earlier run is replaced, anything else at the path is not ours to delete
+	struct stat existing;
+	if (lstat(path, &existing) == 0)
+	{
+		if (!S_ISSOCK(existing.st_mode))
+		{
+			CloseSocket(fd);
+			errno = EEXIST;
+			return -1;
+		}
+		unlink(path);
+	}
+
+	if (bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 || listen(fd, 8) != 0)
+	{
+		CloseSocket(fd);
+		return -1;
+	}
+
+	return fd;
+#endif
+}
+
+//stream socket connected to 127.0.0.1:port, -1 on failure
+inline int ConnectTcpSocket(unsigned short port)
+{
+	SocketStartup();
+
+	int fd = static_cast<int>(socket(AF_INET, SOCK_STREAM, 0));
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	sockaddr_in address{};
+	address.sin_family = AF_INET;
+	address.sin_port = htons(port);
+	address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		CloseSocket(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+//stream socket connected to a Unix domain socket path, -1 on failure or on Windows
+inline int ConnectUnixSocket(const char* path)
+{
+#ifdef _WIN32
+	(void)path;
+	return -1;
+#else
+	int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (fd < 0)
+	{
+		return -1;
+	}
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+
+	if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		CloseSocket(fd);
+		return -1;
+	}
+
+	return fd;
+#endif
+}
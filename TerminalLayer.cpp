@@ -0,0 +1,386 @@
+#include "TerminalLayer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
+#include <conio.h>
+#include <windows.h>
+#else
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+
+//a cell code no frame produces - the first Update() draws every cell
+const uint16_t NO_CELL = 0xFFFF;
+//how long the rest of an escape sequence may trail its ESC before the ESC counts as a key
+const unsigned int ESCAPE_WAIT_MS = 100;
+
+//key n of the keypad is KEYPAD[n], the same layout as SDL_Layer
+static const char KEYPAD[] = "x123qweasdzc4rfv";
+
+//braille dot bits by row and column within a 2x4 cell (U+2800 + bits)
+static const uint8_t BRAILLE_DOTS[4][2] = { { 0x01, 0x08 }, { 0x02, 0x10 }, { 0x04, 0x20 }, { 0x40, 0x80 } };
+
+//----------------------------------
+//			Platform input
+//----------------------------------
+
+#ifdef _WIN32
+static DWORD savedOutputMode;
+static UINT savedCodePage;
+
+//_getch() is already unbuffered and unechoed; output needs VT sequences and UTF-8
+static bool RawMode()
+{
+	HANDLE output = GetStdHandle(STD_OUTPUT_HANDLE);
+	if (!GetConsoleMode(output, &savedOutputMode)
+		|| !SetConsoleMode(output, savedOutputMode | ENABLE_VIRTUAL_TERMINAL_PROCESSING))
+	{
+		return false;
+	}
+	savedCodePage = GetConsoleOutputCP();
+	SetConsoleOutputCP(CP_UTF8);
+	return true;
+}
+
+static void RestoreMode()
+{
+	SetConsoleMode(GetStdHandle(STD_OUTPUT_HANDLE), savedOutputMode);
+	SetConsoleOutputCP(savedCodePage);
+}
+
+static size_t ReadInput(char* data, size_t size)
+{
+	size_t count = 0;
+	while (count < size && _kbhit())
+	{
+		int c = _getch();
+		//arrow and function keys come as a 0 or 0xE0 prefix and a scan code
+		if (c == 0 || c == 0xE0)
+		{
+			_getch();
+			continue;
+		}
+		data[count++] = static_cast<char>(c);
+	}
+	return count;
+}
+
+//woken by any console event, not only keys - ProcessInput() finds nothing and the loop waits again
+static void WaitReadable(int timeoutMs)
+{
+	WaitForSingleObject(GetStdHandle(STD_INPUT_HANDLE), static_cast<DWORD>(timeoutMs));
+}
+#else
+static termios savedMode;
+
+//no line buffering, echo or signal keys, and read() returns at once with whatever is there
+static bool RawMode()
+{
+	if (tcgetattr(STDIN_FILENO, &savedMode) != 0)
+	{
+		return false;
+	}
+
+	termios raw = savedMode;
+	raw.c_lflag &= ~(ICANON | ECHO | ISIG | IEXTEN);
+	raw.c_iflag &= ~(IXON | ICRNL);
+	raw.c_cc[VMIN] = 0;
+	raw.c_cc[VTIME] = 0;
+	return tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+}
+
+static void RestoreMode()
+{
+	tcsetattr(STDIN_FILENO, TCSANOW, &savedMode);
+}
+
+static size_t ReadInput(char* data, size_t size)
+{
+	ssize_t count = read(STDIN_FILENO, data, size);
+	return count > 0 ? static_cast<size_t>(count) : 0;
+}
+
+static void WaitReadable(int timeoutMs)
+{
+	pollfd input{};
+	input.fd = STDIN_FILENO;
+	input.events = POLLIN;
+	poll(&input, 1, timeoutMs);
+}
+#endif
+
+//----------------------------------
+//			TerminalLayer
+//----------------------------------
+
+TerminalLayer::TerminalLayer(int textureWidth, int textureHeight, TerminalCells cells)
+	: width(textureWidth), height(textureHeight), cells(cells)
+{
+	columns = cells == TerminalCells::Braille ? (width + 1) / 2 : width;
+	rows = cells == TerminalCells::Braille ? (height + 3) / 4 : (height + 1) / 2;
+	shown.assign(static_cast<size_t>(columns) * rows, NO_CELL);
+
+	if (!RawMode())
+	{
+		std::cerr << "the terminal frontend needs a terminal on stdin" << std::endl;
+		flag = false;
+		return;
+	}
+
+	//alternate screen, cursor hidden, cleared
+	Write("\x1b[?1049h\x1b[?25l\x1b[2J");
+}
+
+TerminalLayer::~TerminalLayer()
+{
+	if (flag)
+	{
+		Write("\x1b[?25h\x1b[?1049l");
+		RestoreMode();
+	}
+}
+
+uint16_t TerminalLayer::Cell(const uint8_t* pixels, int pitch, int column, int row) const
+{
+	auto lit = [&](int x, int y) -> unsigned int
+	{
+		if (x >= width || y >= height)
+		{
+			return 0;
+		}
+		uint32_t pixel;
+		memcpy(&pixel, pixels + y * pitch + x * sizeof(pixel), sizeof(pixel));
+		return (pixel >> 24) >= 0x80;
+	};
+
+	if (cells == TerminalCells::HalfBlock)
+	{
+		return static_cast<uint16_t>(lit(column, row * 2) | lit(column, row * 2 + 1) << 1);
+	}
+
+	uint16_t code = 0;
+	for (int y = 0; y < 4; ++y)
+	{
+		for (int x = 0; x < 2; ++x)
+		{
+			code |= lit(column * 2 + x, row * 4 + y) ? BRAILLE_DOTS[y][x] : 0;
+		}
+	}
+	return code;
+}
+
+void TerminalLayer::AppendGlyph(std::string& text, uint16_t code) const
+{
+	//a dark cell is a plain space in either mode - one byte rather than three
+	if (code == 0)
+	{
+		text += ' ';
+	}
+	else if (cells == TerminalCells::HalfBlock)
+	{
+		//upper half, lower half, full block
+		static const char* const blocks[] = { "\xE2\x96\x80", "\xE2\x96\x84", "\xE2\x96\x88" };
+		text += blocks[code - 1];
+	}
+	else
+	{
+		text += '\xE2';
+		text += static_cast<char>(0xA0 | code >> 6);
+		text += static_cast<char>(0x80 | (code & 0x3F));
+	}
+}
+
+void TerminalLayer::Update(const void* buffer, int pitch, int /*winWidth*/, int /*winHeight*/)
+{
+	const uint8_t* pixels = static_cast<const uint8_t*>(buffer);
+	int cursorRow = -1;
+	int cursorColumn = -1;
+	out.clear();
+
+	for (int row = 0; row < rows; ++row)
+	{
+		for (int column = 0; column < columns; ++column)
+		{
+			uint16_t code = Cell(pixels, pitch, column, row);
+			uint16_t& current = shown[row * columns + column];
+			if (code == current)
+			{
+				continue;
+			}
+			current = code;
+
+			//printing a glyph moves the cursor on, so a run of changed cells needs one
+			//position sequence; a short gap in a row is cheaper to print over again
+			if (row != cursorRow || column != cursorColumn)
+			{
+				std::string position = "\x1b[" + std::to_string(row + 1) + ';' + std::to_string(column + 1) + 'H';
+				std::string gap;
+				for (int skipped = cursorColumn; row == cursorRow && skipped < column && gap.size() < position.size(); ++skipped)
+				{
+					AppendGlyph(gap, shown[row * columns + skipped]);
+				}
+				out += row == cursorRow && gap.size() < position.size() ? gap : position;
+			}
+			AppendGlyph(out, code);
+			cursorRow = row;
+			cursorColumn = column + 1;
+		}
+	}
+
+	if (!out.empty())
+	{
+		Write(out);
+	}
+}
+
+bool TerminalLayer::ProcessInput(bool* keys, float* pGameSpeed)
+{
+	bool quit = false;
+	auto now = std::chrono::steady_clock::now();
+
+	//an escape sequence cut off at the end of the last read comes first
+	bool carried = !escape.empty();
+	std::string input = escape;
+	escape.clear();
+	char chunk[64];
+	size_t count;
+	while ((count = ReadInput(chunk, sizeof(chunk))) > 0)
+	{
+		input.append(chunk, count);
+	}
+
+	for (size_t i = 0; i < input.size(); ++i)
+	{
+		char c = input[i];
+
+		//a lone ESC quits; arrow and function keys arrive as ESC [ ... or ESC O ...
+		//and are skipped up to their final byte. Over SSH either can be split across
+		//reads, so an unfinished one is kept for the next call, and only once nothing
+		//has followed it for ESCAPE_WAIT_MS is it a real ESC (or a broken sequence, dropped)
+		if (c == '\x1b')
+		{
+			bool sequence = i + 1 < input.size() && (input[i + 1] == '[' || input[i + 1] == 'O');
+			size_t end = i + 1;
+			if (sequence)
+			{
+				for (end = i + 2; end < input.size() && (input[end] < 0x40 || input[end] > 0x7E); ++end)
+				{
+				}
+			}
+
+			if (end == input.size())
+			{
+				bool stale = carried && i == 0;
+				if (stale && now - escapeStart >= std::chrono::milliseconds(ESCAPE_WAIT_MS))
+				{
+					quit = !sequence;
+				}
+				else
+				{
+					escapeStart = stale ? escapeStart : now;
+					escape = input.substr(i);
+				}
+				break;
+			}
+			if (sequence)
+			{
+				i = end;
+			}
+			continue;
+		}
+
+		switch (c)
+		{
+		//Ctrl-C, which raw mode delivers as a byte rather than a signal
+		case '\x03':
+		{
+			quit = true;
+		} break;
+
+		case '=':
+		{
+			HalveDelay(pGameSpeed);
+		} break;
+
+		case '-':
+		{
+			DoubleDelay(pGameSpeed);
+		} break;
+
+		case '`':
+		{
+			turbo = !turbo;
+		} break;
+
+		default:
+		{
+			const char* key = c != 0 ? strchr(KEYPAD, tolower(static_cast<unsigned char>(c))) : nullptr;
+			if (key != nullptr)
+			{
+				size_t index = key - KEYPAD;
+				if (!held[index])
+				{
+					keys[index] = 1;
+					held[index] = true;
+					++inputEvents;
+				}
+				pressed[index] = now;
+			}
+		} break;
+		}
+	}
+
+	for (unsigned int key = 0; key < KEY_COUNT; ++key)
+	{
+		if (held[key] && now - pressed[key] >= std::chrono::milliseconds(KEY_HOLD_MS))
+		{
+			keys[key] = 0;
+			held[key] = false;
+			++inputEvents;
+		}
+	}
+
+	return quit;
+}
+
+void TerminalLayer::WaitInput(int timeoutMs)
+{
+	//wake for the next key release, or to decide an ESC still waiting for its sequence
+	auto now = std::chrono::steady_clock::now();
+	if (!escape.empty())
+	{
+		auto decided = escapeStart + std::chrono::milliseconds(ESCAPE_WAIT_MS);
+		int decidedMs = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(decided - now).count());
+		timeoutMs = std::min(timeoutMs, std::max(decidedMs, 0));
+	}
+	for (unsigned int key = 0; key < KEY_COUNT; ++key)
+	{
+		if (held[key])
+		{
+			auto release = pressed[key] + std::chrono::milliseconds(KEY_HOLD_MS);
+			int releaseMs = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(release - now).count());
+			timeoutMs = std::min(timeoutMs, std::max(releaseMs, 0));
+		}
+	}
+
+	WaitReadable(timeoutMs);
+}
+
+void TerminalLayer::SetTitle(const char* title)
+{
+	Write(std::string("\x1b]0;") + title + '\x07');
+}
+
+void TerminalLayer::Write(const std::string& text)
+{
+	fwrite(text.data(), 1, text.size(), stdout);
+	fflush(stdout);
+	written += text.size();
+}
@@ -0,0 +1,71 @@
+#pragma once
+#include "Chip8.h"
+#include "Frontend.h"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+//a terminal key counts as held this long after its last press or auto-repeat
+const unsigned int KEY_HOLD_MS = 150;
+
+//how pixels map onto character cells
+enum class TerminalCells
+{
+	HalfBlock,	//1x2 pixels per cell (upper/lower half block): 64x16 cells
+	Braille		//2x4 pixels per cell (braille dots): 32x8 cells
+};
+
+//Frontend for a text terminal, e.g. an SSH session with no display to open a
+//window on.
+//
+//Each frame is turned into one code per cell and compared with the codes already on
+//the terminal; only cells that changed are sent, with a cursor position sequence
+//only where a run of them breaks, so a still screen costs nothing and a moving
+//sprite a few dozen bytes. A pixel is lit from half brightness up, so blended
+//frames show too. It draws on the alternate screen, with stdin in raw mode for the
+//keypad (same keys as SDL_Layer, ESC or Ctrl-C to quit), and puts both back on
+//destruction. Terminals send no key releases, so a key is released KEY_HOLD_MS
+//after its last press; holding it down relies on auto-repeat, which most terminals
+//only start a few hundred ms in.
+class TerminalLayer : public Frontend
+{
+public:
+	TerminalLayer(int textureWidth, int textureHeight, TerminalCells cells);
+	~TerminalLayer();
+
+	TerminalLayer(const TerminalLayer&) = delete;
+	TerminalLayer& operator=(const TerminalLayer&) = delete;
+
+	void Update(const void* buffer, int pitch, int winWidth, int winHeight) override;
+	bool ProcessInput(bool* keys, float* pGameSpeed) override;
+	void WaitInput(int timeoutMs) override;
+	//the terminal's window title, through an OSC sequence
+	void SetTitle(const char* title) override;
+
+	//bytes sent to the terminal since construction
+	unsigned long long BytesWritten() const { return written; }
+
+private:
+	uint16_t Cell(const uint8_t* pixels, int pitch, int column, int row) const;
+	void AppendGlyph(std::string& out, uint16_t code) const;
+	void Write(const std::string& text);
+
+	int width;
+	int height;
+	TerminalCells cells;
+	int columns;
+	int rows;
+	//codes on the terminal now; NO_CELL until the first frame draws every cell
+	std::vector<uint16_t> shown;
+	std::string out;
+	unsigned long long written = 0;
+
+	//an escape sequence whose end has not arrived yet, and when its ESC did
+	std::string escape;
+	std::chrono::steady_clock::time_point escapeStart;
+
+	//keys this layer pressed, and when they were last pressed or repeated
+	bool held[KEY_COUNT] = {};
+	std::chrono::steady_clock::time_point pressed[KEY_COUNT];
+};
@@ -0,0 +1,52 @@
+#pragma once
+#include "defines.h"
+
+#include <cstdint>
+
+//COSMAC VIP timing model, used by Chip8::RunFrame().
+//
+//Costs are in 1802 machine cycles (8 clocks at 1.7609 MHz, about 4.54 us) and are
+//approximations of the interpreter's measured instruction times, not a trace of
+//the original code: skips cost the same taken or not, and the display DMA that
+//steals cycles during the visible part of each frame is folded into the figures.
+//Everything here is constexpr so the untimed Cycle() path never touches it.
+
+//1.7609 MHz / 8 / 60 Hz
+const uint64_t VIP_CYCLES_PER_FRAME = 3668;
+
+//fixed cost by first nibble; 0x8 and 0xF are refined below
+constexpr uint16_t VIP_CYCLES[0xF + 1] =
+{
+	24,		//0nnn - 00E0 CLS / 00EE RET
+	23,		//1nnn JP
+	23,		//2nnn CALL
+	12,		//3xkk SE
+	12,		//4xkk SNE
+	16,		//5xy0 SE
+	6,		//6xkk LD
+	10,		//7xkk ADD
+	44,		//8xyN ALU
+	16,		//9xy0 SNE
+	12,		//Annn LD I
+	24,		//Bnnn JP V0
+	36,		//Cxkk RND
+	26,		//Dxyn DRW, plus VIP_CYCLES_PER_ROW per row
+	16,		//ExNN SKP/SKNP
+	10		//FxNN, see VipCycles()
+};
+
+const uint16_t VIP_CYCLES_PER_ROW = 17;
+const uint16_t VIP_CYCLES_PER_REGISTER = 8;
+
+constexpr uint32_t VipCycles(uint16_t opcode)
+{
+	return I(opcode) == 0xD ? VIP_CYCLES[0xD] + VIP_CYCLES_PER_ROW * (opcode & 0xFu)
+		: I(opcode) != 0xF ? VIP_CYCLES[I(opcode)]
+		: KK(opcode) == 0x1E ? 19
+		: KK(opcode) == 0x29 ? 20
+		: KK(opcode) == 0x33 ? 204
+		: KK(opcode) == 0x55 || KK(opcode) == 0x65 ? VIP_CYCLES[0xF] + VIP_CYCLES_PER_REGISTER * (X(opcode) + 1)
+		: VIP_CYCLES[0xF];
+}
+
+static_assert(VipCycles(0x6000) == 6, "timing table is compile-time data");
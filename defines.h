@@ -5,6 +5,15 @@
 
 #define CLOCKCOUNT std::chrono::system_clock::now().time_since_epoch().count()
 
+//opcode handlers print their own name only in trace builds (define CHIP8_TRACE)
+//use the debugger for anything more than a raw trace
+#ifdef CHIP8_TRACE
+#include <iostream>
+#define TRACE_OP() std::cout << __FUNCTION__ << std::endl
+#else
+#define TRACE_OP()
+#endif
+
 
 //opcode AND 111111111111 (0x0FFF) gives you the last 3 nibbles (i.e 12-bit address)
 //e.g. 0x3dfe & 0x0FFF = 0xdfe
@@ -1,17 +1,38 @@
-#include "chip8.h"
+#include "Chip8.h"
+#include "Debugger.h"
+#include "FrameBlender.h"
+#include "GdbStub.h"
+#include "Metrics.h"
+#include "Netplay.h"
+#include "Recorder.h"
+#include "RunAhead.h"
+#include "TerminalLayer.h"
+//with CHIP8_NO_SDL the terminal is the only frontend
+#ifndef CHIP8_NO_SDL
 #include "SDL_Layer.h"
 #include <SDL.h>
+#endif
 
 #include <time.h>
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <cstring>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <iomanip>
 #include <ctime>
 #include <memory>
+#include <mutex>
 
 
+//longest the loop sleeps with nothing due, so it still notices a quit promptly
+const int IDLE_WAIT_MS = 250;
+//turbo checks the clock after about this many instructions
+const unsigned int TURBO_CHECK_INSTRUCTIONS = 4096;
+const char* const WINDOW_TITLE = "CHIP-8 Interpreter";
+
 int main(int argc, char** argv)
 {
 	//display buffer is 64x32, we need to scale it
@@ -19,48 +40,493 @@ int main(int argc, char** argv)
 	//delay between cycles
 	float cycleDelay = 2;
 
-	std::unique_ptr<SDL_Layer> interpreter = std::make_unique<SDL_Layer>("CHIP-8 Interpreter", VIDEO_WIDTH * resScale, VIDEO_HEIGHT * resScale, VIDEO_WIDTH, VIDEO_HEIGHT);
+	//optional flags after the ROM path
+	//--debug			start stopped in the terminal debugger
+	//--gdb <port|path>	GDB remote stub on 127.0.0.1:port or a Unix domain socket path
+	//--record <file.gif>	record the display at 60 frames per second
+	//--runahead <frames>	show the display that many frames ahead of the machine
+	//--persist <frames>	anti-flicker: pixels stay lit for that many frames
+	//--phosphor <percent>	anti-flicker: pixels fade, keeping percent brightness per frame
+	//--timing <fast|vip>	fast: one instruction per speed delay (default)
+	//						vip: COSMAC VIP instruction timing, 60 Hz frames
+	//--quirks <modern|vip>	interpreter behaviour the ROM expects (default modern)
+	//--metrics <port>		Prometheus metrics on http://127.0.0.1:port/metrics
+	//--metrics-json <file>	append a JSON line of metrics every second
+	//--netplay <port>		rollback netplay on UDP 127.0.0.1:port with a second process on --peer
+	//--peer <port>			the other process's --netplay port
+	//--net-delay <ms>		testing: delay every packet sent
+	//--net-loss <percent>	testing: drop packets sent
+	//--turbo				start in turbo, uncapped fast forward (the ` key toggles it)
+	//--turbo-fps <n>		turbo presents at most n frames per second of wall time (default 60)
+	//--turbo-every <frames>	turbo presents every that many emulated frames instead
+	//--terminal <half|braille>	draw in the terminal (e.g. over SSH) rather than a window,
+	//						in half block or braille cells; the scale is ignored
+	bool debug = false;
+	std::string gdbAddress;
+	std::string recordPath;
+	unsigned int runAheadFrames = 0;
+	bool vipTiming = false;
+	unsigned short metricsPort = 0;
+	std::string metricsPath;
+	unsigned short netplayPort = 0;
+	unsigned short peerPort = 0;
+	unsigned int netDelay = 0;
+	unsigned int netLoss = 0;
+	bool startTurbo = false;
+	unsigned int turboFps = 60;
+	unsigned int turboEvery = 0;
+#ifdef CHIP8_NO_SDL
+	bool terminal = true;
+#else
+	bool terminal = false;
+#endif
+	TerminalCells cells = TerminalCells::HalfBlock;
+	Quirks quirks = QUIRKS_MODERN;
+	FrameBlender blender;
+	for (int i = 3; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--debug")
+		{
+			debug = true;
+		}
+		else if (arg == "--gdb" && i + 1 < argc)
+		{
+			gdbAddress = argv[++i];
+		}
+		else if (arg == "--record" && i + 1 < argc)
+		{
+			recordPath = argv[++i];
+		}
+		else if (arg == "--runahead" && i + 1 < argc)
+		{
+			runAheadFrames = std::stoul(argv[++i]);
+		}
+		else if (arg == "--timing" && i + 1 < argc)
+		{
+			vipTiming = std::string(argv[++i]) == "vip";
+		}
+		else if (arg == "--quirks" && i + 1 < argc)
+		{
+			if (!QuirksByName(argv[++i], quirks))
+			{
+				std::cerr << "unknown quirks profile " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		else if (arg == "--metrics" && i + 1 < argc)
+		{
+			metricsPort = static_cast<unsigned short>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--metrics-json" && i + 1 < argc)
+		{
+			metricsPath = argv[++i];
+		}
+		else if (arg == "--netplay" && i + 1 < argc)
+		{
+			netplayPort = static_cast<unsigned short>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--peer" && i + 1 < argc)
+		{
+			peerPort = static_cast<unsigned short>(std::stoul(argv[++i]));
+		}
+		else if (arg == "--net-delay" && i + 1 < argc)
+		{
+			netDelay = std::stoul(argv[++i]);
+		}
+		else if (arg == "--net-loss" && i + 1 < argc)
+		{
+			netLoss = std::stoul(argv[++i]);
+		}
+		else if (arg == "--turbo")
+		{
+			startTurbo = true;
+		}
+		else if (arg == "--turbo-fps" && i + 1 < argc)
+		{
+			turboFps = std::max(1ul, std::stoul(argv[++i]));
+		}
+		else if (arg == "--turbo-every" && i + 1 < argc)
+		{
+			turboEvery = std::stoul(argv[++i]);
+		}
+		else if (arg == "--terminal" && i + 1 < argc)
+		{
+			terminal = true;
+			cells = std::string(argv[++i]) == "braille" ? TerminalCells::Braille : TerminalCells::HalfBlock;
+		}
+		else if (arg == "--persist" && i + 1 < argc)
+		{
+			blender.SetOr(std::stoul(argv[++i]));
+		}
+		else if (arg == "--phosphor" && i + 1 < argc)
+		{
+			blender.SetPhosphor(std::stoul(argv[++i]));
+		}
+	}
+
+	//the terminal debugger reads commands from the terminal the frontend draws on
+	if (terminal && debug)
+	{
+		std::cerr << "--debug needs the terminal for itself, use --gdb with --terminal" << std::endl;
+		return 1;
+	}
 
-	//if unable to initialise SDL video/audio subsystem
+	std::unique_ptr<Frontend> interpreter;
+	if (terminal)
+	{
+		interpreter = std::make_unique<TerminalLayer>(VIDEO_WIDTH, VIDEO_HEIGHT, cells);
+	}
+#ifndef CHIP8_NO_SDL
+	else
+	{
+		interpreter = std::make_unique<SDL_Layer>(WINDOW_TITLE, VIDEO_WIDTH * resScale, VIDEO_HEIGHT * resScale, VIDEO_WIDTH, VIDEO_HEIGHT);
+	}
+#endif
+
+	//if unable to initialise SDL video/audio subsystem or the terminal
 	if (interpreter->flag == false)
 	{
 		return 1;
 		//print error?
 	}
+	interpreter->turbo = startTurbo;
+
+	//plain data with shared dispatch tables - no need for the heap
+	Chip8 chip8;
+	chip8.SetQuirks(quirks);
+	if (netplayPort != 0)
+	{
+		//both processes must start from the same machine
+		chip8.Reset(NETPLAY_SEED);
+	}
+	chip8.LoadROM(argv[2]);
+	chip8.speed = cycleDelay;
+
+	//whole frames of a fixed length on both sides, so the speed keys have no effect
+	//and the debuggers are not available
+	std::unique_ptr<Netplay> netplay;
+	bool localKeys[KEY_COUNT] = {};
+	if (netplayPort != 0)
+	{
+		debug = false;
+		gdbAddress.clear();
+		unsigned int instructionsPerFrame = vipTiming ? 0 : std::max(1u, static_cast<unsigned int>(1000.0f / 60 / cycleDelay));
+		netplay = std::make_unique<Netplay>(chip8, instructionsPerFrame);
+		if (peerPort == 0 || !netplay->Open(netplayPort, peerPort))
+		{
+			std::cerr << "unable to start netplay on port " << netplayPort << " with peer " << peerPort << std::endl;
+			return 1;
+		}
+		netplay->SetConditions(netDelay, 0, netLoss, static_cast<uint32_t>(netplayPort));
+	}
+
+	//debug engine variant only when asked for, the normal loop calls Cycle() directly
+	std::unique_ptr<Debugger> debugger;
+	if (debug)
+	{
+		debugger = std::make_unique<Debugger>(chip8);
+		debugger->PrintState(std::cout);
+	}
 
-	std::unique_ptr<Chip8> chip8 = std::make_unique<Chip8>();
-	chip8->LoadROM(argv[2]);
-	chip8->speed = cycleDelay;
+	std::unique_ptr<GdbStub> gdbStub;
+	if (!gdbAddress.empty())
+	{
+		gdbStub = std::make_unique<GdbStub>(chip8);
+		bool isPort = gdbAddress.find_first_not_of("0123456789") == std::string::npos;
+		bool listening = isPort ? gdbStub->ListenTcp(static_cast<unsigned short>(std::stoi(gdbAddress)))
+			: gdbStub->ListenUnix(gdbAddress.c_str());
+		if (!listening)
+		{
+			std::cerr << "unable to listen for gdb on " << gdbAddress << ": " << strerror(errno) << std::endl;
+			return 1;
+		}
+	}
+
+	Recorder recorder;
+	if (!recordPath.empty() && !recorder.Open(recordPath.c_str()))
+	{
+		std::cerr << "unable to record to " << recordPath << std::endl;
+		return 1;
+	}
+
+	Metrics metrics;
+	InstanceMetrics& counters = metrics.Register("main");
+	if ((metricsPort != 0 || !metricsPath.empty()) && !metrics.Start(metricsPort, metricsPath))
+	{
+		std::cerr << "unable to export metrics" << std::endl;
+		return 1;
+	}
+	auto lastPresent = std::chrono::steady_clock::now();
 
 	//SDL pitch param is the number of bytes in a row of pixel data
-	int videoPitch = sizeof(chip8->video[0]) * VIDEO_WIDTH;
+	int videoPitch = sizeof(chip8.video[0]) * VIDEO_WIDTH;
+
+	//speculation would run past breakpoints, so debugging always shows the real machine
+	//the debuggers step single instructions, so they always use the fast mode
+	vipTiming = vipTiming && !debug && gdbAddress.empty();
+	RunAhead runAhead(debug || !gdbAddress.empty() || netplay ? 0 : runAheadFrames);
+	runAhead.SetTimed(vipTiming);
+	unsigned int frameInstructions = 0;
+	//run-ahead and blending work on whole frames, so the display is refreshed at 60 Hz
+	//rather than after every instruction
+	bool framePaced = runAhead.Frames() > 0 || blender.Enabled() || vipTiming || netplay;
+	const auto framePeriod = std::chrono::microseconds(1000000 / 60);
+	auto nextFrame = std::chrono::steady_clock::now();
 
-	auto lastCycleTime = std::chrono::system_clock::now();
+	//Turbo runs emulated frames back to back with no delay, checking the clock only
+	//every TURBO_CHECK_INSTRUCTIONS or so, and presents at turboFps or after every
+	//turboEvery frames - without Filter() and run-ahead, whose presents would otherwise
+	//cap it. A frame is what the machine runs in 1/60 s at the starting speed, so the
+	//speed shown in the title is emulated frames per 1/60 s of wall time.
+	const unsigned int turboFrameInstructions = std::max(1u, static_cast<unsigned int>(1000.0f / 60 / std::max(cycleDelay, 0.25f)));
+	const auto turboPeriod = std::chrono::microseconds(1000000 / turboFps);
+	bool turbo = false;
+	auto nextTurboPresent = std::chrono::steady_clock::now();
+	auto turboWindowStart = std::chrono::steady_clock::now();
+	uint64_t turboFrames = 0;
+
+	auto lastCycleTime = std::chrono::steady_clock::now();
+	auto recordStart = std::chrono::steady_clock::now();
+	uint32_t nextRecordMs = 0;
 
 	bool quit = false;
 
+	//counters are copied out per presented frame, never per instruction
+	auto present = [&](const uint32_t* video)
+	{
+		interpreter->Update(video, videoPitch, VIDEO_WIDTH * resScale, VIDEO_HEIGHT * resScale);
+
+		auto now = std::chrono::steady_clock::now();
+		counters.RecordFrame(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - lastPresent).count()));
+		lastPresent = now;
+		counters.Publish(chip8.Stats());
+		counters.inputEvents.Set(interpreter->inputEvents);
+	};
+
 	while (!quit)
 	{
-		quit = interpreter->ProcessInput(chip8->keypad, chip8->pGameSpeed);
+		//gdb's bs/bc replay instructions on the stub thread, so the loop holds the stub's
+		//lock whenever it touches the machine, dropping it for Service() and the wait
+		std::unique_lock<std::mutex> machineLock;
+		if (gdbStub)
+		{
+			machineLock = gdbStub->Lock();
+		}
+
+		quit = interpreter->ProcessInput(netplay ? localKeys : chip8.keypad, &chip8.speed);
 
-		cycleDelay = chip8->speed;
+		cycleDelay = chip8.speed;
+
+		//the debuggers step single instructions and netplay keeps to the peer's frames
+		bool wasTurbo = turbo;
+		turbo = interpreter->turbo && !debugger && !gdbStub && !netplay;
+		if (turbo != wasTurbo)
+		{
+			auto now = std::chrono::steady_clock::now();
+			nextTurboPresent = turboWindowStart = lastCycleTime = nextFrame = now;
+			turboFrames = 0;
+			interpreter->SetTitle(WINDOW_TITLE);
+		}
+
+		//stopped in the debugger - the terminal prompt blocks until a command is entered
+		if (debugger && debugger->stopped && !quit)
+		{
+			std::string line;
+			std::cout << "(chip8) " << std::flush;
+			if (!std::getline(std::cin, line) || !debugger->Command(line, std::cout))
+			{
+				quit = true;
+			}
+
+			interpreter->Update(chip8.video, videoPitch, VIDEO_WIDTH * resScale, VIDEO_HEIGHT * resScale);
+			lastCycleTime = std::chrono::steady_clock::now();
+			continue;
+		}
 
 		//cycleDelay-independent filter refresh
-		interpreter->Filter(chip8->video, videoPitch, VIDEO_WIDTH * resScale, VIDEO_HEIGHT * resScale);
+		if (!turbo)
+		{
+			interpreter->Filter(chip8.video, videoPitch, VIDEO_WIDTH * resScale, VIDEO_HEIGHT * resScale);
+		}
 
-		auto currentTime = std::chrono::system_clock::now();
-		auto timeDiff = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - lastCycleTime).count();
+		auto currentTime = std::chrono::steady_clock::now();
+		auto cyclePeriod = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<float, std::milli>(cycleDelay));
 
 		//check if enough time has passed between cycles
-		if (timeDiff > cycleDelay)
+		if (!turbo && currentTime - lastCycleTime >= cyclePeriod)
+		{
+			//keep to the schedule when a wait oversleeps, but never catch up more than a frame
+			lastCycleTime = std::max(lastCycleTime + cyclePeriod, currentTime - std::chrono::duration_cast<std::chrono::steady_clock::duration>(framePeriod));
+
+			if (gdbStub && gdbStub->Attached())
+			{
+				//one instruction, or nothing while gdb has the machine halted
+				machineLock.unlock();
+				gdbStub->Service();
+				machineLock.lock();
+			}
+			else if (debugger)
+			{
+				//breakpoint/watchpoint/condition hit - show where we stopped
+				if (debugger->Run() != StopReason::None)
+				{
+					debugger->PrintState(std::cout);
+				}
+			}
+			else if (!vipTiming && !netplay)
+			{
+				chip8.Cycle();
+				++frameInstructions;
+			}
+
+			//frame paced displays are refreshed below
+			if (!framePaced)
+			{
+				present(chip8.video);
+			}
+		}
+
+		//present what the machine will show runAhead frames from now, at the
+		//instruction rate of the frame that just finished, then blend out flicker
+		auto now = std::chrono::steady_clock::now();
+		if (!turbo && framePaced && now >= nextFrame)
+		{
+			//netplay runs its own frames, rolling back first when the peer's keys disagree
+			//with what it predicted; a stalled frame shows the display unchanged
+			if (netplay)
+			{
+				netplay->Poll();
+				netplay->AdvanceFrame(localKeys);
+			}
+			//timed mode runs exactly one emulated frame of work per displayed frame
+			else if (vipTiming)
+			{
+				frameInstructions = chip8.RunFrame();
+			}
+
+			const uint32_t* ahead = runAhead.Speculate(chip8, std::max(1u, frameInstructions));
+			present(blender.Apply(ahead));
+			frameInstructions = 0;
+			//skip frames missed while stalled rather than presenting them in a burst
+			if (now - nextFrame >= framePeriod)
+			{
+				counters.droppedFrames.Add((now - nextFrame) / framePeriod);
+			}
+			nextFrame = std::max(nextFrame + framePeriod, now);
+		}
+
+		//a machine waiting in Fx0A with its timers stopped has nothing to run, so turbo
+		//stops there and sleeps like the normal loop until a key goes down
+		if (turbo && !chip8.Idle())
+		{
+			unsigned int framesPerCheck = vipTiming ? 1 : std::max(1u, TURBO_CHECK_INSTRUCTIONS / turboFrameInstructions);
+			unsigned int frames = 0;
+			bool due = false;
+			while (!due && !chip8.Idle())
+			{
+				for (unsigned int frame = 0; frame < framesPerCheck && !due; ++frame)
+				{
+					if (vipTiming)
+					{
+						chip8.RunFrame();
+					}
+					else
+					{
+						for (unsigned int i = 0; i < turboFrameInstructions; ++i)
+						{
+							chip8.Cycle();
+						}
+					}
+					++frames;
+					due = turboEvery != 0 && frames >= turboEvery;
+				}
+				due = due || (turboEvery == 0 && std::chrono::steady_clock::now() >= nextTurboPresent);
+			}
+			turboFrames += frames;
+			present(blender.Apply(chip8.video));
+
+			now = std::chrono::steady_clock::now();
+			nextTurboPresent = turboEvery != 0 ? now : std::max(nextTurboPresent + turboPeriod, now);
+
+			//achieved speed, once a second
+			if (now - turboWindowStart >= std::chrono::seconds(1))
+			{
+				double seconds = std::chrono::duration<double>(now - turboWindowStart).count();
+				std::ostringstream title;
+				title << WINDOW_TITLE << " - turbo " << std::fixed << std::setprecision(1) << turboFrames / (seconds * 60) << "x";
+				interpreter->SetTitle(title.str().c_str());
+				turboWindowStart = now;
+				turboFrames = 0;
+			}
+		}
+
+		//one recorded frame per 1/60 s of wall time, whatever the instruction rate
+		if (recorder.IsOpen())
 		{
-			lastCycleTime = currentTime;
+			uint32_t nowMs = static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - recordStart).count());
+			if (nowMs >= nextRecordMs)
+			{
+				recorder.Submit(chip8.video, nowMs);
+				nextRecordMs = nowMs + 1000 / 60;
+			}
+		}
 
-			chip8->Cycle();
+		//sleep until the next instruction, presented or recorded frame is due, or input
+		//arrives, rather than spinning; a machine idle in Fx0A needs no instructions at
+		//all until a key goes down, so it only wakes for frames
+		if (!quit && !(debugger && debugger->stopped) && !(turbo && !chip8.Idle()))
+		{
+			auto wake = std::chrono::steady_clock::now() + std::chrono::milliseconds(IDLE_WAIT_MS);
+			if (!turbo && !vipTiming && !netplay && !(chip8.Idle() && !debugger && !gdbStub))
+			{
+				wake = std::min(wake, lastCycleTime + cyclePeriod);
+			}
+			if (framePaced && !turbo)
+			{
+				wake = std::min(wake, nextFrame);
+			}
+			if (recorder.IsOpen())
+			{
+				wake = std::min(wake, recordStart + std::chrono::milliseconds(nextRecordMs));
+			}
 
-			interpreter->Update(chip8->video, videoPitch, VIDEO_WIDTH * resScale, VIDEO_HEIGHT * resScale);
+			//rounded up - the schedule above absorbs the lateness
+			auto remaining = wake - std::chrono::steady_clock::now();
+			int waitMs = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(remaining).count());
+			if (waitMs > 0)
+			{
+				if (machineLock)
+				{
+					machineLock.unlock();
+				}
+				interpreter->WaitInput(waitMs);
+			}
 		}
 	}
 
+	//back to the normal terminal screen before the summaries below
+	interpreter.reset();
+
+	if (recorder.IsOpen())
+	{
+		recorder.Close();
+		std::cout << "recorded " << recorder.Written() << " images to " << recordPath << ", "
+			<< recorder.Dropped() << " frames dropped" << std::endl;
+	}
+
+	if (chip8.Faults() != 0)
+	{
+		std::cout << "machine faults: " << FaultNames(chip8.Faults()) << std::endl;
+	}
+
+	if (netplay)
+	{
+		const NetplayStats& stats = netplay->Stats();
+		std::cout << "netplay: " << netplay->Frame() << " frames, " << stats.rollbacks << " rollbacks ("
+			<< stats.resimulatedFrames << " frames re-run, slowest " << stats.slowestRollbackUs << " us), "
+			<< stats.stalls << " stalls" << std::endl;
+	}
+
 	return 0;
 }
@@ -0,0 +1,500 @@
+//Interpreter core benchmarks with JSON output and baseline comparison
+//usage: benchmark [--roms <dir>] [--repeat <n>] [--json <out.json>]
+//		[--compare <baseline.json>] [--threshold <percent>]
+//
+//	cycle/<rom>		Chip8::Cycle() on each bundled synthetic ROM (roms/bench)
+//	dxyn			OP_Dxyn throughput, a 15 row sprite drawn in a tight loop
+//	vip/<rom>		Chip8::RunFrame(), one emulated 60 Hz frame with VIP timing
+//	instance/new	make_unique<Chip8> + LoadROM, the old per-run cost
+//	instance/pool	Chip8Pool Acquire + LoadROM + Release
+//	instance/clone	copy of a whole machine, as run-ahead does every frame
+//	random/batch	one Cxkk byte for each of 256 instances in a single RandomBytes loop
+//	blend/<mode>/<size>	FrameBlender::Apply per presented frame (budget 50 us at 128x64)
+//	frame			Update + Filter through SDL_Layer on the dummy video driver
+//	mosaic/<n>		Blit + one atlas upload for n instances, one tile changing per frame
+//					(both skipped when built with CHIP8_NO_SDL)
+//
+//With --compare, any benchmark whose median ns/op is more than threshold percent
+//(default 5) slower than the baseline is reported and the exit code is 1.
+
+#include "../Chip8.h"
+#include "../Chip8Pool.h"
+#include "../FrameBlender.h"
+#ifndef CHIP8_NO_SDL
+#include "../Mosaic.h"
+#include "../SDL_Layer.h"
+#endif
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+struct Result
+{
+	std::string name;
+	std::string unit;
+	double nsPerOp;
+	double opsPerSec;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static std::vector<uint8_t> ReadFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+static double Median(std::vector<double> samples)
+{
+	std::sort(samples.begin(), samples.end());
+	return samples[samples.size() / 2];
+}
+
+//run ops instructions of rom on a fresh instance, repeat times, and return the median ns per instruction
+static double TimeCycles(const std::vector<uint8_t>& rom, unsigned int ops, unsigned int repeat)
+{
+	std::vector<double> samples;
+
+	for (unsigned int r = 0; r < repeat; ++r)
+	{
+		Chip8 chip8;
+		chip8.LoadROM(rom.data(), rom.size());
+
+		auto start = Clock::now();
+		for (unsigned int i = 0; i < ops; ++i)
+		{
+			chip8.Cycle();
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+		samples.push_back(elapsed / ops);
+	}
+
+	return Median(samples);
+}
+
+//written by TimeInstances so the compiler cannot drop the instances it measures
+static volatile uint32_t instanceSink;
+
+//create (or acquire) a power-on instance with rom loaded, run one instruction
+//and throw it away again
+static double TimeInstances(const std::vector<uint8_t>& rom, bool pooled, unsigned int ops, unsigned int repeat)
+{
+	const size_t LIVE = 64;
+	Chip8Pool pool(LIVE);
+	std::vector<double> samples;
+
+	for (unsigned int r = 0; r < repeat; ++r)
+	{
+		auto start = Clock::now();
+		for (unsigned int i = 0; i < ops; ++i)
+		{
+			if (pooled)
+			{
+				Chip8* chip8 = pool.Acquire(i + 1);
+				chip8->LoadROM(rom.data(), rom.size());
+				chip8->Cycle();
+				instanceSink = chip8->video[0];
+				pool.Release(chip8);
+			}
+			else
+			{
+				std::unique_ptr<Chip8> chip8 = std::make_unique<Chip8>();
+				chip8->LoadROM(rom.data(), rom.size());
+				chip8->Cycle();
+				instanceSink = chip8->video[0];
+			}
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+		samples.push_back(elapsed / ops);
+	}
+
+	return Median(samples);
+}
+
+static double TimeClones(unsigned int ops, unsigned int repeat)
+{
+	Chip8 source;
+	Chip8 clone;
+	std::vector<double> samples;
+
+	for (unsigned int r = 0; r < repeat; ++r)
+	{
+		auto start = Clock::now();
+		for (unsigned int i = 0; i < ops; ++i)
+		{
+			source.video[i % (VIDEO_WIDTH * VIDEO_HEIGHT)] ^= 1;
+			clone = source;
+			instanceSink = clone.video[i % (VIDEO_WIDTH * VIDEO_HEIGHT)];
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+		samples.push_back(elapsed / ops);
+	}
+
+	return Median(samples);
+}
+
+//ns per byte drawn for a batch of instances, each its own stream
+static double TimeRandom(unsigned int rounds, unsigned int repeat)
+{
+	const unsigned int LANES = 256;
+	uint64_t keys[LANES];
+	uint32_t counters[LANES] = {};
+	uint8_t bytes[LANES];
+	std::vector<double> samples;
+
+	for (unsigned int i = 0; i < LANES; ++i)
+	{
+		keys[i] = Chip8Random::Key(1, i);
+	}
+
+	for (unsigned int r = 0; r < repeat; ++r)
+	{
+		auto start = Clock::now();
+		for (unsigned int i = 0; i < rounds; ++i)
+		{
+			RandomBytes(keys, counters, bytes, LANES);
+			instanceSink = bytes[i % LANES];
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+		samples.push_back(elapsed / (static_cast<double>(rounds) * LANES));
+	}
+
+	return Median(samples);
+}
+
+//one blended frame of width x height, a few pixels toggled between frames
+static double TimeBlend(bool phosphor, unsigned int width, unsigned int height, unsigned int frames, unsigned int repeat)
+{
+	FrameBlender blender(width, height);
+	std::vector<uint32_t> video(width * height, 0);
+	std::vector<double> samples;
+
+	for (unsigned int r = 0; r < repeat; ++r)
+	{
+		if (phosphor)
+		{
+			blender.SetPhosphor(75);
+		}
+		else
+		{
+			blender.SetOr(3);
+		}
+
+		auto start = Clock::now();
+		for (unsigned int i = 0; i < frames; ++i)
+		{
+			video[(i * 7919) % video.size()] ^= 0xFFFFFFFF;
+			instanceSink = blender.Apply(video.data())[i % video.size()];
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+		samples.push_back(elapsed / frames);
+	}
+
+	return Median(samples);
+}
+
+//median ns per RunFrame() call
+static double TimeVipFrames(const std::vector<uint8_t>& rom, unsigned int frames, unsigned int repeat)
+{
+	std::vector<double> samples;
+
+	for (unsigned int r = 0; r < repeat; ++r)
+	{
+		Chip8 chip8;
+		chip8.LoadROM(rom.data(), rom.size());
+
+		auto start = Clock::now();
+		for (unsigned int i = 0; i < frames; ++i)
+		{
+			chip8.RunFrame();
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+		samples.push_back(elapsed / frames);
+	}
+
+	return Median(samples);
+}
+
+#ifndef CHIP8_NO_SDL
+static double TimeFrames(unsigned int frames, unsigned int repeat)
+{
+	//offscreen - no window is shown and nothing waits on vsync
+	SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+
+	const int scale = 10;
+	SDL_Layer layer("benchmark", VIDEO_WIDTH * scale, VIDEO_HEIGHT * scale, VIDEO_WIDTH, VIDEO_HEIGHT);
+	if (!layer.flag)
+	{
+		return 0;
+	}
+
+	Chip8 chip8;
+	int videoPitch = sizeof(chip8.video[0]) * VIDEO_WIDTH;
+	std::vector<double> samples;
+
+	for (unsigned int r = 0; r < repeat; ++r)
+	{
+		auto start = Clock::now();
+		for (unsigned int i = 0; i < frames; ++i)
+		{
+			//change a pixel so every frame uploads different contents
+			chip8.video[i % (VIDEO_WIDTH * VIDEO_HEIGHT)] ^= 0xFFFFFFFF;
+			layer.Update(chip8.video, videoPitch, VIDEO_WIDTH * scale, VIDEO_HEIGHT * scale);
+			layer.Filter(chip8.video, videoPitch, VIDEO_WIDTH * scale, VIDEO_HEIGHT * scale);
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+		samples.push_back(elapsed / frames);
+	}
+
+	return Median(samples);
+}
+
+//cost of one mosaic frame with tiles instances where only one display changes
+static double TimeMosaic(unsigned int tiles, unsigned int frames, unsigned int repeat)
+{
+	SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+
+	Mosaic mosaic(tiles);
+	SDL_Layer layer("benchmark", mosaic.Width(), mosaic.Height(), mosaic.Width(), mosaic.Height());
+	if (!layer.flag)
+	{
+		return 0;
+	}
+
+	std::vector<Chip8> machines(tiles);
+	std::vector<double> samples;
+
+	for (unsigned int r = 0; r < repeat; ++r)
+	{
+		auto start = Clock::now();
+		for (unsigned int i = 0; i < frames; ++i)
+		{
+			machines[i % tiles].video[i % (VIDEO_WIDTH * VIDEO_HEIGHT)] ^= 0xFFFFFFFF;
+			for (unsigned int tile = 0; tile < tiles; ++tile)
+			{
+				mosaic.Blit(tile, machines[tile].video);
+			}
+
+			SDL_Rect region;
+			if (mosaic.TakeDirty(region.x, region.y, region.w, region.h))
+			{
+				layer.Update(mosaic.Atlas() + region.y * mosaic.Width() + region.x, mosaic.Pitch(), region);
+			}
+		}
+		auto elapsed = std::chrono::duration<double, std::nano>(Clock::now() - start).count();
+
+		samples.push_back(elapsed / frames);
+	}
+
+	return Median(samples);
+}
+#endif
+
+static void WriteJson(std::ostream& out, const std::vector<Result>& results)
+{
+	char line[256];
+
+	out << "{\n\t\"benchmarks\": [\n";
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		snprintf(line, sizeof(line), "\t\t{ \"name\": \"%s\", \"unit\": \"%s\", \"ns_per_op\": %.3f, \"ops_per_sec\": %.0f }%s\n",
+			results[i].name.c_str(), results[i].unit.c_str(), results[i].nsPerOp, results[i].opsPerSec,
+			i + 1 < results.size() ? "," : "");
+		out << line;
+	}
+	out << "\t]\n}\n";
+}
+
+//reads back the format written by WriteJson
+static std::vector<Result> ReadJson(const std::string& path)
+{
+	std::vector<Result> results;
+	std::ifstream file(path);
+	std::string line;
+
+	while (std::getline(file, line))
+	{
+		size_t name = line.find("\"name\": \"");
+		size_t ns = line.find("\"ns_per_op\": ");
+		if (name == std::string::npos || ns == std::string::npos)
+		{
+			continue;
+		}
+
+		Result result{};
+		name += 9;
+		result.name = line.substr(name, line.find('"', name) - name);
+		result.nsPerOp = std::stod(line.substr(ns + 13));
+		results.push_back(result);
+	}
+
+	return results;
+}
+
+int main(int argc, char** argv)
+{
+	std::string romDir = "roms/bench";
+	std::string jsonPath;
+	std::string baselinePath;
+	unsigned int repeat = 5;
+	double threshold = 5;
+
+	for (int i = 1; i + 1 < argc; i += 2)
+	{
+		std::string arg = argv[i];
+		if (arg == "--roms") romDir = argv[i + 1];
+		else if (arg == "--repeat") repeat = std::max(1, std::stoi(argv[i + 1]));
+		else if (arg == "--json") jsonPath = argv[i + 1];
+		else if (arg == "--compare") baselinePath = argv[i + 1];
+		else if (arg == "--threshold") threshold = std::stod(argv[i + 1]);
+		else
+		{
+			std::cerr << "unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	const unsigned int CYCLE_OPS = 5000000;
+	const unsigned int DRAW_OPS = 1000000;
+	const unsigned int INSTANCE_OPS = 200000;
+	const unsigned int BLEND_OPS = 20000;
+	const unsigned int VIP_FRAMES = 20000;
+#ifndef CHIP8_NO_SDL
+	const unsigned int FRAME_OPS = 2000;
+#endif
+
+	std::vector<Result> results;
+
+	//instruction mix benchmarks
+	const char* roms[] = { "alu", "draw", "call", "memory" };
+	for (const char* rom : roms)
+	{
+		std::vector<uint8_t> image = ReadFile(romDir + "/" + rom + ".ch8");
+		if (image.empty())
+		{
+			std::cerr << "missing " << romDir << "/" << rom << ".ch8" << std::endl;
+			return 1;
+		}
+
+		double ns = TimeCycles(image, CYCLE_OPS, repeat);
+		results.push_back({ std::string("cycle/") + rom, "instruction", ns, 1e9 / ns });
+
+		ns = TimeVipFrames(image, VIP_FRAMES, repeat);
+		results.push_back({ std::string("vip/") + rom, "frame", ns, 1e9 / ns });
+	}
+
+	//LD I, 0x050 ; DRW V0, V1, F ; JP 0x202 - half the instructions draw 15 rows of font data
+	{
+		const uint8_t image[] = { 0xA0, 0x50, 0xD0, 0x1F, 0x12, 0x02 };
+		std::vector<uint8_t> rom(std::begin(image), std::end(image));
+
+		double ns = TimeCycles(rom, DRAW_OPS * 2, repeat) * 2;
+		results.push_back({ "dxyn", "draw", ns, 1e9 / ns });
+	}
+
+	//instances created+reset per second, with and without the pool
+	{
+		std::vector<uint8_t> rom = ReadFile(romDir + "/alu.ch8");
+
+		double ns = TimeInstances(rom, false, INSTANCE_OPS, repeat);
+		results.push_back({ "instance/new", "instance", ns, 1e9 / ns });
+
+		ns = TimeInstances(rom, true, INSTANCE_OPS, repeat);
+		results.push_back({ "instance/pool", "instance", ns, 1e9 / ns });
+
+		ns = TimeClones(INSTANCE_OPS * 5, repeat);
+		results.push_back({ "instance/clone", "clone", ns, 1e9 / ns });
+
+		ns = TimeRandom(INSTANCE_OPS / 64, repeat);
+		results.push_back({ "random/batch", "byte", ns, 1e9 / ns });
+	}
+
+	for (bool phosphor : { false, true })
+	{
+		for (unsigned int size : { 1u, 2u })
+		{
+			unsigned int width = VIDEO_WIDTH * size;
+			unsigned int height = VIDEO_HEIGHT * size;
+			double ns = TimeBlend(phosphor, width, height, BLEND_OPS, repeat);
+			std::string name = std::string("blend/") + (phosphor ? "phosphor/" : "or/") + std::to_string(width) + "x" + std::to_string(height);
+			results.push_back({ name, "frame", ns, 1e9 / ns });
+		}
+	}
+
+#ifndef CHIP8_NO_SDL
+	{
+		double ns = TimeFrames(FRAME_OPS, repeat);
+		if (ns > 0)
+		{
+			results.push_back({ "frame", "frame", ns, 1e9 / ns });
+		}
+
+		for (unsigned int tiles : { 16u, 64u, 256u })
+		{
+			ns = TimeMosaic(tiles, FRAME_OPS, repeat);
+			if (ns > 0)
+			{
+				results.push_back({ "mosaic/" + std::to_string(tiles), "frame", ns, 1e9 / ns });
+			}
+		}
+	}
+#endif
+
+	for (const Result& result : results)
+	{
+		printf("%-22s %10.2f ns/%s %14.0f %s/s\n", result.name.c_str(), result.nsPerOp, result.unit.c_str(),
+			result.opsPerSec, result.unit.c_str());
+	}
+
+	if (!jsonPath.empty())
+	{
+		std::ofstream out(jsonPath);
+		WriteJson(out, results);
+	}
+
+	int status = 0;
+	if (!baselinePath.empty())
+	{
+		std::vector<Result> baseline = ReadJson(baselinePath);
+		if (baseline.empty())
+		{
+			std::cerr << "no results in " << baselinePath << std::endl;
+			return 1;
+		}
+
+		for (const Result& result : results)
+		{
+			for (const Result& base : baseline)
+			{
+				if (base.name != result.name)
+				{
+					continue;
+				}
+
+				double change = (result.nsPerOp - base.nsPerOp) / base.nsPerOp * 100;
+				bool regressed = change > threshold;
+				printf("%-22s %+7.1f%%%s\n", result.name.c_str(), change, regressed ? "  REGRESSION" : "");
+				status |= regressed ? 1 : 0;
+			}
+		}
+	}
+
+	return status;
+}
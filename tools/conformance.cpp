@@ -0,0 +1,344 @@
+//Conformance suite: test ROMs against golden display hashes under every quirk profile
+//usage: conformance [manifest] [--update] [--only <test>] [--show]
+//
+//	manifest	default roms/conformance/manifest.txt; ROMs, scripts and golden.txt
+//				are looked up next to it
+//	--update	write the hashes of this run to golden.txt instead of comparing
+//	--only		run a single test
+//	--show		print the last frame of every run, to check a new golden by eye
+//
+//A manifest line is "<test> <rom> <frames> <ipf|vip> [input script]"; # starts a
+//comment. vip runs each frame with COSMAC VIP instruction timing. Input scripts
+//use the sweep format, "<frame> <key hex> <down|up>" per line.
+//
+//Every test runs once per quirk profile from the same Cxkk seed. The display is
+//hashed (FNV-1a, 1 bit per pixel) after the last frame, and every frame is chained
+//into a trace hash, so a change in when something is drawn fails as well as a
+//change in what ends up on screen. golden.txt holds "<test> <profile> <final>
+//<trace>" per run. Exit code 1 on any mismatch or missing golden.
+//
+//The bundled ROMs check themselves and draw a tick or a cross per check:
+//	flags		8xy4/8xy5/8xy7/8xy6/8xyE results and VF, VF as the destination
+//	clip		Dxyn clipping at the right and bottom edges, wrapped start
+//				coordinates, collisions, zero height
+//	keywait		Fx0A with scripted input: lowest key wins, held keys return once
+//	quirks		draws what differs between profiles (shift source, I after Fx55/Fx65)
+//Other test ROMs can be added to the manifest; run --update --show once and check
+//the screens before committing the new golden lines.
+
+#include "../Chip8.h"
+#include "../FrameCodec.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+//every run starts from the same Cxkk seed so the hashes are stable
+const uint32_t CONFORMANCE_SEED = 1;
+const char* const PROFILES[] = { "modern", "vip" };
+
+const uint64_t FNV_OFFSET = 0xCBF29CE484222325ull;
+const uint64_t FNV_PRIME = 0x100000001B3ull;
+
+struct InputEvent
+{
+	unsigned int frame;
+	uint8_t key;
+	bool down;
+};
+
+struct Test
+{
+	std::string name;
+	std::vector<uint8_t> image;
+	unsigned int frames;
+	unsigned int ipf;	//0 runs VIP timed frames
+	std::vector<InputEvent> events;	//in frame order
+};
+
+struct Hashes
+{
+	uint64_t final;
+	uint64_t trace;
+};
+
+static uint64_t Fnv1a(const uint8_t* data, size_t size, uint64_t hash)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ data[i]) * FNV_PRIME;
+	}
+	return hash;
+}
+
+static std::vector<uint8_t> ReadFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+//lines without a # comment, split on whitespace; blank lines are dropped
+static bool ReadFields(const std::string& path, std::vector<std::vector<std::string>>& lines)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line.substr(0, line.find('#')));
+		std::vector<std::string> fields((std::istream_iterator<std::string>(stream)), std::istream_iterator<std::string>());
+		if (!fields.empty())
+		{
+			lines.push_back(std::move(fields));
+		}
+	}
+	return true;
+}
+
+static bool ReadScript(const std::string& path, std::vector<InputEvent>& events)
+{
+	std::vector<std::vector<std::string>> lines;
+	if (!ReadFields(path, lines))
+	{
+		return false;
+	}
+
+	for (const auto& fields : lines)
+	{
+		if (fields.size() < 3)
+		{
+			return false;
+		}
+		InputEvent event{};
+		event.frame = std::stoul(fields[0]);
+		event.key = static_cast<uint8_t>(std::stoul(fields[1], nullptr, 16) & 0xF);
+		event.down = fields[2] == "down";
+		events.push_back(event);
+	}
+
+	std::stable_sort(events.begin(), events.end(),
+		[](const InputEvent& a, const InputEvent& b) { return a.frame < b.frame; });
+	return true;
+}
+
+static bool ReadManifest(const std::string& path, std::vector<Test>& tests)
+{
+	std::vector<std::vector<std::string>> lines;
+	if (!ReadFields(path, lines))
+	{
+		std::cerr << "unable to read " << path << std::endl;
+		return false;
+	}
+
+	std::filesystem::path directory = std::filesystem::path(path).parent_path();
+	for (const auto& fields : lines)
+	{
+		if (fields.size() < 4)
+		{
+			std::cerr << path << ": expected <test> <rom> <frames> <ipf|vip> [script], got " << fields[0] << std::endl;
+			return false;
+		}
+
+		Test test;
+		test.name = fields[0];
+		test.image = ReadFile((directory / fields[1]).string());
+		test.frames = std::stoul(fields[2]);
+		test.ipf = fields[3] == "vip" ? 0 : std::max(1ul, std::stoul(fields[3]));
+		if (test.image.empty())
+		{
+			std::cerr << "unable to read " << (directory / fields[1]).string() << std::endl;
+			return false;
+		}
+		if (fields.size() > 4 && !ReadScript((directory / fields[4]).string(), test.events))
+		{
+			std::cerr << "unable to read " << (directory / fields[4]).string() << std::endl;
+			return false;
+		}
+		tests.push_back(std::move(test));
+	}
+	return true;
+}
+
+static Hashes Run(Chip8& chip8, const Test& test, const Quirks& quirks)
+{
+	chip8.Reset(CONFORMANCE_SEED);
+	chip8.SetQuirks(quirks);
+	chip8.LoadROM(test.image.data(), test.image.size());
+
+	uint8_t packed[FRAME_BYTES] = {};
+	uint64_t trace = FNV_OFFSET;
+	size_t nextEvent = 0;
+
+	for (unsigned int frame = 0; frame < test.frames; ++frame)
+	{
+		for (; nextEvent < test.events.size() && test.events[nextEvent].frame <= frame; ++nextEvent)
+		{
+			chip8.keypad[test.events[nextEvent].key] = test.events[nextEvent].down;
+		}
+
+		if (test.ipf == 0)
+		{
+			chip8.RunFrame();
+		}
+		else
+		{
+			for (unsigned int i = 0; i < test.ipf; ++i)
+			{
+				chip8.Cycle();
+			}
+		}
+
+		PackVideo(chip8.video, packed);
+		trace = Fnv1a(packed, FRAME_BYTES, trace);
+	}
+
+	return Hashes{ Fnv1a(packed, FRAME_BYTES, FNV_OFFSET), trace };
+}
+
+static void PrintDisplay(const uint32_t* video)
+{
+	std::string line;
+	for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y)
+	{
+		line.clear();
+		for (unsigned int x = 0; x < VIDEO_WIDTH; ++x)
+		{
+			line += video[y * VIDEO_WIDTH + x] ? '#' : '.';
+		}
+		printf("\t%s\n", line.c_str());
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::string manifestPath = "roms/conformance/manifest.txt";
+	std::string only;
+	bool update = false;
+	bool show = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--update") update = true;
+		else if (arg == "--show") show = true;
+		else if (arg == "--only" && i + 1 < argc) only = argv[++i];
+		else if (arg.compare(0, 2, "--") != 0) manifestPath = arg;
+		else
+		{
+			std::cerr << "usage: conformance [manifest] [--update] [--only <test>] [--show]" << std::endl;
+			return 1;
+		}
+	}
+
+	std::vector<Test> tests;
+	if (!ReadManifest(manifestPath, tests))
+	{
+		return 1;
+	}
+
+	std::string goldenPath = (std::filesystem::path(manifestPath).parent_path() / "golden.txt").string();
+	std::map<std::string, Hashes> golden;
+	std::vector<std::vector<std::string>> goldenLines;
+	if (ReadFields(goldenPath, goldenLines))
+	{
+		for (const auto& fields : goldenLines)
+		{
+			if (fields.size() >= 4)
+			{
+				golden[fields[0] + ' ' + fields[1]] = Hashes{ std::stoull(fields[2], nullptr, 16), std::stoull(fields[3], nullptr, 16) };
+			}
+		}
+	}
+
+	auto start = Clock::now();
+	Chip8 chip8;
+	unsigned int runs = 0;
+	unsigned int failed = 0;
+	char hex[2][17];
+
+	for (const Test& test : tests)
+	{
+		if (!only.empty() && test.name != only)
+		{
+			continue;
+		}
+
+		for (const char* profile : PROFILES)
+		{
+			Quirks quirks;
+			QuirksByName(profile, quirks);
+			Hashes hashes = Run(chip8, test, quirks);
+			++runs;
+
+			std::string key = test.name + ' ' + profile;
+			snprintf(hex[0], sizeof(hex[0]), "%016llx", static_cast<unsigned long long>(hashes.final));
+			snprintf(hex[1], sizeof(hex[1]), "%016llx", static_cast<unsigned long long>(hashes.trace));
+
+			const char* status = "ok";
+			auto expected = golden.find(key);
+			if (update)
+			{
+				golden[key] = hashes;
+				status = expected == golden.end() ? "new" : "updated";
+			}
+			else if (expected == golden.end())
+			{
+				status = "NO GOLDEN";
+				++failed;
+			}
+			else if (expected->second.final != hashes.final)
+			{
+				status = "FAIL (display)";
+				++failed;
+			}
+			else if (expected->second.trace != hashes.trace)
+			{
+				status = "FAIL (trace)";
+				++failed;
+			}
+
+			printf("%-12s %-8s %s %s  %s\n", test.name.c_str(), profile, hex[0], hex[1], status);
+			if (show)
+			{
+				PrintDisplay(chip8.video);
+			}
+		}
+	}
+
+	double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	printf("%u runs, %u failed, %.1f ms\n", runs, failed, ms);
+
+	if (update)
+	{
+		std::ofstream out(goldenPath);
+		out << "#<test> <profile> <final display hash> <trace hash> - written by conformance --update\n";
+		for (const auto& entry : golden)
+		{
+			snprintf(hex[0], sizeof(hex[0]), "%016llx", static_cast<unsigned long long>(entry.second.final));
+			snprintf(hex[1], sizeof(hex[1]), "%016llx", static_cast<unsigned long long>(entry.second.trace));
+			out << entry.first << ' ' << hex[0] << ' ' << hex[1] << '\n';
+		}
+		if (!out)
+		{
+			std::cerr << "unable to write " << goldenPath << std::endl;
+			return 1;
+		}
+		printf("wrote %s\n", goldenPath.c_str());
+	}
+
+	return failed > 0 ? 1 : 0;
+}
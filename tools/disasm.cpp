@@ -0,0 +1,103 @@
+//Static disassembler / control flow graph dump for CHIP-8 ROMs
+//usage: disasm [--dot | --summary] <rom> [rom...]
+//	default		annotated listing split into basic blocks and data
+//	--dot		Graphviz digraph of the basic blocks
+//	--summary	one line per ROM with block/code/sprite counts and analysis time
+
+#include "../Disassembler.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+
+static bool LoadImage(const char* filename, uint8_t* image)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		return false;
+	}
+
+	std::streampos size = file.tellg();
+	if (size > static_cast<std::streampos>(MEMORY_MAX - START_ADDRESS))
+	{
+		size = MEMORY_MAX - START_ADDRESS;
+	}
+
+	memset(image, 0, MEMORY_MAX);
+	file.seekg(0, std::ios::beg);
+	file.read(reinterpret_cast<char*>(&image[START_ADDRESS]), size);
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	enum { LISTING, DOT, SUMMARY } mode = LISTING;
+	int first = 1;
+
+	if (argc > 1 && strcmp(argv[1], "--dot") == 0)
+	{
+		mode = DOT;
+		++first;
+	}
+	else if (argc > 1 && strcmp(argv[1], "--summary") == 0)
+	{
+		mode = SUMMARY;
+		++first;
+	}
+
+	if (first >= argc)
+	{
+		std::cerr << "usage: disasm [--dot | --summary] <rom> [rom...]" << std::endl;
+		return 1;
+	}
+
+	uint8_t image[MEMORY_MAX];
+	Analyser analyser;
+	int result = 0;
+
+	for (int arg = first; arg < argc; ++arg)
+	{
+		if (!LoadImage(argv[arg], image))
+		{
+			std::cerr << "unable to open " << argv[arg] << std::endl;
+			result = 1;
+			continue;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		analyser.Analyse(image);
+		auto elapsed = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+		switch (mode)
+		{
+		case LISTING:
+		{
+			std::cout << "; " << argv[arg] << "\n";
+			analyser.WriteText(std::cout);
+		} break;
+		case DOT:
+		{
+			analyser.WriteDot(std::cout);
+		} break;
+		case SUMMARY:
+		{
+			unsigned int code = 0;
+			unsigned int sprite = 0;
+			for (unsigned int i = 0; i < MEMORY_MAX; ++i)
+			{
+				code += (analyser.map[i] & MAP_CODE) != 0;
+				sprite += (analyser.map[i] & MAP_SPRITE) != 0;
+			}
+			printf("%s: %u blocks, %u code bytes, %u sprite bytes%s, %.1f us\n", argv[arg],
+				static_cast<unsigned int>(analyser.blocks.size()), code, sprite,
+				analyser.hasIndirect ? ", indirect jumps" : "", elapsed);
+		} break;
+		}
+	}
+
+	return result;
+}
@@ -0,0 +1,363 @@
+//Differential fuzzing harness for the interpreter core
+//
+//libFuzzer:	clang++ -std=c++17 -g -O1 -fsanitize=fuzzer,address,undefined tools/fuzz_chip8.cpp Chip8.cpp
+//standalone:	g++ -std=c++17 -g -O1 -fsanitize=address,undefined -DCHIP8_FUZZ_STANDALONE tools/fuzz_chip8.cpp Chip8.cpp
+//				fuzz_chip8 [iterations] [seed]	random inputs
+//				fuzz_chip8 <file> [file...]		replay inputs
+//
+//Input layout: KEY_STEPS little endian 16 bit keypad masks, then a memory image
+//loaded at START_ADDRESS. Every STEP_INSTRUCTIONS instructions the next keypad mask
+//is applied. After each instruction the machine is checked against a plain switch
+//based reference interpreter and for pc/sp range invariants; memory and video are
+//compared at the end of the run. The machine then runs on from a state with pc, I
+//and sp taken from the input, as LoadState() or gdb could leave them, checking
+//only the invariants - the sanitizers catch any access outside the machine. Any
+//mismatch aborts so the fuzzer records it.
+
+#include "../Chip8.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+const unsigned int KEY_STEPS = 8;
+const unsigned int STEP_INSTRUCTIONS = 256;
+const unsigned int MAX_INSTRUCTIONS = KEY_STEPS * STEP_INSTRUCTIONS;
+
+extern uint8_t fontset[FONT_SIZE];
+
+//reference interpreter - deliberately simple, one switch, no tables
+//it decodes exactly as loosely as the interpreter does (0nn0 is CLS, 5xyN ignores N,
+//ExN1/ExNE are SKNP/SKP) so only real behaviour differences are reported
+struct RefMachine
+{
+	uint8_t registers[REGISTER_COUNT]{};
+	uint8_t memory[MEMORY_MAX]{};
+	uint16_t index{};
+	uint16_t pc = START_ADDRESS;
+	uint16_t stack[STACK_LEVELS]{};
+	uint8_t sp{};
+	uint8_t delayTimer{};
+	uint8_t soundTimer{};
+	uint8_t faults{};
+	uint32_t video[VIDEO_WIDTH * VIDEO_HEIGHT]{};
+	bool keypad[KEY_COUNT]{};
+
+	RefMachine()
+	{
+		memcpy(&memory[FONT_START_ADDRESS], fontset, FONT_SIZE);
+	}
+
+	//random is the value the engine under test produced for Cxkk
+	void Step(uint8_t random)
+	{
+		uint16_t opcode = (memory[pc] << 8u) | memory[(pc + 1) & 0xFFFu];
+		pc = (pc + 2) & 0xFFFu;
+
+		uint8_t& vx = registers[X(opcode)];
+		uint8_t& vy = registers[Y(opcode)];
+		uint8_t& vf = registers[0xF];
+
+		switch (I(opcode))
+		{
+		case 0x0:
+			if ((opcode & 0xF) == 0x0)
+			{
+				memset(video, 0, sizeof(video));
+			}
+			else if ((opcode & 0xF) == 0xE && sp > 0)
+			{
+				pc = stack[--sp];
+			}
+			else if ((opcode & 0xF) == 0xE)
+			{
+				faults |= FAULT_STACK_UNDERFLOW;
+			}
+			else
+			{
+				faults |= FAULT_INVALID_OPCODE;
+			}
+			break;
+		case 0x1: pc = NNN(opcode); break;
+		case 0x2:
+			if (sp < STACK_LEVELS)
+			{
+				stack[sp++] = pc;
+				pc = NNN(opcode);
+			}
+			else
+			{
+				faults |= FAULT_STACK_OVERFLOW;
+			}
+			break;
+		case 0x3: if (vx == KK(opcode)) pc = (pc + 2) & 0xFFFu; break;
+		case 0x4: if (vx != KK(opcode)) pc = (pc + 2) & 0xFFFu; break;
+		case 0x5: if (vx == vy) pc = (pc + 2) & 0xFFFu; break;
+		case 0x6: vx = KK(opcode); break;
+		case 0x7: vx += KK(opcode); break;
+		case 0x8:
+		{
+			uint8_t x = vx;
+			uint8_t y = vy;
+			switch (opcode & 0xF)
+			{
+			case 0x0: vx = y; break;
+			case 0x1: vx = x | y; break;
+			case 0x2: vx = x & y; break;
+			case 0x3: vx = x ^ y; break;
+			case 0x4: vx = x + y; vf = x + y > 0xFF; break;
+			case 0x5: vx = x - y; vf = x >= y; break;
+			case 0x6: vx = x >> 1; vf = x & 1; break;
+			case 0x7: vx = y - x; vf = y >= x; break;
+			case 0xE: vx = x << 1; vf = x >> 7; break;
+			default: faults |= FAULT_INVALID_OPCODE; break;
+			}
+		} break;
+		case 0x9: if (vx != vy) pc = (pc + 2) & 0xFFFu; break;
+		case 0xA: index = NNN(opcode); break;
+		case 0xB: pc = (NNN(opcode) + registers[0]) & 0xFFFu; break;
+		case 0xC: vx = random; break;
+		case 0xD:
+		{
+			unsigned int x0 = vx % VIDEO_WIDTH;
+			unsigned int y0 = vy % VIDEO_HEIGHT;
+			vf = 0;
+			//only the rows on screen are read
+			if (index + std::min(opcode & 0xFu, VIDEO_HEIGHT - y0) > MEMORY_MAX)
+			{
+				faults |= FAULT_ADDRESS_WRAP;
+			}
+			for (unsigned int row = 0; row < (opcode & 0xFu); ++row)
+			{
+				for (unsigned int col = 0; col < 8; ++col)
+				{
+					if (x0 + col >= VIDEO_WIDTH || y0 + row >= VIDEO_HEIGHT)
+					{
+						continue;
+					}
+					if (memory[(index + row) & 0xFFFu] & (0x80u >> col))
+					{
+						uint32_t& pixel = video[(y0 + row) * VIDEO_WIDTH + x0 + col];
+						vf |= pixel == 0xFFFFFFFF;
+						pixel ^= 0xFFFFFFFF;
+					}
+				}
+			}
+		} break;
+		case 0xE:
+			//decoded on the low nibble only, like the interpreter's tableE
+			if ((opcode & 0xF) == 0xE && keypad[vx & 0xF]) pc = (pc + 2) & 0xFFFu;
+			if ((opcode & 0xF) == 0x1 && !keypad[vx & 0xF]) pc = (pc + 2) & 0xFFFu;
+			if ((opcode & 0xF) != 0xE && (opcode & 0xF) != 0x1) faults |= FAULT_INVALID_OPCODE;
+			break;
+		case 0xF:
+			if ((KK(opcode) == 0x33 && index + 3u > MEMORY_MAX) || ((KK(opcode) == 0x55 || KK(opcode) == 0x65) && index + X(opcode) + 1u > MEMORY_MAX))
+			{
+				faults |= FAULT_ADDRESS_WRAP;
+			}
+			switch (KK(opcode))
+			{
+			case 0x07: vx = delayTimer; break;
+			case 0x0A:
+			{
+				unsigned int key = 0;
+				while (key < KEY_COUNT && !keypad[key])
+				{
+					++key;
+				}
+				if (key < KEY_COUNT)
+				{
+					vx = key;
+				}
+				else
+				{
+					pc = (pc - 2) & 0xFFFu;
+				}
+			} break;
+			case 0x15: delayTimer = vx; break;
+			case 0x18: soundTimer = vx; break;
+			case 0x1E: index += vx; break;
+			case 0x29: index = FONT_START_ADDRESS + 5 * vx; break;
+			case 0x33:
+				memory[index & 0xFFFu] = vx / 100;
+				memory[(index + 1) & 0xFFFu] = vx / 10 % 10;
+				memory[(index + 2) & 0xFFFu] = vx % 10;
+				break;
+			case 0x55:
+				for (unsigned int i = 0; i <= X(opcode); ++i) memory[(index + i) & 0xFFFu] = registers[i];
+				break;
+			case 0x65:
+				for (unsigned int i = 0; i <= X(opcode); ++i) registers[i] = memory[(index + i) & 0xFFFu];
+				break;
+			default:
+				faults |= FAULT_INVALID_OPCODE;
+				break;
+			}
+			break;
+		}
+
+		if (delayTimer > 0) --delayTimer;
+		if (soundTimer > 0) --soundTimer;
+	}
+};
+
+struct Chip8Fuzzer
+{
+	static void Fail(const char* what, unsigned int step, uint16_t opcode)
+	{
+		fprintf(stderr, "fuzz_chip8: %s after instruction %u (opcode %04X)\n", what, step, opcode);
+		abort();
+	}
+
+	static void Run(const uint8_t* data, size_t size)
+	{
+		uint16_t keys[KEY_STEPS]{};
+		for (unsigned int i = 0; i < KEY_STEPS && i * 2 + 1 < size; ++i)
+		{
+			keys[i] = data[i * 2] | (data[i * 2 + 1] << 8);
+		}
+		size_t header = KEY_STEPS * 2;
+		const uint8_t* image = size > header ? data + header : data;
+		size_t imageSize = size > header ? size - header : 0;
+
+		static Chip8 engine;
+		static RefMachine reference;
+
+		//start both from identical power-on state
+		engine.Reset();
+		reference = RefMachine();
+		engine.LoadROM(image, imageSize);
+		memcpy(&reference.memory[START_ADDRESS], image, imageSize > MEMORY_MAX - START_ADDRESS ? MEMORY_MAX - START_ADDRESS : imageSize);
+		reference.faults = imageSize > MEMORY_MAX - START_ADDRESS ? FAULT_ROM_SIZE : 0;
+
+		for (unsigned int step = 0; step < MAX_INSTRUCTIONS; ++step)
+		{
+			if (step % STEP_INSTRUCTIONS == 0)
+			{
+				uint16_t mask = keys[step / STEP_INSTRUCTIONS];
+				for (unsigned int key = 0; key < KEY_COUNT; ++key)
+				{
+					engine.keypad[key] = reference.keypad[key] = (mask >> key) & 1;
+				}
+			}
+
+			uint16_t opcode = (engine.memory[engine.pc] << 8u) | engine.memory[(engine.pc + 1) & 0xFFFu];
+			engine.Cycle();
+
+			//Cxkk is the one nondeterministic instruction - it must stay within kk
+			uint8_t random = engine.registers[X(opcode)];
+			if (I(opcode) == 0xC && (random & ~KK(opcode)) != 0)
+			{
+				Fail("Cxkk result outside kk mask", step, opcode);
+			}
+			reference.Step(random);
+
+			if (engine.pc >= MEMORY_MAX)
+			{
+				Fail("pc out of range", step, opcode);
+			}
+			if (engine.sp > STACK_LEVELS)
+			{
+				Fail("sp out of range", step, opcode);
+			}
+			if (memcmp(engine.registers, reference.registers, sizeof(reference.registers)) != 0)
+			{
+				Fail("registers differ", step, opcode);
+			}
+			if (engine.pc != reference.pc || engine.index != reference.index || engine.sp != reference.sp)
+			{
+				Fail("pc/I/sp differ", step, opcode);
+			}
+			if (memcmp(engine.stack, reference.stack, sizeof(reference.stack)) != 0)
+			{
+				Fail("stack differs", step, opcode);
+			}
+			if (engine.delayTimer != reference.delayTimer || engine.soundTimer != reference.soundTimer)
+			{
+				Fail("timers differ", step, opcode);
+			}
+			if (engine.faults != reference.faults)
+			{
+				Fail("faults differ", step, opcode);
+			}
+		}
+
+		if (memcmp(engine.memory, reference.memory, sizeof(reference.memory)) != 0)
+		{
+			Fail("memory differs", MAX_INSTRUCTIONS, 0);
+		}
+		if (memcmp(engine.video, reference.video, sizeof(reference.video)) != 0)
+		{
+			Fail("video differs", MAX_INSTRUCTIONS, 0);
+		}
+
+		//hostile state: pc, I and sp from the first keypad masks
+		Chip8State state;
+		engine.SaveState(state);
+		state.pc = keys[0];
+		state.index = keys[1];
+		state.sp = static_cast<uint8_t>(keys[2]);
+		engine.LoadState(state);
+		for (unsigned int step = 0; step < STEP_INSTRUCTIONS; ++step)
+		{
+			engine.Cycle();
+			//sp is clamped by the first call or return, left as it is until then
+			if (engine.pc >= MEMORY_MAX || (engine.sp > STACK_LEVELS && engine.sp != state.sp))
+			{
+				Fail("hostile state escaped", step, engine.opcode);
+			}
+		}
+	}
+};
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+	Chip8Fuzzer::Run(data, size);
+	return 0;
+}
+
+#ifdef CHIP8_FUZZ_STANDALONE
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <string>
+
+int main(int argc, char** argv)
+{
+	//replay files
+	if (argc > 1 && std::string(argv[1]).find_first_not_of("0123456789") != std::string::npos)
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			std::ifstream file(argv[i], std::ios::binary);
+			std::vector<uint8_t> input((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			LLVMFuzzerTestOneInput(input.data(), input.size());
+		}
+		return 0;
+	}
+
+	unsigned long iterations = argc > 1 ? std::stoul(argv[1]) : 10000;
+	unsigned long seed = argc > 2 ? std::stoul(argv[2]) : 1;
+	std::mt19937 rng(seed);
+	std::vector<uint8_t> input;
+
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned long i = 0; i < iterations; ++i)
+	{
+		input.resize(KEY_STEPS * 2 + rng() % (MEMORY_MAX - START_ADDRESS + 64));
+		for (uint8_t& byte : input)
+		{
+			byte = static_cast<uint8_t>(rng());
+		}
+		LLVMFuzzerTestOneInput(input.data(), input.size());
+	}
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	printf("%lu inputs, %.0f exec/s\n", iterations, iterations / seconds);
+	return 0;
+}
+#endif
@@ -0,0 +1,316 @@
+//Scripted GDB remote protocol client, run against a GdbStub in the same process
+//usage: gdbclient [--port <n>]
+//
+//	--port		loopback TCP port for the stub (default 7411)
+//
+//Starts a machine on a small built-in program with the stub listening, drives it
+//like the main loop does (Cycle() until a client attaches, Service() after), and
+//talks to it over a real socket: attach, g/G/p/P, m/M with the out of range,
+//malformed and largest cases, Z0/Z2/Z3 breakpoints and watchpoints, c/s, an interrupt and
+//detach. Prints one line per check; exit code 1 if any fails.
+//
+//The program loops over V0 += 1, I = 0x300, Fx55 and Fx65, so it writes and then
+//reads 0x300 on every pass.
+
+#include "../Chip8.h"
+#include "../GdbStub.h"
+#include "../Socket.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+//longest a reply may take; stops of the looping program come within microseconds
+const int REPLY_TIMEOUT_MS = 2000;
+
+//0x200 LD V0, 5 / 0x202 ADD V0, 1 / 0x204 LD I, 0x300 / 0x206 LD [I], V0 / 0x208 LD V0, [I] / 0x20A JP 0x202
+static const uint8_t PROGRAM[] = { 0x60, 0x05, 0x70, 0x01, 0xA3, 0x00, 0xF0, 0x55, 0xF0, 0x65, 0x12, 0x02 };
+
+static unsigned int failures = 0;
+
+static void Check(bool ok, const std::string& what, const std::string& got = "")
+{
+	printf("%-44s %s%s%s\n", what.c_str(), ok ? "ok" : "FAILED", ok || got.empty() ? "" : " - got ", ok ? "" : got.c_str());
+	failures += !ok;
+}
+
+class Client
+{
+public:
+	explicit Client(int fd) : fd(fd) {}
+	~Client() { CloseSocket(fd); }
+
+	void Send(const std::string& payload)
+	{
+		uint8_t sum = 0;
+		for (char c : payload)
+		{
+			sum += static_cast<uint8_t>(c);
+		}
+		char checksum[4];
+		snprintf(checksum, sizeof(checksum), "#%02x", sum);
+		std::string framed = "$" + payload + checksum;
+		SendBytes(fd, framed.data(), framed.size());
+	}
+
+	void Interrupt()
+	{
+		SendBytes(fd, "\x03", 1);
+	}
+
+	//the next packet's payload, acked; false on timeout, a bad checksum or a closed socket
+	bool Receive(std::string& payload, int timeoutMs = REPLY_TIMEOUT_MS)
+	{
+		auto deadline = Clock::now() + std::chrono::milliseconds(timeoutMs);
+		for (;;)
+		{
+			size_t start = buffer.find('$');
+			size_t hash = start == std::string::npos ? start : buffer.find('#', start);
+			if (hash != std::string::npos && hash + 2 < buffer.size())
+			{
+				payload = buffer.substr(start + 1, hash - start - 1);
+				uint8_t sum = 0;
+				for (char c : payload)
+				{
+					sum += static_cast<uint8_t>(c);
+				}
+				bool valid = std::stoul(buffer.substr(hash + 1, 2), nullptr, 16) == sum;
+				buffer.erase(0, hash + 3);
+				SendBytes(fd, valid ? "+" : "-", 1);
+				return valid;
+			}
+
+			int remaining = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count());
+			if (remaining <= 0 || !Read(remaining))
+			{
+				return false;
+			}
+		}
+	}
+
+	std::string Transact(const std::string& payload)
+	{
+		Send(payload);
+		std::string reply;
+		return Receive(reply) ? reply : "<no reply>";
+	}
+
+	//true once the stub has closed the connection
+	bool Closed()
+	{
+		auto deadline = Clock::now() + std::chrono::milliseconds(REPLY_TIMEOUT_MS);
+		while (Clock::now() < deadline)
+		{
+			pollfd socketFd{};
+			socketFd.fd = fd;
+			socketFd.events = POLLIN;
+			if (poll(&socketFd, 1, 50) > 0)
+			{
+				char chunk[256];
+				if (recv(fd, chunk, sizeof(chunk), 0) <= 0)
+				{
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+private:
+	int fd;
+	std::string buffer;
+
+	bool Read(int timeoutMs)
+	{
+		pollfd socketFd{};
+		socketFd.fd = fd;
+		socketFd.events = POLLIN;
+		if (poll(&socketFd, 1, timeoutMs) <= 0)
+		{
+			return false;
+		}
+		char chunk[4096];
+		int received = static_cast<int>(recv(fd, chunk, sizeof(chunk), 0));
+		if (received <= 0)
+		{
+			return false;
+		}
+		buffer.append(chunk, received);
+		return true;
+	}
+};
+
+//pc from a p11 reply, little endian
+static unsigned int ParsePc(const std::string& hex)
+{
+	return hex.size() == 4 ? static_cast<unsigned int>(std::stoul(hex.substr(2, 2) + hex.substr(0, 2), nullptr, 16)) : 0xFFFFu;
+}
+
+int main(int argc, char** argv)
+{
+	unsigned short port = 7411;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--port" && i + 1 < argc) port = static_cast<unsigned short>(std::stoul(argv[++i]));
+		else
+		{
+			std::cerr << "unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	Chip8 chip8;
+	chip8.Reset(1);
+	chip8.LoadROM(PROGRAM, sizeof(PROGRAM));
+
+	GdbStub stub(chip8);
+	if (!stub.ListenTcp(port))
+	{
+		std::cerr << "unable to listen on port " << port << std::endl;
+		return 1;
+	}
+
+	//the main loop's split: the stub only sees the machine through Service() once attached
+	std::atomic<bool> done{ false };
+	std::atomic<uint64_t> detachedCycles{ 0 };
+	std::thread emulation([&]
+	{
+		while (!done)
+		{
+			if (stub.Attached())
+			{
+				stub.Service();
+			}
+			else
+			{
+				chip8.Cycle();
+				++detachedCycles;
+			}
+			std::this_thread::yield();
+		}
+	});
+
+	{
+		Client client(ConnectTcpSocket(port));
+		std::string reply;
+
+		//attach
+		client.Send("qSupported");
+		Check(client.Receive(reply) && reply.find("QStartNoAckMode+") != std::string::npos, "attach: qSupported", reply);
+		reply = client.Transact("?");
+		Check(reply == "S02", "attach: machine halted", reply);
+
+		//registers
+		std::string registers = client.Transact("g");
+		Check(registers.size() == (REGISTER_COUNT + 2 * 2 + 1) * 2, "g: every register", registers);
+		std::string written = registers;
+		written.replace(2, 2, "ab");
+		Check(client.Transact("G" + written) == "OK", "G: write all registers");
+		reply = client.Transact("p1");
+		Check(reply == "ab", "G then p1: V1 written", reply);
+		Check(client.Transact("P2=cd") == "OK", "P2: write V2");
+		reply = client.Transact("p2");
+		Check(reply == "cd", "p2: V2 read back", reply);
+		Check(client.Transact("P11=0202") == "OK", "P11: pc to 0x202");
+		reply = client.Transact("p11");
+		Check(ParsePc(reply) == 0x202, "p11: pc read back", reply);
+		reply = client.Transact("p40");
+		Check(reply == "E01", "p40: no such register", reply);
+		reply = client.Transact("P2=zz");
+		Check(reply == "E01", "P2 with a bad hex byte", reply);
+		reply = client.Transact("p2");
+		Check(reply == "cd", "bad P wrote nothing", reply);
+
+		//memory
+		reply = client.Transact("m200,4");
+		Check(reply == "60057001", "m200,4: program bytes", reply);
+		Check(client.Transact("M300,2:beef") == "OK", "M300,2: write");
+		reply = client.Transact("m300,2");
+		Check(reply == "beef", "m300,2: read back", reply);
+		reply = client.Transact("mfffffffffffffff0,10");
+		Check(reply == "E01", "m with an address that wraps", reply);
+		reply = client.Transact("mfff,2");
+		Check(reply == "E01", "m past the end of memory", reply);
+		reply = client.Transact("m0,ffffffffffffffff");
+		Check(reply == "E01", "m with a length that wraps", reply);
+		reply = client.Transact("Mfffffffffffffff0,10:00000000000000000000000000000000");
+		Check(reply == "E01", "M with an address that wraps", reply);
+		reply = client.Transact("M300,2:zz00");
+		Check(reply == "E01", "M with a bad hex byte", reply);
+		reply = client.Transact("M300,2:00zz");
+		Check(reply == "E01", "M with a bad second byte", reply);
+		reply = client.Transact("m300,2");
+		Check(reply == "beef", "bad M wrote nothing", reply);
+
+		//the largest packet the stub advertises, filling its input buffer exactly
+		std::string header = "M0400,7fb:";
+		std::string largest = header + std::string(GDB_PACKET_SIZE - header.size(), 'a');
+		reply = client.Transact(largest);
+		Check(largest.size() == GDB_PACKET_SIZE && reply == "OK", "M of PacketSize bytes", reply);
+		reply = client.Transact("mbf9,3");
+		Check(reply == "aaaa00", "M of PacketSize bytes: read back", reply);
+
+		//step
+		client.Send("s");
+		Check(client.Receive(reply) && reply == "S05", "s: stop reply", reply);
+		reply = client.Transact("p11");
+		Check(ParsePc(reply) == 0x204, "s: one instruction", reply);
+
+		//breakpoint
+		Check(client.Transact("Z0,20a,2") == "OK", "Z0: breakpoint at 0x20A");
+		client.Send("c");
+		Check(client.Receive(reply) && reply == "S05", "c: stops at the breakpoint", reply);
+		reply = client.Transact("p11");
+		Check(ParsePc(reply) == 0x20A, "c: pc at the breakpoint", reply);
+		Check(client.Transact("z0,20a,2") == "OK", "z0: breakpoint removed");
+
+		//a read and a write watchpoint on one address; removing one keeps the other
+		Check(client.Transact("Z2,300,1") == "OK", "Z2: write watchpoint on 0x300");
+		Check(client.Transact("Z3,300,1") == "OK", "Z3: read watchpoint on 0x300");
+		Check(client.Transact("z3,300,1") == "OK", "z3: read watchpoint removed");
+		client.Send("c");
+		Check(client.Receive(reply) && reply == "T05watch:300;", "c: write watchpoint kept", reply);
+		Check(client.Transact("z2,300,1") == "OK", "z2: write watchpoint removed");
+		Check(client.Transact("Z3,300,1") == "OK", "Z3: read watchpoint again");
+		client.Send("c");
+		Check(client.Receive(reply) && reply == "T05rwatch:300;", "c: read watchpoint fires alone", reply);
+		Check(client.Transact("z3,300,1") == "OK", "z3: read watchpoint removed");
+
+		//an unbounded length is clamped to memory rather than looped over
+		auto start = Clock::now();
+		Check(client.Transact("Z2,0,ffffffff") == "OK", "Z2 with a 4 GiB length");
+		Check(client.Transact("z2,0,ffffffff") == "OK", "z2 with a 4 GiB length");
+		Check(Clock::now() - start < std::chrono::milliseconds(500), "huge watchpoints clamped");
+
+		//interrupt a free run
+		client.Send("c");
+		Check(!client.Receive(reply, 100), "c: runs with nothing to stop it", reply);
+		client.Interrupt();
+		Check(client.Receive(reply) && reply == "S02", "interrupt: stop reply", reply);
+
+		//detach - the machine carries on by itself
+		Check(client.Transact("D") == "OK", "D: detach");
+		Check(client.Closed(), "D: connection closed");
+	}
+
+	auto deadline = Clock::now() + std::chrono::milliseconds(REPLY_TIMEOUT_MS);
+	while (stub.Attached() && Clock::now() < deadline)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	uint64_t before = detachedCycles;
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	Check(!stub.Attached() && detachedCycles > before, "detached: machine runs on");
+
+	done = true;
+	emulation.join();
+
+	printf("%u failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}
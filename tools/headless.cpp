@@ -0,0 +1,160 @@
+//Runs several instances of a ROM without a window and streams their displays
+//usage: headless <rom> [--instances <n>] [--ipf <n>] [--timing <fast|vip>] [--seconds <n>] [--serve <port|path>]
+//		[--metrics <port>] [--metrics-json <file>] [--watch <addr[:name]>]...
+//
+//	--instances	machines to run, one thread and one stream channel each (default 4)
+//	--ipf		instructions per 60 Hz frame (default 10)
+//	--timing	vip runs each frame with COSMAC VIP instruction timing instead of --ipf
+//	--seconds	stop after this long, 0 runs until killed (default 0)
+//	--serve		FrameServer on 127.0.0.1:port or a Unix domain socket path
+//	--metrics	Prometheus metrics of every instance on http://127.0.0.1:port/metrics
+//	--metrics-json	append a JSON line of metrics every second
+//	--watch		export a byte of memory, e.g. a score found with memscan, with the
+//				metrics (chip8_memory gauge, "memory" in JSON); up to 8
+//
+//Watch with: viewer <port|path> <channel>
+
+#include "../Chip8.h"
+#include "../FrameServer.h"
+#include "../Metrics.h"
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: headless <rom> [--instances <n>] [--ipf <n>] [--timing <fast|vip>] [--seconds <n>] [--serve <port|path>]"
+			" [--metrics <port>] [--metrics-json <file>] [--watch <addr[:name]>]..." << std::endl;
+		return 1;
+	}
+
+	unsigned int instances = 4;
+	unsigned int ipf = 10;
+	unsigned int seconds = 0;
+	std::string serveAddress;
+	bool vipTiming = false;
+	unsigned short metricsPort = 0;
+	std::string metricsPath;
+	Metrics metrics;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--instances" && i + 1 < argc) instances = std::max(1ul, std::stoul(argv[++i]));
+		else if (arg == "--ipf" && i + 1 < argc) ipf = std::stoul(argv[++i]);
+		else if (arg == "--timing" && i + 1 < argc) vipTiming = std::string(argv[++i]) == "vip";
+		else if (arg == "--seconds" && i + 1 < argc) seconds = std::stoul(argv[++i]);
+		else if (arg == "--serve" && i + 1 < argc) serveAddress = argv[++i];
+		else if (arg == "--metrics" && i + 1 < argc) metricsPort = static_cast<unsigned short>(std::stoul(argv[++i]));
+		else if (arg == "--metrics-json" && i + 1 < argc) metricsPath = argv[++i];
+		else if (arg == "--watch" && i + 1 < argc)
+		{
+			MemoryWatch watch;
+			if (!ParseWatch(argv[++i], watch) || !metrics.Watch(watch))
+			{
+				std::cerr << "bad or too many watches: " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		else
+		{
+			std::cerr << "unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	//channels are addressed by a single byte
+	instances = std::min(instances, 256u);
+
+	std::unique_ptr<FrameServer> server;
+	if (!serveAddress.empty())
+	{
+		server = std::make_unique<FrameServer>(instances);
+		bool isPort = serveAddress.find_first_not_of("0123456789") == std::string::npos;
+		bool listening = isPort ? server->ListenTcp(static_cast<unsigned short>(std::stoi(serveAddress)))
+			: server->ListenUnix(serveAddress.c_str());
+		if (!listening)
+		{
+			std::cerr << "unable to listen on " << serveAddress << ": " << strerror(errno) << std::endl;
+			return 1;
+		}
+	}
+
+	if ((metricsPort != 0 || !metricsPath.empty()) && !metrics.Start(metricsPort, metricsPath))
+	{
+		std::cerr << "unable to export metrics" << std::endl;
+		return 1;
+	}
+
+	const auto framePeriod = std::chrono::microseconds(1000000 / 60);
+	const auto end = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+
+	std::vector<std::thread> threads;
+	for (unsigned int instance = 0; instance < instances; ++instance)
+	{
+		threads.emplace_back([&, instance]
+		{
+			Chip8 chip8;
+			//one seed, a stream per instance: the same run whichever thread starts first
+			chip8.Reset(1, instance);
+			chip8.LoadROM(argv[1]);
+			InstanceMetrics& counters = metrics.Register(std::to_string(instance));
+
+			auto nextFrame = std::chrono::steady_clock::now();
+			auto lastFrame = nextFrame;
+			while (seconds == 0 || nextFrame < end)
+			{
+				if (vipTiming)
+				{
+					chip8.RunFrame();
+				}
+				//idle in Fx0A with the timers run down, nothing would change
+				else if (!chip8.Idle())
+				{
+					for (unsigned int i = 0; i < ipf; ++i)
+					{
+						chip8.Cycle();
+					}
+				}
+
+				//never waits - a frame the server has no room for is dropped
+				if (server && !server->Publish(instance, chip8.video))
+				{
+					counters.droppedFrames.Add();
+				}
+
+				auto now = std::chrono::steady_clock::now();
+				counters.RecordFrame(static_cast<uint32_t>(std::chrono::duration_cast<std::chrono::microseconds>(now - lastFrame).count()));
+				counters.Publish(chip8.Stats());
+				counters.PublishMemory(chip8.Memory(), metrics.Watches());
+				lastFrame = now;
+
+				nextFrame += framePeriod;
+				std::this_thread::sleep_until(nextFrame);
+			}
+		});
+	}
+
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+
+	if (server)
+	{
+		for (unsigned int channel = 0; channel < server->Channels(); ++channel)
+		{
+			std::cout << "channel " << channel << ": " << server->Dropped(channel) << " frames dropped" << std::endl;
+		}
+	}
+	return 0;
+}
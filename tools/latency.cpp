@@ -0,0 +1,127 @@
+//Input-to-display latency with run-ahead off and on
+//usage: latency [rom] [--key <hex>] [--ipf <n>] [--timing <fast|vip>] [--max-runahead <n>] [--press <frame>]
+//
+//	rom				default roms/bench/input.ch8 (waits on the delay timer, then draws
+//					while key 0 is held - the usual shape of a game's input loop)
+//	--key			key pressed (default 0)
+//	--ipf			instructions per 60 Hz frame (default 10)
+//	--timing		vip runs frames with COSMAC VIP instruction timing instead of --ipf
+//	--max-runahead	largest run-ahead measured (default 4)
+//	--press			frame at which the key goes down (default 30)
+//
+//For each run-ahead setting the machine is run with and without the key press;
+//the latency is the number of presented frames between the press and the first
+//presented frame that differs. Emulated frames, so the numbers are exact and
+//independent of the host; add the display pipeline's own delay for wall time.
+
+#include "../Chip8.h"
+#include "../RunAhead.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+
+//one 60 Hz frame of emulation
+static void RunFrame(Chip8& chip8, unsigned int ipf, bool vipTiming)
+{
+	if (vipTiming)
+	{
+		chip8.RunFrame();
+		return;
+	}
+
+	for (unsigned int i = 0; i < ipf; ++i)
+	{
+		chip8.Cycle();
+	}
+}
+
+//frames from the press until the presented display changes, -1 if it never does within limit
+static int MeasureLatency(const char* rom, unsigned int key, unsigned int ipf, bool vipTiming, unsigned int runAheadFrames, unsigned int pressFrame)
+{
+	const unsigned int LIMIT = 600;
+
+	Chip8 pressed;
+	pressed.Reset(1);
+	pressed.LoadROM(rom);
+
+	for (unsigned int frame = 0; frame < pressFrame; ++frame)
+	{
+		RunFrame(pressed, ipf, vipTiming);
+	}
+
+	//identical machine that never sees the press
+	Chip8 idle = pressed;
+	pressed.keypad[key] = true;
+
+	RunAhead pressedAhead(runAheadFrames);
+	RunAhead idleAhead(runAheadFrames);
+	pressedAhead.SetTimed(vipTiming);
+	idleAhead.SetTimed(vipTiming);
+
+	for (unsigned int frame = 0; frame < LIMIT; ++frame)
+	{
+		RunFrame(pressed, ipf, vipTiming);
+		RunFrame(idle, ipf, vipTiming);
+
+		const uint32_t* shown = pressedAhead.Speculate(pressed, ipf);
+		const uint32_t* baseline = idleAhead.Speculate(idle, ipf);
+		if (memcmp(shown, baseline, sizeof(pressed.video)) != 0)
+		{
+			//the first presented frame is the one at the end of the press frame
+			return static_cast<int>(frame);
+		}
+	}
+
+	return -1;
+}
+
+int main(int argc, char** argv)
+{
+	std::string rom = "roms/bench/input.ch8";
+	unsigned int key = 0;
+	unsigned int ipf = 10;
+	unsigned int maxRunAhead = 4;
+	unsigned int pressFrame = 30;
+	bool vipTiming = false;
+
+	int first = 1;
+	if (argc > 1 && argv[1][0] != '-')
+	{
+		rom = argv[1];
+		first = 2;
+	}
+
+	for (int i = first; i + 1 < argc; i += 2)
+	{
+		std::string arg = argv[i];
+		if (arg == "--key") key = std::stoul(argv[i + 1], nullptr, 16) & 0xF;
+		else if (arg == "--ipf") ipf = std::stoul(argv[i + 1]);
+		else if (arg == "--timing") vipTiming = std::string(argv[i + 1]) == "vip";
+		else if (arg == "--max-runahead") maxRunAhead = std::stoul(argv[i + 1]);
+		else if (arg == "--press") pressFrame = std::stoul(argv[i + 1]);
+		else
+		{
+			std::cerr << "unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	printf("%-10s %8s %10s\n", "runahead", "frames", "ms");
+	for (unsigned int frames = 0; frames <= maxRunAhead; ++frames)
+	{
+		int latency = MeasureLatency(rom.c_str(), key, ipf, vipTiming, frames, pressFrame);
+		if (latency < 0)
+		{
+			printf("%-10u %8s %10s\n", frames, "-", "no response");
+		}
+		else
+		{
+			printf("%-10u %8d %10.1f\n", frames, latency, latency * 1000.0 / 60);
+		}
+	}
+
+	return 0;
+}
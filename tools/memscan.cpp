@@ -0,0 +1,187 @@
+//Memory search across many instances of a ROM, to find where it keeps a score, lives or level
+//usage: memscan <rom> [--instances <n>] [--ipf <n>] [--quirks <name>]
+//
+//	--instances	machines of the ROM, one Cxkk stream each (default 10000)
+//	--ipf		instructions per 60 Hz frame (default 10)
+//
+//Commands, one per line on stdin; numbers are hex:
+//	run <frames> [keys]	run every machine, keys a mask of the keys held (bit n is key n)
+//	snap				snapshot every machine's memory
+//	eq <value>			keep addresses holding value
+//	changed, unchanged	keep addresses that changed, or did not, since the snapshot before
+//	inc [k], dec [k]	keep addresses that went up, or down, by k (by anything without k)
+//	list				candidates with instance 0's value, and as --watch arguments
+//	reset				every address a candidate again
+//	q
+//
+//Every narrowing command takes a snapshot first, so "snap" is only needed for the
+//baseline. An address survives only if it behaves the same way in every instance,
+//so the Cxkk streams rule out bytes that only looked right by chance. For a score
+//that goes up when key 5 is pressed:
+//	run 3c / snap / run 2 20 / run 3c / inc / run 3c / unchanged / run 2 20 / run 3c / inc / list
+//The addresses found go to headless --watch and the debugger's disp command.
+
+#include "../Chip8Pool.h"
+#include "../MemoryScanner.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+//candidates listed at most
+const size_t LIST_LIMIT = 32;
+//headless exports up to METRICS_WATCHES bytes
+const size_t WATCH_LIMIT = 8;
+
+static double Ms(Clock::time_point start)
+{
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: memscan <rom> [--instances <n>] [--ipf <n>] [--quirks <name>]" << std::endl;
+		return 1;
+	}
+
+	unsigned int instances = 10000;
+	unsigned int ipf = 10;
+	Quirks quirks = QUIRKS_MODERN;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--instances" && i + 1 < argc) instances = std::max(1ul, std::stoul(argv[++i]));
+		else if (arg == "--ipf" && i + 1 < argc) ipf = std::stoul(argv[++i]);
+		else if (arg == "--quirks" && i + 1 < argc)
+		{
+			if (!QuirksByName(argv[++i], quirks))
+			{
+				std::cerr << "unknown quirks profile " << argv[i] << std::endl;
+				return 1;
+			}
+		}
+		else
+		{
+			std::cerr << "unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	std::ifstream file(argv[1], std::ios::binary);
+	std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (rom.empty())
+	{
+		std::cerr << "unable to read " << argv[1] << std::endl;
+		return 1;
+	}
+
+	Chip8Pool pool(instances);
+	std::vector<Chip8*> machines;
+	for (unsigned int i = 0; i < instances; ++i)
+	{
+		Chip8* chip8 = pool.Acquire(1, i);
+		chip8->SetQuirks(quirks);
+		chip8->LoadROM(rom.data(), rom.size());
+		machines.push_back(chip8);
+	}
+
+	MemoryScanner scanner(instances);
+	printf("%u instances of %s, %u instructions per frame\n", instances, argv[1], ipf);
+
+	std::string line;
+	while (std::getline(std::cin, line))
+	{
+		std::istringstream input(line);
+		std::string command;
+		input >> command >> std::hex;
+
+		if (command == "run")
+		{
+			unsigned int frames = 1;
+			unsigned int keys = 0;
+			input >> frames >> keys;
+
+			auto start = Clock::now();
+			for (Chip8* chip8 : machines)
+			{
+				for (unsigned int key = 0; key < KEY_COUNT; ++key)
+				{
+					chip8->keypad[key] = (keys >> key) & 1u;
+				}
+				for (unsigned int i = 0; i < frames * ipf; ++i)
+				{
+					chip8->Cycle();
+				}
+			}
+			printf("ran %u frames in %.1f ms\n", frames, Ms(start));
+		}
+		else if (command == "snap")
+		{
+			auto start = Clock::now();
+			scanner.Snapshot(machines.data());
+			printf("snapshot in %.2f ms\n", Ms(start));
+		}
+		else if (command == "eq" || command == "changed" || command == "unchanged" || command == "inc" || command == "dec")
+		{
+			unsigned int value = 0;
+			input >> value;
+
+			ScanPredicate predicate = command == "eq" ? ScanPredicate::Equal
+				: command == "changed" ? ScanPredicate::Changed
+				: command == "unchanged" ? ScanPredicate::Unchanged
+				: command == "inc" ? ScanPredicate::Increased : ScanPredicate::Decreased;
+
+			auto start = Clock::now();
+			scanner.Snapshot(machines.data());
+			double snapshotMs = Ms(start);
+			start = Clock::now();
+			size_t left = scanner.Narrow(predicate, static_cast<uint8_t>(value));
+			printf("snapshot %.2f ms, scan %.2f ms: %zu candidates\n", snapshotMs, Ms(start), left);
+		}
+		else if (command == "list")
+		{
+			std::vector<uint16_t> addresses = scanner.Addresses();
+			std::string watches;
+			for (size_t i = 0; i < addresses.size() && i < LIST_LIMIT; ++i)
+			{
+				char text[32];
+				snprintf(text, sizeof(text), "0x%03X", addresses[i]);
+				printf("%s = %02X\n", text, scanner.Snapshots() > 0 ? scanner.Value(0, addresses[i]) : machines[0]->Memory()[addresses[i]]);
+				watches += std::string(" --watch ") + text;
+			}
+			if (addresses.size() > LIST_LIMIT)
+			{
+				printf("... %zu more\n", addresses.size() - LIST_LIMIT);
+			}
+			if (!addresses.empty() && addresses.size() <= WATCH_LIMIT)
+			{
+				printf("headless%s\n", watches.c_str());
+			}
+		}
+		else if (command == "reset")
+		{
+			scanner.ResetCandidates();
+		}
+		else if (command == "q")
+		{
+			break;
+		}
+		else if (!command.empty())
+		{
+			printf("unknown command %s\n", command.c_str());
+		}
+		fflush(stdout);
+	}
+
+	return 0;
+}
@@ -0,0 +1,136 @@
+//Runs a batch of instances of a ROM and shows them all in one window
+//usage: mosaic <rom> [--instances <n>] [--ipf <n>] [--scale <n>]
+//
+//	--instances	machines to run (default 64)
+//	--ipf		instructions per 60 Hz frame for each machine (default 10)
+//	--scale		window pixels per atlas pixel (default: fit about 1280 wide)
+//
+//Click a tile to give it the keyboard; the focused tile has an orange frame.
+//Average upload + present time per frame is printed on exit.
+
+#include "../Chip8Pool.h"
+#include "../Mosaic.h"
+#include "../SDL_Layer.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: mosaic <rom> [--instances <n>] [--ipf <n>] [--scale <n>]" << std::endl;
+		return 1;
+	}
+
+	unsigned int instances = 64;
+	unsigned int ipf = 10;
+	int scale = 0;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--instances" && i + 1 < argc) instances = std::max(1ul, std::stoul(argv[++i]));
+		else if (arg == "--ipf" && i + 1 < argc) ipf = std::stoul(argv[++i]);
+		else if (arg == "--scale" && i + 1 < argc) scale = std::stoi(argv[++i]);
+		else
+		{
+			std::cerr << "unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	Chip8Pool pool(instances);
+	std::vector<Chip8*> machines;
+	for (unsigned int i = 0; i < instances; ++i)
+	{
+		Chip8* chip8 = pool.Acquire(1, i);
+		chip8->LoadROM(argv[1]);
+		machines.push_back(chip8);
+	}
+
+	Mosaic mosaic(instances);
+	if (scale <= 0)
+	{
+		scale = std::max(1, 1280 / mosaic.Width());
+	}
+
+	//one streaming texture the size of the whole atlas
+	SDL_Layer layer("CHIP-8 Mosaic", mosaic.Width() * scale, mosaic.Height() * scale, mosaic.Width(), mosaic.Height());
+	if (!layer.flag)
+	{
+		return 1;
+	}
+
+	unsigned int focus = 0;
+	float speed = 0;
+	bool quit = false;
+
+	const auto framePeriod = std::chrono::microseconds(1000000 / 60);
+	auto nextFrame = std::chrono::steady_clock::now();
+	double renderSeconds = 0;
+	unsigned long frames = 0;
+
+	while (!quit)
+	{
+		//keyboard goes to the focused machine only
+		quit = layer.ProcessInput(machines[focus]->keypad, &speed);
+
+		if (layer.clicked)
+		{
+			layer.clicked = false;
+
+			int width;
+			int height;
+			layer.GetWindowSize(width, height);
+			int tile = mosaic.TileAt(layer.clickX, layer.clickY, width, height);
+			if (tile >= 0 && static_cast<unsigned int>(tile) != focus)
+			{
+				//release anything held on the machine losing focus
+				std::fill(machines[focus]->keypad, machines[focus]->keypad + KEY_COUNT, false);
+				focus = tile;
+				mosaic.SetFocus(focus);
+
+				std::string title = "CHIP-8 Mosaic - instance " + std::to_string(focus);
+				layer.SetTitle(title.c_str());
+			}
+		}
+
+		for (unsigned int i = 0; i < instances; ++i)
+		{
+			for (unsigned int cycle = 0; cycle < ipf; ++cycle)
+			{
+				machines[i]->Cycle();
+			}
+			mosaic.Blit(i, machines[i]->video);
+		}
+
+		//one upload covering the tiles that changed, one copy of the whole texture
+		auto start = std::chrono::steady_clock::now();
+		SDL_Rect region;
+		if (mosaic.TakeDirty(region.x, region.y, region.w, region.h))
+		{
+			const uint32_t* first = mosaic.Atlas() + region.y * mosaic.Width() + region.x;
+			layer.Update(first, mosaic.Pitch(), region);
+		}
+		layer.Filter(mosaic.Atlas(), mosaic.Pitch(), mosaic.Width() * scale, mosaic.Height() * scale);
+		renderSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		++frames;
+
+		nextFrame += framePeriod;
+		std::this_thread::sleep_until(nextFrame);
+	}
+
+	for (Chip8* chip8 : machines)
+	{
+		pool.Release(chip8);
+	}
+
+	std::cout << instances << " instances, " << frames << " frames, "
+		<< (frames ? renderSeconds / frames * 1e6 : 0) << " us render per frame" << std::endl;
+	return 0;
+}
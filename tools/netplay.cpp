@@ -0,0 +1,274 @@
+//Headless rollback netplay test: one player of a two-process session with generated input
+//usage: netplay <rom> --player <1|2> --port <n> --peer <n> [--frames <n>] [--ipf <n|vip>] [--quirks <name>]
+//		[--delay <ms>] [--jitter <ms>] [--loss <percent>] [--seed <n>]
+//
+//	rom			default roms/bench/twoplayer.ch8 (paddles on keys 1/4 and C/D, plus a
+//				Cxkk dot per frame, so any divergence shows up at once)
+//	--player	1 presses keys 1 and 4, 2 presses C and D
+//	--port		this process's UDP port on 127.0.0.1
+//	--peer		the other process's port
+//	--frames	60 Hz frames to run (default 600)
+//	--ipf		instructions per frame, or vip for COSMAC VIP timed frames (default 10)
+//	--delay		latency added to every packet sent
+//	--jitter	up to this much more, so packets also arrive out of order
+//	--loss		percent of packets sent that are dropped
+//	--seed		input pattern; both processes must use the same (default 1)
+//
+//Run both players at once, e.g.
+//	netplay --player 1 --port 7001 --peer 7002 --delay 50 --loss 10 &
+//	netplay --player 2 --port 7002 --peer 7001 --delay 50 --loss 10
+//
+//Each player's keys are generated from the seed, so each process can also run the
+//whole session offline with both players' keys and no network. Once every remote
+//key has arrived, the networked machine must match that reference exactly. Exit
+//code 1 on a mismatch or when the peer never completes.
+
+#include "../Chip8.h"
+#include "../Netplay.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+//how long to keep acknowledging after the session is complete, for the peer's sake
+const unsigned int LINGER_MS = 300;
+//give up when neither this machine nor the peer's keys have moved on for this long
+const unsigned int PROGRESS_TIMEOUT_MS = 5000;
+
+const uint8_t PLAYER_KEYS[2][2] = { { 0x1, 0x4 }, { 0xC, 0xD } };
+
+//keypad of every frame for one player: one of its keys changes about every 8 frames
+static std::vector<uint16_t> GenerateInput(uint32_t seed, unsigned int player, unsigned int frames)
+{
+	uint32_t state = seed * 2654435761u + player + 1;
+	uint16_t keys = 0;
+	std::vector<uint16_t> input(frames);
+
+	for (unsigned int frame = 0; frame < frames; ++frame)
+	{
+		state ^= state << 13;
+		state ^= state >> 17;
+		state ^= state << 5;
+		if ((state & 7) == 0)
+		{
+			keys ^= 1u << PLAYER_KEYS[player][(state >> 3) & 1];
+		}
+		input[frame] = keys;
+	}
+	return input;
+}
+
+static void RunFrame(Chip8& chip8, unsigned int ipf)
+{
+	if (ipf == 0)
+	{
+		chip8.RunFrame();
+		return;
+	}
+
+	for (unsigned int i = 0; i < ipf; ++i)
+	{
+		chip8.Cycle();
+	}
+}
+
+//FNV-1a of everything that makes the machines the same
+static uint64_t StateHash(const Chip8& chip8)
+{
+	Chip8State state;
+	chip8.SaveState(state);
+
+	uint64_t hash = 0xCBF29CE484222325ull;
+	auto add = [&](const void* data, size_t size)
+	{
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash = (hash ^ static_cast<const uint8_t*>(data)[i]) * 0x100000001B3ull;
+		}
+	};
+	add(state.registers, sizeof(state.registers));
+	add(state.memory, sizeof(state.memory));
+	add(&state.index, sizeof(state.index));
+	add(&state.pc, sizeof(state.pc));
+	add(state.stack, sizeof(state.stack));
+	add(&state.sp, sizeof(state.sp));
+	add(&state.delayTimer, sizeof(state.delayTimer));
+	add(&state.soundTimer, sizeof(state.soundTimer));
+	add(&state.rngKey, sizeof(state.rngKey));
+	add(&state.rngDraws, sizeof(state.rngDraws));
+	add(state.video, sizeof(state.video));
+	return hash;
+}
+
+//nanoseconds per SaveState() + LoadState() pair, the fixed cost of a rollback
+static double MeasureStateCopy(Chip8& chip8)
+{
+	const unsigned int ROUNDS = 10000;
+	static Chip8State state;
+
+	auto start = Clock::now();
+	for (unsigned int i = 0; i < ROUNDS; ++i)
+	{
+		chip8.SaveState(state);
+		chip8.LoadState(state);
+	}
+	return std::chrono::duration<double, std::nano>(Clock::now() - start).count() / ROUNDS;
+}
+
+int main(int argc, char** argv)
+{
+	std::string rom = "roms/bench/twoplayer.ch8";
+	unsigned int player = 0;
+	unsigned short port = 0;
+	unsigned short peer = 0;
+	unsigned int frames = 600;
+	unsigned int ipf = 10;
+	unsigned int delay = 0;
+	unsigned int jitter = 0;
+	unsigned int loss = 0;
+	uint32_t seed = 1;
+	Quirks quirks = QUIRKS_MODERN;
+
+	int first = 1;
+	if (argc > 1 && argv[1][0] != '-')
+	{
+		rom = argv[1];
+		first = 2;
+	}
+
+	for (int i = first; i + 1 < argc; i += 2)
+	{
+		std::string arg = argv[i];
+		if (arg == "--player") player = std::stoul(argv[i + 1]);
+		else if (arg == "--port") port = static_cast<unsigned short>(std::stoul(argv[i + 1]));
+		else if (arg == "--peer") peer = static_cast<unsigned short>(std::stoul(argv[i + 1]));
+		else if (arg == "--frames") frames = std::stoul(argv[i + 1]);
+		else if (arg == "--ipf") ipf = std::string(argv[i + 1]) == "vip" ? 0 : std::max(1ul, std::stoul(argv[i + 1]));
+		else if (arg == "--delay") delay = std::stoul(argv[i + 1]);
+		else if (arg == "--jitter") jitter = std::stoul(argv[i + 1]);
+		else if (arg == "--loss") loss = std::stoul(argv[i + 1]);
+		else if (arg == "--seed") seed = std::stoul(argv[i + 1]);
+		else if (arg == "--quirks")
+		{
+			if (!QuirksByName(argv[i + 1], quirks))
+			{
+				std::cerr << "unknown quirks profile " << argv[i + 1] << std::endl;
+				return 1;
+			}
+		}
+		else
+		{
+			std::cerr << "unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	if ((player != 1 && player != 2) || port == 0 || peer == 0)
+	{
+		std::cerr << "usage: netplay <rom> --player <1|2> --port <n> --peer <n> [--frames <n>] [--ipf <n|vip>] [--quirks <name>]\n"
+			"\t[--delay <ms>] [--jitter <ms>] [--loss <percent>] [--seed <n>]" << std::endl;
+		return 1;
+	}
+
+	std::vector<uint16_t> input[2] = { GenerateInput(seed, 0, frames), GenerateInput(seed, 1, frames) };
+	const std::vector<uint16_t>& local = input[player - 1];
+
+	//the offline reference: both players on one keypad, no network
+	Chip8 reference;
+	reference.Reset(NETPLAY_SEED);
+	reference.SetQuirks(quirks);
+	reference.LoadROM(rom.c_str());
+	for (unsigned int frame = 0; frame < frames; ++frame)
+	{
+		uint16_t keys = input[0][frame] | input[1][frame];
+		for (unsigned int key = 0; key < KEY_COUNT; ++key)
+		{
+			reference.keypad[key] = (keys >> key) & 1u;
+		}
+		RunFrame(reference, ipf);
+	}
+
+	Chip8 chip8;
+	chip8.Reset(NETPLAY_SEED);
+	chip8.SetQuirks(quirks);
+	chip8.LoadROM(rom.c_str());
+	double copyNs = MeasureStateCopy(chip8);
+
+	std::unique_ptr<Netplay> netplay = std::make_unique<Netplay>(chip8, ipf);
+	if (!netplay->Open(port, peer))
+	{
+		std::cerr << "unable to bind UDP port " << port << std::endl;
+		return 1;
+	}
+	netplay->SetConditions(delay, jitter, loss, seed * 31 + player);
+
+	const auto framePeriod = std::chrono::microseconds(1000000 / 60);
+	auto start = Clock::now();
+	auto nextFrame = start;
+	Clock::time_point complete{};
+	auto lastProgress = start;
+	uint64_t progress = 0;
+	bool done = false;
+
+	//60 Hz frames, polling every millisecond in between; a stalled frame is tried
+	//again at the next poll rather than skipped
+	while (!done)
+	{
+		netplay->Poll();
+
+		auto now = Clock::now();
+		uint32_t frame = netplay->Frame();
+		if (frame < frames && now >= nextFrame)
+		{
+			bool keys[KEY_COUNT];
+			for (unsigned int key = 0; key < KEY_COUNT; ++key)
+			{
+				keys[key] = (local[frame] >> key) & 1u;
+			}
+			if (netplay->AdvanceFrame(keys))
+			{
+				nextFrame += framePeriod;
+			}
+		}
+
+		if (netplay->Frame() + netplay->Confirmed() + netplay->Acknowledged() != progress)
+		{
+			progress = netplay->Frame() + netplay->Confirmed() + netplay->Acknowledged();
+			lastProgress = now;
+		}
+		if (complete == Clock::time_point{} && netplay->Frame() >= frames && netplay->Confirmed() >= frames && netplay->Acknowledged() >= frames)
+		{
+			complete = now;
+		}
+		done = (complete != Clock::time_point{} && now - complete >= std::chrono::milliseconds(LINGER_MS))
+			|| now - lastProgress >= std::chrono::milliseconds(PROGRESS_TIMEOUT_MS);
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+	const NetplayStats& stats = netplay->Stats();
+	bool completed = complete != Clock::time_point{};
+	bool match = completed && StateHash(chip8) == StateHash(reference);
+
+	printf("player %u: %u frames in %.2f s, %u confirmed, %u acknowledged\n", player, netplay->Frame(), seconds, netplay->Confirmed(), netplay->Acknowledged());
+	printf("  rollbacks %llu, frames re-run %llu, deepest %u, average %.1f us, slowest %llu us\n",
+		static_cast<unsigned long long>(stats.rollbacks), static_cast<unsigned long long>(stats.resimulatedFrames), stats.deepestRollback,
+		stats.rollbacks > 0 ? static_cast<double>(stats.rollbackUs) / stats.rollbacks : 0.0, static_cast<unsigned long long>(stats.slowestRollbackUs));
+	printf("  stalls %llu, packets sent %llu (dropped %llu), received %llu, rejected %llu\n",
+		static_cast<unsigned long long>(stats.stalls), static_cast<unsigned long long>(stats.sent), static_cast<unsigned long long>(stats.dropped),
+		static_cast<unsigned long long>(stats.received), static_cast<unsigned long long>(stats.rejected));
+	printf("  state save + restore %.0f ns\n", copyNs);
+	printf("  state %016llx, reference %016llx: %s\n", static_cast<unsigned long long>(StateHash(chip8)),
+		static_cast<unsigned long long>(StateHash(reference)), !completed ? "INCOMPLETE" : match ? "match" : "DESYNC");
+
+	return match ? 0 : 1;
+}
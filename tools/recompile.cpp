@@ -0,0 +1,531 @@
+//Ahead-of-time recompiler: a ROM to a C++ translation unit, built into a shared library
+//usage: recompile <rom> [--quirks <name>] [--out <file.cpp>] [--lib <file>] [--include <dir>]
+//		[--emit-only] [--frames <n>] [--ipf <n>] [--seed <n>]
+//
+//	--quirks	profile the code is generated for, modern or vip (default modern)
+//	--out		translation unit to write (default <rom name>.aot.cpp)
+//	--lib		shared library to build (default <rom name>.aot.so, .dll on Windows)
+//	--include	directory holding Recompiled.h and Chip8.h (default .)
+//	--emit-only	write the translation unit and stop
+//	--frames	frames the check and the timing run (default 2000)
+//	--ipf		instructions per frame (default 1000)
+//	--seed		Cxkk seed and key pattern (default 1)
+//
+//The control flow the disassembler's Analyser finds from START_ADDRESS becomes one
+//function: a label per basic block, a switch on pc to enter them, and a goto to the
+//successor wherever it is known statically. Timer ticks and stats are batched to the
+//block, so a block of n instructions does exactly what n Cycle() calls would. The
+//library is built with $CXX (default c++):
+//	c++ -std=c++17 -O2 -shared -fPIC -I<include> <out> -o <lib>
+//
+//The library is then loaded (Recompiled) and run frame by frame beside the
+//interpreter, from the same seed and with generated keys; the whole machine, display
+//included, must match after every frame. Both are then timed alone and the speedup
+//reported. Exit code 1 on a mismatch or a failed build.
+
+#include "../Chip8.h"
+#include "../Disassembler.h"
+#include "../Recompiled.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+#ifdef _WIN32
+const char* const LIBRARY_EXTENSION = ".dll";
+#else
+const char* const LIBRARY_EXTENSION = ".so";
+#endif
+
+//----------------------------------
+//			Code generation
+//----------------------------------
+
+//the compiled code leaves these to Cycle(): Bnnn (target unknown), Fx0A (may
+//wait) and anything with no handler
+static bool Compilable(uint16_t opcode)
+{
+	Flow flow = DecodeFlow(opcode);
+	return flow != Flow::Indirect && flow != Flow::Invalid && (opcode & 0xF0FFu) != 0xF00Au;
+}
+
+//Fx33/Fx55 can rewrite the code that follows them, so the next instruction starts
+//a block and checks its bytes again
+static bool WritesMemory(uint16_t opcode)
+{
+	return I(opcode) == 0xF && (KK(opcode) == 0x33 || KK(opcode) == 0x55);
+}
+
+static std::string Hex(unsigned int value, int digits)
+{
+	char text[16];
+	snprintf(text, sizeof(text), "0x%0*X", digits, value);
+	return text;
+}
+
+static std::string Reg(unsigned int r)
+{
+	return "V[" + Hex(r, 1) + "]";
+}
+
+//condition under which a skip instruction skips
+static std::string SkipCondition(uint16_t opcode)
+{
+	std::string x = Reg(X(opcode));
+	switch (I(opcode))
+	{
+	case 0x3: return x + " == " + Hex(KK(opcode), 2);
+	case 0x4: return x + " != " + Hex(KK(opcode), 2);
+	case 0x5: return x + " == " + Reg(Y(opcode));
+	case 0x9: return x + " != " + Reg(Y(opcode));
+	default: return (opcode & 0xFu) == 0xE ? "s.keypad[" + x + " & 0xF]" : "!s.keypad[" + x + " & 0xF]";
+	}
+}
+
+//one instruction that falls through, decoded the way Chip8's tables dispatch it
+static std::string Statement(uint16_t opcode, const Quirks& quirks)
+{
+	std::string x = Reg(X(opcode));
+	std::string y = Reg(Y(opcode));
+	std::string kk = Hex(KK(opcode), 2);
+	std::ostringstream out;
+
+	switch (I(opcode))
+	{
+	case 0x0: out << "memset(s.video, 0, sizeof(s.video));"; break;
+	case 0x6: out << x << " = " << kk << ";"; break;
+	case 0x7: out << x << " += " << kk << ";"; break;
+	case 0x8:
+	{
+		switch (opcode & 0xFu)
+		{
+		case 0x0: out << x << " = " << y << ";"; break;
+		case 0x1: out << x << " |= " << y << ";"; break;
+		case 0x2: out << x << " &= " << y << ";"; break;
+		case 0x3: out << x << " ^= " << y << ";"; break;
+		case 0x4: out << "{ unsigned int sum = " << x << " + " << y << "; " << x << " = static_cast<uint8_t>(sum); V[0xF] = sum > 255u; }"; break;
+		case 0x5: out << "{ uint8_t flag = " << x << " >= " << y << "; " << x << " -= " << y << "; V[0xF] = flag; }"; break;
+		case 0x7: out << "{ uint8_t flag = " << y << " >= " << x << "; " << x << " = " << y << " - " << x << "; V[0xF] = flag; }"; break;
+		case 0x6:
+		{
+			std::string from = quirks.shiftUsesVy ? y : x;
+			out << "{ uint8_t flag = " << from << " & 0x1u; " << x << " = " << from << " >> 1; V[0xF] = flag; }";
+		} break;
+		case 0xE:
+		{
+			std::string from = quirks.shiftUsesVy ? y : x;
+			out << "{ uint8_t flag = " << from << " >> 7; " << x << " = static_cast<uint8_t>(" << from << " << 1); V[0xF] = flag; }";
+		} break;
+		}
+	} break;
+	case 0xA: out << "s.index = " << Hex(NNN(opcode), 3) << ";"; break;
+	case 0xC: out << x << " = RecompiledRandom(s) & " << kk << ";"; break;
+	case 0xD: out << "RecompiledDraw(s, stats, " << x << ", " << y << ", " << (opcode & 0xFu) << ");"; break;
+	case 0xF:
+	{
+		std::string moveI = quirks.loadStoreMovesI ? " s.index += " + std::to_string(X(opcode) + 1) + ";" : "";
+		switch (KK(opcode))
+		{
+		case 0x07: out << x << " = s.delayTimer;"; break;
+		case 0x15: out << "s.delayTimer = " << x << ";"; break;
+		case 0x18: out << "s.soundTimer = " << x << ";"; break;
+		case 0x1E: out << "s.index += " << x << ";"; break;
+		case 0x29: out << "s.index = FONT_START_ADDRESS + 5 * " << x << ";"; break;
+		case 0x33:
+			out << "{ CheckSpan(s, 3); uint8_t value = " << x << "; s.memory[(s.index + 2) & ADDRESS_MASK] = value % 10; value /= 10; "
+				"s.memory[(s.index + 1) & ADDRESS_MASK] = value % 10; value /= 10; s.memory[s.index & ADDRESS_MASK] = value % 10; }";
+			break;
+		case 0x55: out << "CheckSpan(s, " << X(opcode) + 1 << "); for (unsigned int i = 0; i <= " << X(opcode) << "; ++i) s.memory[(s.index + i) & ADDRESS_MASK] = V[i];" << moveI; break;
+		case 0x65: out << "CheckSpan(s, " << X(opcode) + 1 << "); for (unsigned int i = 0; i <= " << X(opcode) << "; ++i) V[i] = s.memory[(s.index + i) & ADDRESS_MASK];" << moveI; break;
+		}
+	} break;
+	}
+
+	return out.str();
+}
+
+static bool ReadsTimers(uint16_t opcode)
+{
+	return I(opcode) == 0xF && (KK(opcode) == 0x07 || KK(opcode) == 0x15 || KK(opcode) == 0x18);
+}
+
+struct Block
+{
+	uint16_t start;
+	std::vector<uint16_t> opcodes;
+	uint16_t end;	//address after the last instruction
+};
+
+//blocks of compilable instructions, cut at the Analyser's leaders and after anything
+//that must be entered through the dispatch again
+static std::vector<Block> FindBlocks(const Analyser& analyser, const uint8_t* memory)
+{
+	auto fetch = [&](unsigned int address) { return static_cast<uint16_t>(memory[address] << 8u | memory[address + 1]); };
+	auto isInsn = [&](unsigned int address) { return address + 1 < MEMORY_MAX && (analyser.map[address] & MAP_INSN); };
+
+	std::vector<bool> leader(MEMORY_MAX);
+	for (unsigned int address = 0; address < MEMORY_MAX; ++address)
+	{
+		if (!isInsn(address))
+		{
+			continue;
+		}
+		uint16_t opcode = fetch(address);
+		leader[address] = leader[address] || (analyser.map[address] & MAP_LEADER);
+		if ((!Compilable(opcode) || WritesMemory(opcode)) && address + 2 < MEMORY_MAX)
+		{
+			leader[address + 2] = true;
+		}
+	}
+
+	std::vector<Block> blocks;
+	for (unsigned int start = 0; start < MEMORY_MAX; ++start)
+	{
+		if (!leader[start] || !isInsn(start))
+		{
+			continue;
+		}
+
+		Block block{ static_cast<uint16_t>(start), {}, 0 };
+		unsigned int address = start;
+		while (isInsn(address) && Compilable(fetch(address)))
+		{
+			uint16_t opcode = fetch(address);
+			block.opcodes.push_back(opcode);
+			address += 2;
+			if (DecodeFlow(opcode) != Flow::Next || WritesMemory(opcode) || address >= MEMORY_MAX || leader[address])
+			{
+				break;
+			}
+		}
+		block.end = static_cast<uint16_t>(address);
+
+		if (!block.opcodes.empty())
+		{
+			blocks.push_back(block);
+		}
+	}
+	return blocks;
+}
+
+static void WriteSource(std::ostream& out, const std::string& rom, const std::string& quirksName, const Quirks& quirks,
+	const uint8_t* memory, const std::vector<Block>& blocks)
+{
+	std::vector<bool> compiled(MEMORY_MAX);
+	for (const Block& block : blocks)
+	{
+		compiled[block.start] = true;
+	}
+
+	//straight to the successor when it is a block, otherwise through the dispatch
+	auto jump = [&](unsigned int address)
+	{
+		address &= ADDRESS_MASK;
+		return compiled[address] ? "goto b_" + Hex(address, 3) + ";" : std::string("goto dispatch;");
+	};
+
+	out << "//generated by tools/recompile from " << rom << " (quirks " << quirksName << ") - do not edit\n";
+	out << "//build: c++ -std=c++17 -O2 -shared -fPIC -I<dir of Recompiled.h> <this file> -o <library>\n\n";
+	out << "#include \"Recompiled.h\"\n\n";
+
+	//the memory image the code was generated from; blocks compare their bytes against it
+	out << "static const uint8_t IMAGE[MEMORY_MAX] =\n{";
+	for (unsigned int i = 0; i < MEMORY_MAX; ++i)
+	{
+		out << (i % 16 == 0 ? "\n\t" : " ") << Hex(memory[i], 2) << (i + 1 < MEMORY_MAX ? "," : "");
+	}
+	out << "\n};\n\n";
+
+	out << "static unsigned int Run(Chip8State& s, Chip8Stats& stats, unsigned int budget)\n{\n";
+	out << "\tuint8_t* const V = s.registers;\n";
+	out << "\tunsigned int left = budget;\n\n";
+	out << "dispatch:\n\tswitch (s.pc)\n\t{\n";
+	for (const Block& block : blocks)
+	{
+		out << "\tcase " << Hex(block.start, 3) << ": goto b_" << Hex(block.start, 3) << ";\n";
+	}
+	out << "\tdefault: goto out;\n\t}\n";
+
+	for (const Block& block : blocks)
+	{
+		unsigned int count = static_cast<unsigned int>(block.opcodes.size());
+		unsigned int ticked = 0;
+
+		out << "\nb_" << Hex(block.start, 3) << ":\n";
+		out << "\tif (left < " << count << " || memcmp(&s.memory[" << Hex(block.start, 3) << "], &IMAGE[" << Hex(block.start, 3)
+			<< "], " << 2 * count << ") != 0) goto out;\n";
+
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			uint16_t opcode = block.opcodes[i];
+			if (DecodeFlow(opcode) != Flow::Next)
+			{
+				break;
+			}
+			//the ticks of the instructions before this one
+			if (ReadsTimers(opcode) && i > ticked)
+			{
+				out << "\tRecompiledTick(s, stats, " << i - ticked << ");\n";
+				ticked = i;
+			}
+			out << "\t" << Statement(opcode, quirks) << "\n";
+		}
+
+		out << "\tleft -= " << count << ";\n";
+		out << "\tstats.instructions += " << count << ";\n";
+		out << "\ts.opcode = " << Hex(block.opcodes.back(), 4) << ";\n";
+		out << "\tRecompiledTick(s, stats, " << count - ticked << ");\n";
+
+		uint16_t last = block.end - 2;
+		uint16_t opcode = block.opcodes.back();
+		uint16_t next = (last + 2) & ADDRESS_MASK;
+		switch (DecodeFlow(opcode))
+		{
+		case Flow::Skip:
+		{
+			out << "\tif (" << SkipCondition(opcode) << ") { s.pc = " << Hex((last + 4) & ADDRESS_MASK, 3) << "; " << jump(last + 4) << " }\n";
+			out << "\ts.pc = " << Hex(next, 3) << ";\n\t" << jump(next) << "\n";
+		} break;
+		case Flow::Jump:
+		{
+			out << "\ts.pc = " << Hex(NNN(opcode), 3) << ";\n\t" << jump(NNN(opcode)) << "\n";
+		} break;
+		case Flow::Call:
+		{
+			out << "\tif (PushStack(s, " << Hex(next, 3) << ")) { s.pc = " << Hex(NNN(opcode), 3) << "; " << jump(NNN(opcode)) << " }\n";
+			out << "\ts.pc = " << Hex(next, 3) << ";\n\t" << jump(next) << "\n";
+		} break;
+		case Flow::Return:
+		{
+			out << "\ts.pc = PopStack(s, " << Hex(next, 3) << ");\n\tgoto dispatch;\n";
+		} break;
+		default:
+		{
+			out << "\ts.pc = " << Hex(block.end & ADDRESS_MASK, 3) << ";\n\t" << jump(block.end) << "\n";
+		} break;
+		}
+	}
+
+	out << "\nout:\n\treturn budget - left;\n}\n\n";
+
+	out << "extern \"C\" RECOMPILED_EXPORT const RecompiledInfo* Chip8Recompiled()\n{\n";
+	out << "\tstatic const RecompiledInfo info = { RECOMPILED_ABI, sizeof(Chip8State), { "
+		<< (quirks.shiftUsesVy ? "true" : "false") << ", " << (quirks.loadStoreMovesI ? "true" : "false") << " }, Chip8Random::ID, "
+		<< blocks.size() << ", &Run };\n";
+	out << "\treturn &info;\n}\n";
+}
+
+//----------------------------------
+//			Check and timing
+//----------------------------------
+
+//one key flips about every 8 frames
+static void NextKeys(uint32_t& state, Chip8& chip8, Chip8& other)
+{
+	state ^= state << 13;
+	state ^= state >> 17;
+	state ^= state << 5;
+	if ((state & 7) == 0)
+	{
+		unsigned int key = (state >> 3) & 0xF;
+		chip8.keypad[key] = !chip8.keypad[key];
+		other.keypad[key] = chip8.keypad[key];
+	}
+}
+
+static bool SameMachine(const Chip8& a, const Chip8& b)
+{
+	Chip8State x;
+	Chip8State y;
+	a.SaveState(x);
+	b.SaveState(y);
+
+	const Chip8Stats& p = a.Stats();
+	const Chip8Stats& q = b.Stats();
+	return memcmp(x.memory, y.memory, sizeof(x.memory)) == 0 && memcmp(x.video, y.video, sizeof(x.video)) == 0
+		&& memcmp(x.registers, y.registers, sizeof(x.registers)) == 0 && memcmp(x.stack, y.stack, sizeof(x.stack)) == 0
+		&& x.index == y.index && x.pc == y.pc && x.sp == y.sp && x.delayTimer == y.delayTimer && x.soundTimer == y.soundTimer
+		&& x.opcode == y.opcode && x.keyWait == y.keyWait && x.faults == y.faults && x.rngKey == y.rngKey && x.rngDraws == y.rngDraws
+		&& p.instructions == q.instructions && p.draws == q.draws && p.collisions == q.collisions && p.timerUnderflows == q.timerUnderflows;
+}
+
+static void PowerOn(Chip8& chip8, uint32_t seed, const Quirks& quirks, const std::vector<uint8_t>& rom)
+{
+	chip8.Reset(seed);
+	chip8.SetQuirks(quirks);
+	chip8.LoadROM(rom.data(), rom.size());
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2 || argv[1][0] == '-')
+	{
+		std::cerr << "usage: recompile <rom> [--quirks <name>] [--out <file.cpp>] [--lib <file>] [--include <dir>]\n"
+			"\t[--emit-only] [--frames <n>] [--ipf <n>] [--seed <n>]" << std::endl;
+		return 1;
+	}
+
+	std::string romPath = argv[1];
+	std::string name = romPath.substr(romPath.find_last_of("/\\") + 1);
+	name = name.substr(0, name.find_last_of('.'));
+
+	std::string quirksName = "modern";
+	Quirks quirks = QUIRKS_MODERN;
+	std::string outPath = name + ".aot.cpp";
+	std::string libPath = name + ".aot" + LIBRARY_EXTENSION;
+	std::string include = ".";
+	bool emitOnly = false;
+	unsigned int frames = 2000;
+	unsigned int ipf = 1000;
+	uint32_t seed = 1;
+
+	for (int i = 2; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--quirks" && i + 1 < argc) quirksName = argv[++i];
+		else if (arg == "--out" && i + 1 < argc) outPath = argv[++i];
+		else if (arg == "--lib" && i + 1 < argc) libPath = argv[++i];
+		else if (arg == "--include" && i + 1 < argc) include = argv[++i];
+		else if (arg == "--emit-only") emitOnly = true;
+		else if (arg == "--frames" && i + 1 < argc) frames = std::stoul(argv[++i]);
+		else if (arg == "--ipf" && i + 1 < argc) ipf = std::max(1ul, std::stoul(argv[++i]));
+		else if (arg == "--seed" && i + 1 < argc) seed = std::stoul(argv[++i]);
+		else
+		{
+			std::cerr << "unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	if (!QuirksByName(quirksName, quirks))
+	{
+		std::cerr << "unknown quirks profile " << quirksName << std::endl;
+		return 1;
+	}
+
+	std::ifstream file(romPath, std::ios::binary);
+	std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (rom.empty())
+	{
+		std::cerr << "unable to read " << romPath << std::endl;
+		return 1;
+	}
+
+	Chip8 interpreted;
+	PowerOn(interpreted, seed, quirks, rom);
+	Chip8State image;
+	interpreted.SaveState(image);
+
+	Analyser analyser;
+	analyser.Analyse(image.memory);
+	std::vector<Block> blocks = FindBlocks(analyser, image.memory);
+
+	size_t instructions = 0;
+	for (const Block& block : blocks)
+	{
+		instructions += block.opcodes.size();
+	}
+
+	{
+		std::ofstream out(outPath);
+		WriteSource(out, romPath, quirksName, quirks, image.memory, blocks);
+		if (!out)
+		{
+			std::cerr << "unable to write " << outPath << std::endl;
+			return 1;
+		}
+	}
+	printf("%s: %zu blocks, %zu instructions%s -> %s\n", romPath.c_str(), blocks.size(), instructions,
+		analyser.hasIndirect ? " (has Bnnn, its targets are interpreted)" : "", outPath.c_str());
+
+	if (emitOnly)
+	{
+		return 0;
+	}
+
+	const char* cxx = getenv("CXX");
+	std::string command = std::string(cxx != nullptr ? cxx : "c++") + " -std=c++17 -O2 -shared -fPIC -I\"" + include + "\" \""
+		+ outPath + "\" -o \"" + libPath + "\"";
+	auto buildStart = Clock::now();
+	if (std::system(command.c_str()) != 0)
+	{
+		std::cerr << "build failed: " << command << std::endl;
+		return 1;
+	}
+	double buildSeconds = std::chrono::duration<double>(Clock::now() - buildStart).count();
+
+	//a path without a directory would be looked up on the library path instead
+	if (libPath.find_first_of("/\\") == std::string::npos)
+	{
+		libPath = "./" + libPath;
+	}
+
+	Recompiled recompiled;
+	if (!recompiled.Load(libPath.c_str()))
+	{
+		std::cerr << recompiled.Error() << std::endl;
+		return 1;
+	}
+	printf("built %s in %.2f s\n", libPath.c_str(), buildSeconds);
+
+	//check: frame by frame beside the interpreter
+	Chip8 compiled;
+	PowerOn(compiled, seed, quirks, rom);
+	uint32_t keys = seed * 2654435761u + 1;
+	for (unsigned int frame = 0; frame < frames; ++frame)
+	{
+		NextKeys(keys, interpreted, compiled);
+		for (unsigned int i = 0; i < ipf; ++i)
+		{
+			interpreted.Cycle();
+		}
+		recompiled.Run(compiled, ipf);
+
+		if (!SameMachine(interpreted, compiled))
+		{
+			printf("MISMATCH at frame %u\n", frame);
+			return 1;
+		}
+	}
+	double share = 100.0 * recompiled.Compiled() / std::max<uint64_t>(1, recompiled.Compiled() + recompiled.Interpreted());
+	printf("check: %u frames x %u instructions identical, %.1f%% of instructions compiled\n", frames, ipf, share);
+
+	//timing: each alone, same keys
+	auto time = [&](Chip8& chip8, bool useCompiled)
+	{
+		PowerOn(chip8, seed, quirks, rom);
+		Chip8 unused;
+		uint32_t state = seed * 2654435761u + 1;
+		auto start = Clock::now();
+		for (unsigned int frame = 0; frame < frames; ++frame)
+		{
+			NextKeys(state, chip8, unused);
+			if (useCompiled)
+			{
+				recompiled.Run(chip8, ipf);
+				continue;
+			}
+			for (unsigned int i = 0; i < ipf; ++i)
+			{
+				chip8.Cycle();
+			}
+		}
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	};
+
+	double interpreterSeconds = time(interpreted, false);
+	double compiledSeconds = time(compiled, true);
+	double total = static_cast<double>(frames) * ipf;
+	printf("interpreter %8.1f Minstr/s\nrecompiled  %8.1f Minstr/s\nspeedup     %8.2fx\n",
+		total / interpreterSeconds / 1e6, total / compiledSeconds / 1e6, interpreterSeconds / compiledSeconds);
+
+	return 0;
+}
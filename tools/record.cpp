@@ -0,0 +1,80 @@
+//Headless gameplay recorder - runs a ROM without a window and writes an animated GIF
+//usage: record <rom> <out.gif> [--seconds <n>] [--ipf <n>] [--scale <n>] [--keys <hex mask>] [--wait]
+//
+//	--seconds	emulated time to record (default 10)
+//	--ipf		instructions per 60 Hz frame (default 10)
+//	--scale		output pixels per display pixel (default 4)
+//	--keys		keypad held down for the whole run, bit n = key n (default none)
+//	--wait		wait for the encoder instead of dropping frames when it falls behind
+//
+//Emulation runs as fast as it can, so without --wait the frame queue can overflow;
+//the number of dropped frames is reported at the end.
+
+#include "../Chip8.h"
+#include "../Recorder.h"
+
+#include <iostream>
+#include <string>
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cerr << "usage: record <rom> <out.gif> [--seconds <n>] [--ipf <n>] [--scale <n>] [--keys <hex mask>] [--wait]" << std::endl;
+		return 1;
+	}
+
+	unsigned int seconds = 10;
+	unsigned int ipf = 10;
+	unsigned int scale = 4;
+	unsigned int keys = 0;
+	bool wait = false;
+
+	for (int i = 3; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--wait") wait = true;
+		else if (arg == "--seconds" && i + 1 < argc) seconds = std::stoul(argv[++i]);
+		else if (arg == "--ipf" && i + 1 < argc) ipf = std::stoul(argv[++i]);
+		else if (arg == "--scale" && i + 1 < argc) scale = std::stoul(argv[++i]);
+		else if (arg == "--keys" && i + 1 < argc) keys = std::stoul(argv[++i], nullptr, 16);
+		else
+		{
+			std::cerr << "unknown option " << arg << std::endl;
+			return 1;
+		}
+	}
+
+	Chip8 chip8;
+	chip8.LoadROM(argv[1]);
+	for (unsigned int key = 0; key < KEY_COUNT; ++key)
+	{
+		chip8.keypad[key] = (keys >> key) & 1;
+	}
+
+	Recorder recorder;
+	if (!recorder.Open(argv[2], scale))
+	{
+		std::cerr << "unable to write " << argv[2] << std::endl;
+		return 1;
+	}
+
+	const unsigned int frames = seconds * 60;
+	for (unsigned int frame = 0; frame < frames; ++frame)
+	{
+		for (unsigned int i = 0; i < ipf; ++i)
+		{
+			chip8.Cycle();
+		}
+
+		uint32_t timeMs = frame * 1000 / 60;
+		recorder.Submit(chip8.video, timeMs, wait);
+	}
+
+	recorder.Close();
+
+	std::cout << frames << " frames, " << recorder.Written() << " images written, "
+		<< recorder.Dropped() << " dropped" << std::endl;
+	return 0;
+}
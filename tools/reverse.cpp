@@ -0,0 +1,156 @@
+//Reverse execution check: states rebuilt by Debugger replay against the live machine
+//usage: reverse [rom] [--interval <n>]
+//
+//	rom			default roms/bench/input.ch8, which reads the keypad every frame
+//	--interval	instructions between checkpoints (default 1000, the Debugger's own)
+//
+//Each scenario steps a machine through the Debugger with key changes in between,
+//saves the live state at some position, goes on, then reverse steps back to that
+//position and compares the rebuilt state byte for byte. The saved state is taken
+//after the last key change at that position, since replay restores the keypad the
+//next instruction will see. Also checks where reverse steps run out of history and
+//that replay does not count instructions again. Exit code 1 on any failure.
+
+#include "../Chip8.h"
+#include "../Debugger.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static unsigned int failures = 0;
+
+static void Check(bool ok, const std::string& what)
+{
+	printf("%-52s %s\n", what.c_str(), ok ? "ok" : "FAILED");
+	failures += !ok;
+}
+
+static void Compare(Chip8& chip8, const Chip8State& live, const std::string& what)
+{
+	Chip8State replayed;
+	chip8.SaveState(replayed);
+	Check(memcmp(&replayed, &live, sizeof(live)) == 0, what);
+}
+
+int main(int argc, char** argv)
+{
+	std::string path = "roms/bench/input.ch8";
+	unsigned int interval = 1000;
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "--interval" && i + 1 < argc) interval = std::stoul(argv[++i]);
+		else path = arg;
+	}
+
+	std::ifstream file(path, std::ios::binary);
+	std::vector<uint8_t> rom((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+	if (rom.empty())
+	{
+		std::cerr << "unable to read " << path << std::endl;
+		return 1;
+	}
+
+	Chip8 chip8;
+	Chip8State live;
+
+	//a straight run with key changes, rewound into the middle
+	{
+		chip8.Reset(1);
+		chip8.LoadROM(rom.data(), rom.size());
+		Debugger debugger(chip8);
+		debugger.SetHistory(interval, 1024);
+
+		debugger.Step(100);
+		chip8.keypad[0] = 1;
+		debugger.Step(200);
+		chip8.keypad[0] = 0;
+		chip8.SaveState(live);
+		debugger.Step(200);
+		debugger.ReverseStep(200);
+		Compare(chip8, live, "rewind over a key release");
+	}
+
+	//rewind onto a key change, then change the key at that same position: the new
+	//input has to replace the old rather than sit beside it in the log
+	{
+		chip8.Reset(1);
+		chip8.LoadROM(rom.data(), rom.size());
+		Debugger debugger(chip8);
+		debugger.SetHistory(interval, 1024);
+
+		debugger.Step(100);
+		chip8.keypad[0] = 1;
+		debugger.Step(200);
+		chip8.keypad[0] = 0;
+		debugger.Step(200);
+		debugger.ReverseStep(400);
+		chip8.keypad[0] = 0;
+		debugger.Step(100);
+		chip8.keypad[0] = 1;
+		debugger.Step(100);
+		chip8.keypad[0] = 0;
+		chip8.SaveState(live);
+		debugger.Step(500);
+		debugger.ReverseStep(500);
+		Compare(chip8, live, "rewind, new input at an old key change");
+	}
+
+	//the same, several keys and more than one checkpoint back
+	{
+		chip8.Reset(1);
+		chip8.LoadROM(rom.data(), rom.size());
+		Debugger debugger(chip8);
+		debugger.SetHistory(interval, 1024);
+
+		for (unsigned int key = 0; key < KEY_COUNT; ++key)
+		{
+			chip8.keypad[key] = 1;
+			debugger.Step(interval / 3 + key);
+			chip8.keypad[key] = 0;
+			debugger.Step(interval / 5);
+		}
+		uint64_t end = debugger.Position();
+		debugger.ReverseStep(static_cast<unsigned int>(end / 2));
+		chip8.keypad[5] = 1;
+		debugger.Step(interval / 4);
+		chip8.keypad[5] = 0;
+		chip8.keypad[9] = 1;
+		chip8.SaveState(live);
+		uint64_t saved = debugger.Position();
+		debugger.Step(interval * 3);
+		debugger.ReverseStep(static_cast<unsigned int>(debugger.Position() - saved));
+		Compare(chip8, live, "rewind past checkpoints, new input");
+	}
+
+	//all the way back to the oldest checkpoint is still a step, one more is the start
+	//of history; replayed instructions are not counted again
+	{
+		chip8.Reset(1);
+		chip8.LoadROM(rom.data(), rom.size());
+		Debugger debugger(chip8);
+		debugger.SetHistory(interval, 1024);
+
+		debugger.Step(300);
+		uint64_t executed = chip8.Stats().instructions;
+		StopReason reason = debugger.ReverseStep(300);
+		Check(reason == StopReason::Step && debugger.Position() == 0, "rewind exactly to the oldest checkpoint");
+		Check(debugger.ReverseStep() == StopReason::HistoryStart, "one more is the start of history");
+
+		//only the forward steps count
+		debugger.Step(50);
+		debugger.ReverseContinue();
+		debugger.Step(50);
+		debugger.ReverseToRegisterWrite(0);
+		debugger.ReverseToWrite(0x300);
+		Check(chip8.Stats().instructions == executed + 100, "replay leaves the stats alone");
+	}
+
+	printf("%u failed\n", failures);
+	return failures == 0 ? 0 : 1;
+}
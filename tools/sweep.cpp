@@ -0,0 +1,600 @@
+//Regression sweep of ROMs x quirk profiles x input scripts across worker processes
+//usage: sweep <rom|dir>... [--quirks <name,...>] [--scripts <file|dir>] [--frames <n>] [--ipf <n>]
+//		[--timing <fast|vip>] [--workers <n>] [--retries <n>] [--json <out.json>]
+//
+//	rom|dir		.ch8 files, or directories holding them
+//	--quirks	comma separated profiles, modern and/or vip (default modern)
+//	--scripts	an input script, or a directory of them (default: no input)
+//	--frames	60 Hz frames each job runs (default 600)
+//	--ipf		instructions per frame (default 10), unused with --timing vip
+//	--timing	vip runs each frame with COSMAC VIP instruction timing
+//	--workers	worker processes (default one per core)
+//	--retries	times a job is run again after its worker dies (default 2)
+//	--json		also write the results as JSON
+//
+//An input script holds one event per line, "<frame> <key hex> <down|up>"; # starts
+//a comment.
+//
+//The coordinator loads every ROM and script, then forks the workers, which share
+//them copy-on-write. Jobs are claimed from a counter in shared memory, so a slow
+//shard never leaves a core idle. Each worker streams its results back through its
+//own RingBuffer in the same anonymous shared mapping - no pipes or files. A worker
+//that dies is replaced, and the job it was running is tried again in a later round
+//until it passes or runs out of retries. Exit code 1 if any job failed. POSIX only.
+
+#include "../Chip8.h"
+#include "../FrameCodec.h"
+#include "../RingBuffer.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+//every job starts from the same Cxkk seed so runs are comparable
+const uint32_t SWEEP_SEED = 1;
+const size_t RESULT_RING = 64;
+//how long the coordinator sleeps when no results are waiting
+const unsigned int COLLECT_POLL_US = 500;
+
+const uint64_t FNV_OFFSET = 0xCBF29CE484222325ull;
+const uint64_t FNV_PRIME = 0x100000001B3ull;
+
+struct InputEvent
+{
+	unsigned int frame;
+	uint8_t key;
+	bool down;
+};
+
+struct Script
+{
+	std::string name;
+	std::vector<InputEvent> events;	//in frame order
+};
+
+struct Rom
+{
+	std::string name;
+	std::vector<uint8_t> image;
+};
+
+struct Job
+{
+	unsigned int rom;
+	unsigned int quirks;
+	unsigned int script;
+};
+
+struct Sweep
+{
+	std::vector<Rom> roms;
+	std::vector<std::pair<std::string, Quirks>> quirks;
+	std::vector<Script> scripts;
+	std::vector<Job> jobs;
+	unsigned int frames = 600;
+	unsigned int ipf = 10;
+	bool vipTiming = false;
+};
+
+//plain data - copied through the shared ring
+struct JobResult
+{
+	uint32_t job;
+	uint64_t instructions;
+	uint64_t cycles;	//VIP machine cycles, 0 with fast timing
+	uint64_t finalHash;	//display after the last frame
+	uint64_t traceHash;	//every frame's display, chained
+	double ms;
+};
+
+//one per worker process, in shared memory
+struct WorkerSlot
+{
+	RingBuffer<JobResult, RESULT_RING> results;
+	std::atomic<int32_t> current{ -1 };	//job being run, -1 between jobs
+};
+
+//the job list of the current round, in shared memory
+struct Round
+{
+	std::atomic<uint32_t> next{ 0 };
+	uint32_t count = 0;
+};
+
+//processes only share the atomics if they need no lock
+static_assert(std::atomic<size_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+	"shared memory counters must be lock free");
+
+static uint64_t Fnv1a(const uint8_t* data, size_t size, uint64_t hash)
+{
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ data[i]) * FNV_PRIME;
+	}
+	return hash;
+}
+
+static std::vector<uint8_t> ReadFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	return std::vector<uint8_t>(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+}
+
+//files with the given extension in a directory, sorted, or the path itself
+static std::vector<std::string> ExpandPath(const std::string& path, const char* extension)
+{
+	std::vector<std::string> paths;
+	std::error_code error;
+	if (std::filesystem::is_directory(path, error))
+	{
+		for (const auto& entry : std::filesystem::directory_iterator(path, error))
+		{
+			if (entry.is_regular_file() && entry.path().extension() == extension)
+			{
+				paths.push_back(entry.path().string());
+			}
+		}
+		std::sort(paths.begin(), paths.end());
+	}
+	else
+	{
+		paths.push_back(path);
+	}
+	return paths;
+}
+
+//a whole unsigned number in the given base that fits an unsigned int
+static bool ParseCount(const std::string& text, unsigned int& value, int base = 10)
+{
+	if (text.empty() || !isxdigit(static_cast<unsigned char>(text[0])))
+	{
+		return false;
+	}
+	char* end = nullptr;
+	errno = 0;
+	unsigned long parsed = strtoul(text.c_str(), &end, base);
+	if (*end != '\0' || errno == ERANGE || parsed > UINT_MAX)
+	{
+		return false;
+	}
+	value = static_cast<unsigned int>(parsed);
+	return true;
+}
+
+//false with the reason in error if the file cannot be read or a line is not an event
+static bool ReadScript(const std::string& path, Script& script, std::string& error)
+{
+	std::ifstream file(path);
+	if (!file.is_open())
+	{
+		error = "unable to read " + path;
+		return false;
+	}
+
+	script.name = std::filesystem::path(path).stem().string();
+	std::string line;
+	for (unsigned int number = 1; std::getline(file, line); ++number)
+	{
+		line = line.substr(0, line.find('#'));
+		std::istringstream fields(line);
+		std::string frame;
+		std::string key;
+		std::string state;
+		std::string extra;
+		if (!(fields >> frame))
+		{
+			continue;
+		}
+
+		InputEvent event{};
+		unsigned int keyValue = 0;
+		fields >> key >> state;
+		if (!ParseCount(frame, event.frame) || key.size() != 1 || !ParseCount(key, keyValue, 16)
+			|| (state != "down" && state != "up") || fields >> extra)
+		{
+			error = path + ":" + std::to_string(number) + ": expected \"<frame> <key hex> <down|up>\"";
+			return false;
+		}
+		event.key = static_cast<uint8_t>(keyValue);
+		event.down = state == "down";
+		script.events.push_back(event);
+	}
+
+	std::stable_sort(script.events.begin(), script.events.end(),
+		[](const InputEvent& a, const InputEvent& b) { return a.frame < b.frame; });
+	return true;
+}
+
+static JobResult RunJob(Chip8& chip8, const Sweep& sweep, uint32_t id)
+{
+	const Job& job = sweep.jobs[id];
+	const Rom& rom = sweep.roms[job.rom];
+	const std::vector<InputEvent>& events = sweep.scripts[job.script].events;
+
+	auto start = Clock::now();
+
+	chip8.Reset(SWEEP_SEED);
+	chip8.SetQuirks(sweep.quirks[job.quirks].second);
+	chip8.LoadROM(rom.image.data(), rom.image.size());
+
+	uint8_t packed[FRAME_BYTES] = {};
+	uint64_t trace = FNV_OFFSET;
+	size_t nextEvent = 0;
+
+	for (unsigned int frame = 0; frame < sweep.frames; ++frame)
+	{
+		for (; nextEvent < events.size() && events[nextEvent].frame <= frame; ++nextEvent)
+		{
+			chip8.keypad[events[nextEvent].key] = events[nextEvent].down;
+		}
+
+		if (sweep.vipTiming)
+		{
+			chip8.RunFrame();
+		}
+		else
+		{
+			for (unsigned int i = 0; i < sweep.ipf; ++i)
+			{
+				chip8.Cycle();
+			}
+		}
+
+		PackVideo(chip8.video, packed);
+		trace = Fnv1a(packed, FRAME_BYTES, trace);
+	}
+
+	JobResult result{};
+	result.job = id;
+	result.instructions = chip8.Stats().instructions;
+	result.cycles = chip8.Cycles();
+	result.finalHash = Fnv1a(packed, FRAME_BYTES, FNV_OFFSET);
+	result.traceHash = trace;
+	result.ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+	return result;
+}
+
+#ifndef _WIN32
+//zero filled memory every forked worker sees, never unmapped - the process exits first
+template <typename T>
+static T* SharedArray(size_t count)
+{
+	void* memory = mmap(nullptr, sizeof(T) * count, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (memory == MAP_FAILED)
+	{
+		return nullptr;
+	}
+
+	T* items = static_cast<T*>(memory);
+	for (size_t i = 0; i < count; ++i)
+	{
+		new (&items[i]) T();
+	}
+	return items;
+}
+
+//worker process: claim jobs until the round's list is used up
+static void RunWorker(const Sweep& sweep, Round& round, const uint32_t* jobs, WorkerSlot& slot)
+{
+	Chip8 chip8;
+
+	for (;;)
+	{
+		uint32_t i = round.next.fetch_add(1, std::memory_order_relaxed);
+		if (i >= round.count)
+		{
+			break;
+		}
+
+		slot.current.store(static_cast<int32_t>(jobs[i]), std::memory_order_release);
+		JobResult result = RunJob(chip8, sweep, jobs[i]);
+		while (!slot.results.Push(result))
+		{
+			std::this_thread::yield();
+		}
+		slot.current.store(-1, std::memory_order_release);
+	}
+}
+
+static pid_t SpawnWorker(const Sweep& sweep, Round& round, const uint32_t* jobs, WorkerSlot& slot)
+{
+	slot.current.store(-1, std::memory_order_relaxed);
+
+	pid_t pid = fork();
+	if (pid == 0)
+	{
+		RunWorker(sweep, round, jobs, slot);
+		//skip the coordinator's destructors and buffered output
+		_exit(0);
+	}
+	return pid;
+}
+#endif
+
+static void WriteJson(std::ostream& out, const Sweep& sweep, const std::vector<JobResult>& results,
+	const std::vector<bool>& done, const std::vector<unsigned int>& crashes)
+{
+	char line[512];
+
+	out << "{\n\t\"jobs\": [\n";
+	for (size_t i = 0; i < sweep.jobs.size(); ++i)
+	{
+		const Job& job = sweep.jobs[i];
+		snprintf(line, sizeof(line), "\t\t{ \"rom\": \"%s\", \"quirks\": \"%s\", \"script\": \"%s\", \"passed\": %s, \"crashes\": %u, "
+			"\"instructions\": %llu, \"cycles\": %llu, \"final_hash\": \"%016llx\", \"trace_hash\": \"%016llx\", \"ms\": %.3f }%s\n",
+			sweep.roms[job.rom].name.c_str(), sweep.quirks[job.quirks].first.c_str(), sweep.scripts[job.script].name.c_str(),
+			done[i] ? "true" : "false", crashes[i],
+			static_cast<unsigned long long>(results[i].instructions), static_cast<unsigned long long>(results[i].cycles),
+			static_cast<unsigned long long>(results[i].finalHash), static_cast<unsigned long long>(results[i].traceHash),
+			results[i].ms, i + 1 < sweep.jobs.size() ? "," : "");
+		out << line;
+	}
+	out << "\t]\n}\n";
+}
+
+int main(int argc, char** argv)
+{
+	Sweep sweep;
+	std::vector<std::string> romPaths;
+	std::string quirkNames = "modern";
+	std::string scriptPath;
+	std::string jsonPath;
+	unsigned int workers = std::max(1u, std::thread::hardware_concurrency());
+	unsigned int retries = 2;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		bool valid = true;
+		if (arg.compare(0, 2, "--") != 0) romPaths.push_back(arg);
+		else if (i + 1 >= argc) { std::cerr << "missing value for " << arg << std::endl; return 1; }
+		else if (arg == "--quirks") quirkNames = argv[++i];
+		else if (arg == "--scripts") scriptPath = argv[++i];
+		else if (arg == "--frames") valid = ParseCount(argv[++i], sweep.frames);
+		else if (arg == "--ipf") valid = ParseCount(argv[++i], sweep.ipf);
+		else if (arg == "--timing") sweep.vipTiming = std::string(argv[++i]) == "vip";
+		else if (arg == "--workers") valid = ParseCount(argv[++i], workers) && workers > 0;
+		else if (arg == "--retries") valid = ParseCount(argv[++i], retries);
+		else if (arg == "--json") jsonPath = argv[++i];
+		else
+		{
+			std::cerr << "unknown option " << arg << std::endl;
+			return 1;
+		}
+
+		if (!valid)
+		{
+			std::cerr << "bad value for " << arg << ": " << argv[i] << std::endl;
+			return 1;
+		}
+	}
+
+	if (romPaths.empty())
+	{
+		std::cerr << "usage: sweep <rom|dir>... [--quirks <name,...>] [--scripts <file|dir>] [--frames <n>] [--ipf <n>]\n"
+			"\t[--timing <fast|vip>] [--workers <n>] [--retries <n>] [--json <out.json>]" << std::endl;
+		return 1;
+	}
+
+#ifdef _WIN32
+	std::cerr << "sweep needs fork() and shared anonymous mappings" << std::endl;
+	return 1;
+#else
+	for (const std::string& path : romPaths)
+	{
+		for (const std::string& file : ExpandPath(path, ".ch8"))
+		{
+			Rom rom{ std::filesystem::path(file).stem().string(), ReadFile(file) };
+			if (rom.image.empty())
+			{
+				std::cerr << "unable to read " << file << std::endl;
+				return 1;
+			}
+			sweep.roms.push_back(std::move(rom));
+		}
+	}
+
+	std::istringstream names(quirkNames);
+	std::string name;
+	while (std::getline(names, name, ','))
+	{
+		Quirks quirks;
+		if (!QuirksByName(name, quirks))
+		{
+			std::cerr << "unknown quirks profile " << name << std::endl;
+			return 1;
+		}
+		sweep.quirks.emplace_back(name, quirks);
+	}
+
+	if (scriptPath.empty())
+	{
+		sweep.scripts.push_back(Script{ "none", {} });
+	}
+	for (const std::string& file : scriptPath.empty() ? std::vector<std::string>() : ExpandPath(scriptPath, ".txt"))
+	{
+		Script script;
+		std::string error;
+		if (!ReadScript(file, script, error))
+		{
+			std::cerr << error << std::endl;
+			return 1;
+		}
+		sweep.scripts.push_back(std::move(script));
+	}
+
+	for (unsigned int rom = 0; rom < sweep.roms.size(); ++rom)
+	{
+		for (unsigned int quirks = 0; quirks < sweep.quirks.size(); ++quirks)
+		{
+			for (unsigned int script = 0; script < sweep.scripts.size(); ++script)
+			{
+				sweep.jobs.push_back({ rom, quirks, script });
+			}
+		}
+	}
+
+	const size_t jobCount = sweep.jobs.size();
+	workers = static_cast<unsigned int>(std::min<size_t>(workers, std::max<size_t>(jobCount, 1)));
+
+	Round* round = SharedArray<Round>(1);
+	uint32_t* roundJobs = SharedArray<uint32_t>(std::max<size_t>(jobCount, 1));
+	WorkerSlot* slots = SharedArray<WorkerSlot>(workers);
+	if (!round || !roundJobs || !slots)
+	{
+		std::cerr << "unable to map shared memory" << std::endl;
+		return 1;
+	}
+
+	std::vector<JobResult> results(jobCount, JobResult{});
+	std::vector<bool> done(jobCount, false);
+	std::vector<unsigned int> crashes(jobCount, 0);
+	std::vector<pid_t> pids(workers, -1);
+
+	auto collect = [&](WorkerSlot& slot)
+	{
+		JobResult result;
+		while (slot.results.Pop(result))
+		{
+			results[result.job] = result;
+			done[result.job] = true;
+		}
+	};
+
+	auto start = Clock::now();
+
+	//round 0 runs everything, later rounds only jobs whose worker died under them
+	for (unsigned int attempt = 0; attempt <= retries; ++attempt)
+	{
+		uint32_t count = 0;
+		for (uint32_t job = 0; job < jobCount; ++job)
+		{
+			if (!done[job] && crashes[job] <= retries)
+			{
+				roundJobs[count++] = job;
+			}
+		}
+		if (count == 0)
+		{
+			break;
+		}
+
+		round->count = count;
+		round->next.store(0, std::memory_order_relaxed);
+
+		unsigned int alive = 0;
+		for (unsigned int worker = 0; worker < std::min<uint32_t>(workers, count); ++worker)
+		{
+			pids[worker] = SpawnWorker(sweep, *round, roundJobs, slots[worker]);
+			alive += pids[worker] > 0 ? 1 : 0;
+		}
+
+		while (alive > 0)
+		{
+			for (unsigned int worker = 0; worker < workers; ++worker)
+			{
+				collect(slots[worker]);
+			}
+
+			int status = 0;
+			pid_t pid;
+			bool exited = false;
+			while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+			{
+				exited = true;
+				unsigned int worker = static_cast<unsigned int>(std::find(pids.begin(), pids.end(), pid) - pids.begin());
+				if (worker == workers)
+				{
+					continue;
+				}
+
+				pids[worker] = -1;
+				--alive;
+				collect(slots[worker]);
+
+				bool clean = WIFEXITED(status) && WEXITSTATUS(status) == 0;
+				if (clean)
+				{
+					continue;
+				}
+
+				int32_t job = slots[worker].current.load(std::memory_order_acquire);
+				if (job >= 0 && !done[job])
+				{
+					++crashes[job];
+					std::cerr << "worker " << pid << " died on " << sweep.roms[sweep.jobs[job].rom].name
+						<< (WIFSIGNALED(status) ? " (signal " + std::to_string(WTERMSIG(status)) + ")" : std::string()) << std::endl;
+				}
+
+				//its unclaimed share is still in the counter - keep every core busy
+				if (round->next.load(std::memory_order_relaxed) < round->count)
+				{
+					pids[worker] = SpawnWorker(sweep, *round, roundJobs, slots[worker]);
+					alive += pids[worker] > 0 ? 1 : 0;
+				}
+			}
+
+			if (!exited)
+			{
+				std::this_thread::sleep_for(std::chrono::microseconds(COLLECT_POLL_US));
+			}
+		}
+
+		for (unsigned int worker = 0; worker < workers; ++worker)
+		{
+			collect(slots[worker]);
+		}
+	}
+
+	double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+	unsigned int failed = 0;
+	printf("%-20s %-8s %-12s %12s %12s %-16s %-16s %9s  %s\n", "rom", "quirks", "script", "instructions", "cycles",
+		"final", "trace", "ms", "status");
+	for (size_t i = 0; i < jobCount; ++i)
+	{
+		const Job& job = sweep.jobs[i];
+		const JobResult& result = results[i];
+		std::string status = !done[i] ? "FAILED" : crashes[i] > 0 ? "ok after " + std::to_string(crashes[i]) + " retries" : "ok";
+		failed += done[i] ? 0 : 1;
+
+		printf("%-20s %-8s %-12s %12llu %12llu %016llx %016llx %9.2f  %s\n", sweep.roms[job.rom].name.c_str(),
+			sweep.quirks[job.quirks].first.c_str(), sweep.scripts[job.script].name.c_str(),
+			static_cast<unsigned long long>(result.instructions), static_cast<unsigned long long>(result.cycles),
+			static_cast<unsigned long long>(result.finalHash), static_cast<unsigned long long>(result.traceHash),
+			result.ms, status.c_str());
+	}
+
+	printf("%zu jobs, %u failed, %u workers, %.2f s, %.1f jobs/s\n", jobCount, failed, workers, seconds,
+		seconds > 0 ? jobCount / seconds : 0);
+
+	if (!jsonPath.empty())
+	{
+		std::ofstream out(jsonPath);
+		WriteJson(out, sweep, results, done, crashes);
+	}
+
+	return failed > 0 ? 1 : 0;
+#endif
+}
@@ -0,0 +1,154 @@
+//Spectator client for FrameServer streams
+//usage: viewer <port|path> [channel] [scale]
+//
+//Connects to 127.0.0.1:port (or a Unix domain socket path), subscribes to one
+//channel and renders it through SDL_Layer. TAB and CAPSLOCK switch filter and
+//colour as in the interpreter; PAGEUP/PAGEDOWN switch channel.
+
+#include "../FrameCodec.h"
+#include "../SDL_Layer.h"
+#include "../Socket.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "usage: viewer <port|path> [channel] [scale]" << std::endl;
+		return 1;
+	}
+
+	std::string address = argv[1];
+	uint8_t channel = argc > 2 ? static_cast<uint8_t>(std::stoi(argv[2])) : 0;
+	int scale = argc > 3 ? std::stoi(argv[3]) : 10;
+
+	bool isPort = address.find_first_not_of("0123456789") == std::string::npos;
+	int fd = isPort ? ConnectTcpSocket(static_cast<unsigned short>(std::stoi(address))) : ConnectUnixSocket(address.c_str());
+	if (fd < 0)
+	{
+		std::cerr << "unable to connect to " << address << std::endl;
+		return 1;
+	}
+	SendBytes(fd, &channel, 1);
+
+	SDL_Layer layer("CHIP-8 Viewer", VIDEO_WIDTH * scale, VIDEO_HEIGHT * scale, VIDEO_WIDTH, VIDEO_HEIGHT);
+	if (!layer.flag)
+	{
+		CloseSocket(fd);
+		return 1;
+	}
+
+	uint32_t video[VIDEO_WIDTH * VIDEO_HEIGHT]{};
+	int videoPitch = sizeof(video[0]) * VIDEO_WIDTH;
+	uint8_t frame[FRAME_BYTES]{};
+	uint8_t decoded[FRAME_BYTES];
+	uint32_t sequence = 0;
+	bool synced = false;
+	unsigned long skipped = 0;
+
+	std::vector<uint8_t> buffer;
+	char chunk[4096];
+
+	//the viewer has no machine to drive - keypad and speed are ignored
+	bool keys[KEY_COUNT]{};
+	float speed = 0;
+	bool quit = false;
+
+	while (!quit)
+	{
+		quit = layer.ProcessInput(keys, &speed);
+
+		//switch channel
+		const Uint8* keyboard = SDL_GetKeyboardState(nullptr);
+		int step = keyboard[SDL_SCANCODE_PAGEUP] ? 1 : keyboard[SDL_SCANCODE_PAGEDOWN] ? -1 : 0;
+		if (step != 0)
+		{
+			channel = static_cast<uint8_t>(channel + step);
+			SendBytes(fd, &channel, 1);
+			synced = false;
+			SDL_Delay(150);
+		}
+
+		pollfd socketFd{};
+		socketFd.fd = fd;
+		socketFd.events = POLLIN;
+		if (poll(&socketFd, 1, 16) > 0)
+		{
+			int received = static_cast<int>(recv(fd, chunk, sizeof(chunk), 0));
+			if (received <= 0)
+			{
+				std::cerr << "server closed the stream" << std::endl;
+				break;
+			}
+			buffer.insert(buffer.end(), chunk, chunk + received);
+		}
+
+		bool updated = false;
+		size_t start = 0;
+		while (buffer.size() - start >= PACKET_HEADER)
+		{
+			const uint8_t* packet = buffer.data() + start;
+			if (packet[0] != 'C' || packet[1] != '8')
+			{
+				std::cerr << "corrupt stream" << std::endl;
+				quit = true;
+				break;
+			}
+
+			size_t length = packet[8] | (packet[9] << 8);
+			if (buffer.size() - start < PACKET_HEADER + length)
+			{
+				break;
+			}
+			start += PACKET_HEADER + length;
+
+			uint32_t number = packet[4] | (packet[5] << 8) | (packet[6] << 16) | (static_cast<uint32_t>(packet[7]) << 24);
+			if (packet[3] != channel || !RleDecode(packet + PACKET_HEADER, length, decoded, FRAME_BYTES))
+			{
+				continue;
+			}
+
+			if (packet[2] == PACKET_KEY)
+			{
+				std::copy(decoded, decoded + FRAME_BYTES, frame);
+				synced = true;
+			}
+			else if (synced && number == sequence + 1)
+			{
+				for (unsigned int i = 0; i < FRAME_BYTES; ++i)
+				{
+					frame[i] ^= decoded[i];
+				}
+			}
+			else
+			{
+				//out of sequence - wait for the key frame the server sends after a resync
+				++skipped;
+				continue;
+			}
+
+			sequence = number;
+			updated = true;
+		}
+		buffer.erase(buffer.begin(), buffer.begin() + start);
+
+		if (updated)
+		{
+			UnpackVideo(frame, video);
+			layer.Update(video, videoPitch, VIDEO_WIDTH * scale, VIDEO_HEIGHT * scale);
+		}
+		layer.Filter(video, videoPitch, VIDEO_WIDTH * scale, VIDEO_HEIGHT * scale);
+	}
+
+	if (skipped > 0)
+	{
+		std::cout << skipped << " out of sequence packets skipped" << std::endl;
+	}
+
+	CloseSocket(fd);
+	return 0;
+}